@@ -0,0 +1,211 @@
+/*
+    bamcat.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Reader of the BAM files of the host program for "make check". The BGZF
+    blocks are read with zlib, the header and the records are checked for
+    the layout bamout.c writes: the magic, one CIGAR operation M over the
+    read and bases and qualities of the same length. The header and the
+    records are printed in the same text as the SAM output of the host
+    program, so a BAM file can be compared with a SAM file of the same run.
+
+    fpga-bamcat <file.bam>
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <zlib.h>
+
+static const char seq_code[16] = { '=', 'A', 'C', 'M', 'G', 'R', 'S', 'V', 'T', 'W', 'Y', 'H', 'K', 'D', 'B', 'N' };
+
+static uint32_t get32(const unsigned char *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t get16(const unsigned char *p) {
+	return p[0] | (p[1] << 8);
+}
+
+/******************************************************************************
+ * Reads exactly n bytes, returns 1 at the end of the file before the first
+ * byte and -1 at the end within them
+ ******************************************************************************/
+static int readBytes(gzFile in, void *data, unsigned int n) {
+	int got = gzread(in, data, n);
+
+	if (got == (int) n) {
+		return 0;
+	}
+	return (got == 0) ? 1 : -1;
+}
+
+int main(int argc, char** argv) {
+	unsigned char word[4], *record = NULL;
+	char **names = NULL, *text;
+	uint32_t length, references, i, size = 0, recordsize;
+	unsigned long records = 0;
+	gzFile in;
+	int end;
+
+	if (argc != 2) {
+		printf("\nFPGA-Alignment BAM reader\n");
+		printf("Usage:\n");
+		printf("\tfpga-bamcat <file.bam> \tprint the header and the records as SAM lines of the host program\n\n");
+		return -1;
+	}
+
+	in = gzopen(argv[1], "rb");
+	if (in == NULL) {
+		fprintf(stderr, "\nError: can not open %s\n", argv[1]);
+		return -1;
+	}
+
+	/* magic and text of the header, tabs as the SAM output of the host writes spaces */
+	if (readBytes(in, word, 4) || memcmp(word, "BAM\1", 4) || readBytes(in, word, 4)) {
+		fprintf(stderr, "\nError: %s is no BAM file\n", argv[1]);
+		gzclose(in);
+		return -1;
+	}
+	length = get32(word);
+	text = (char*) malloc(length + 1);
+	if ((text == NULL) || readBytes(in, text, length)) {
+		fprintf(stderr, "\nError: reading the header of %s\n", argv[1]);
+		free(text);
+		gzclose(in);
+		return -1;
+	}
+	for (i = 0; i < length; i++) {
+		if (text[i] == '\t') {
+			text[i] = ' ';
+		}
+	}
+	fwrite(text, 1, length, stdout);
+	free(text);
+
+	/* names of the references */
+	if (readBytes(in, word, 4)) {
+		fprintf(stderr, "\nError: reading the references of %s\n", argv[1]);
+		gzclose(in);
+		return -1;
+	}
+	references = get32(word);
+	names = (char**) calloc(references + 1, sizeof(char*));
+	for (i = 0; (names != NULL) && (i < references); i++) {
+		if (readBytes(in, word, 4)) {
+			break;
+		}
+		length = get32(word);
+		names[i] = (char*) malloc(length + 1);
+		if ((names[i] == NULL) || readBytes(in, names[i], length) || readBytes(in, word, 4)) {
+			break;
+		}
+		names[i][length] = 0;
+	}
+	if ((names == NULL) || (i < references)) {
+		fprintf(stderr, "\nError: reading the references of %s\n", argv[1]);
+		end = -2;
+		goto done;
+	}
+
+	/* records until the end of the file */
+	while ((end = readBytes(in, word, 4)) == 0) {
+		uint32_t reference, position, bases, cigar, p;
+		uint16_t flag, operations;
+		unsigned int name;
+		const unsigned char *seq, *qual;
+
+		recordsize = get32(word);
+		if (recordsize > size) {
+			free(record);
+			size = recordsize;
+			record = (unsigned char*) malloc(size);
+			if (record == NULL) {
+				fprintf(stderr, "\nError: allocating a record of %u bytes\n", recordsize);
+				end = -2;
+				break;
+			}
+		}
+		if ((recordsize < 32) || readBytes(in, record, recordsize)) {
+			fprintf(stderr, "\nError: record %lu of %s is cut\n", records, argv[1]);
+			end = -2;
+			break;
+		}
+
+		reference = get32(record);
+		position = get32(record + 4);
+		name = record[8];
+		operations = get16(record + 12);
+		flag = get16(record + 14);
+		bases = get32(record + 16);
+		if ((reference >= references) || (name == 0) || (operations != 1) ||
+			(32 + name + 4 + (bases + 1) / 2 + bases != recordsize)) {
+			fprintf(stderr, "\nError: record %lu of %s does not match the layout of the host\n", records, argv[1]);
+			end = -2;
+			break;
+		}
+		cigar = get32(record + 32 + name);
+		if (((cigar & 0xf) != 0) || ((bases != 0) && ((cigar >> 4) != bases))) {
+			fprintf(stderr, "\nError: CIGAR of record %lu of %s is not one M over the read\n", records, argv[1]);
+			end = -2;
+			break;
+		}
+
+		printf("%s \t%u \t%s \t0 \t%u \t* \t* \t* \t* \t* \t", (char*) record + 32, flag, names[reference], position);
+		seq = record + 32 + name + 4;
+		qual = seq + (bases + 1) / 2;
+		if (bases == 0) {
+			printf("*");
+		}
+		for (p = 0; p < bases; p++) {
+			putchar(seq_code[(p & 1) ? (seq[p / 2] & 0xf) : (seq[p / 2] >> 4)]);
+		}
+		printf(" \t");
+		if ((bases == 0) || (qual[0] == 0xff)) {
+			printf("*");
+		} else {
+			for (p = 0; p < bases; p++) {
+				putchar(qual[p] + 33);
+			}
+		}
+		printf("\n");
+		records++;
+	}
+	if (end == -1) {
+		fprintf(stderr, "\nError: %s ends within a record\n", argv[1]);
+	}
+
+done:
+	for (i = 0; (names != NULL) && (i < references); i++) {
+		free(names[i]);
+	}
+	free(names);
+	free(record);
+	gzclose(in);
+	return (end < 0) ? -1 : 0;
+}
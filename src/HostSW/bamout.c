@@ -0,0 +1,475 @@
+/*
+    bamout.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Writing of the results as BAM. Every writer encodes its records into a
+    buffer of its own; a full buffer is handed to a ring of blocks, which a
+    pool of threads compresses to BGZF blocks in parallel. A writer thread
+    appends the blocks to the file in their order and the end-of-file block
+    at the end.
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+
+#include "header/bamout.h"
+
+#define BGZF_SIZE	(1 << 16)		/* bytes of a compressed block */
+#define BGZF_HEADER	18				/* gzip header with the BC field */
+#define BGZF_TRAILER	8			/* CRC32 and ISIZE */
+#define BAM_LEVEL	Z_DEFAULT_COMPRESSION
+
+enum block_state { BLOCK_FREE, BLOCK_FULL, BLOCK_BUSY, BLOCK_DONE };
+
+/* one block, records and compressed */
+struct block_t {
+	char *in;
+	unsigned int inlength;
+	unsigned char out[BGZF_SIZE];
+	unsigned int outlength;
+	int state;
+};
+
+struct bamfile_t {
+	FILE *file;
+	struct block_t *blocks;
+	unsigned int blockcount;
+	unsigned long head, tail, next;	/* next block to write, to fill, to compress */
+	int error, stop;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t full, done, freed;
+	pthread_t *workers, writer;
+	unsigned int threads;
+	int writing;
+};
+
+/* empty block at the end of every BGZF file */
+static const unsigned char bgzf_eof[28] = {
+	0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00, 0x42, 0x43,
+	0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+/* 4 bit codes of "=ACMGRSVTWYHKDBN", everything else is N */
+static uint8_t base_code[256];
+
+static char *put16(char *p, uint16_t v) {
+	p[0] = v & 0xff;
+	p[1] = v >> 8;
+	return p + 2;
+}
+
+static char *put32(char *p, uint32_t v) {
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = v >> 24;
+	return p + 4;
+}
+
+/* bin of the UCSC binning scheme for [begin, end) */
+static uint16_t reg2bin(int32_t begin, int32_t end) {
+	end--;
+	if ((begin >> 14) == (end >> 14)) return ((1 << 15) - 1) / 7 + (begin >> 14);
+	if ((begin >> 17) == (end >> 17)) return ((1 << 12) - 1) / 7 + (begin >> 17);
+	if ((begin >> 20) == (end >> 20)) return ((1 << 9) - 1) / 7 + (begin >> 20);
+	if ((begin >> 23) == (end >> 23)) return ((1 << 6) - 1) / 7 + (begin >> 23);
+	if ((begin >> 26) == (end >> 26)) return ((1 << 3) - 1) / 7 + (begin >> 26);
+	return 0;
+}
+
+/******************************************************************************
+ * Compresses a block, stored if it does not get smaller
+ ******************************************************************************/
+static int deflateBlock(z_stream *z, z_stream *stored, struct block_t *block) {
+	unsigned char *out = block->out;
+	unsigned int size;
+	uint32_t crc;
+	z_stream *s = z;
+
+	while (1) {
+		deflateReset(s);
+		s->next_in = (unsigned char*) block->in;
+		s->avail_in = block->inlength;
+		s->next_out = out + BGZF_HEADER;
+		s->avail_out = BGZF_SIZE - BGZF_HEADER - BGZF_TRAILER;
+		if (deflate(s, Z_FINISH) == Z_STREAM_END) {
+			break;
+		}
+		if (s == stored) {
+			return -1;
+		}
+		s = stored;
+	}
+
+	size = BGZF_HEADER + s->total_out + BGZF_TRAILER;
+	memcpy(out, bgzf_eof, BGZF_HEADER);
+	put16((char*) out + 16, size - 1);
+	crc = crc32(crc32(0, NULL, 0), (unsigned char*) block->in, block->inlength);
+	put32((char*) out + size - 8, crc);
+	put32((char*) out + size - 4, block->inlength);
+	block->outlength = size;
+	return 0;
+}
+
+/******************************************************************************
+ * Worker of the pool: compresses the full blocks in their order
+ ******************************************************************************/
+static void *deflateWorker(void *arg) {
+	struct bamfile_t *f = (struct bamfile_t*) arg;
+	struct block_t *block;
+	z_stream z, stored;
+	int ready, ret;
+
+	memset(&z, 0, sizeof(z));
+	memset(&stored, 0, sizeof(stored));
+	ready = (deflateInit2(&z, BAM_LEVEL, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+	ready = (deflateInit2(&stored, 0, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK) && ready;
+
+	pthread_mutex_lock(&f->mutex);
+	while (1) {
+		if (f->next == f->tail) {
+			if (f->stop) {
+				break;
+			}
+			pthread_cond_wait(&f->full, &f->mutex);
+			continue;
+		}
+		block = &f->blocks[f->next % f->blockcount];
+		block->state = BLOCK_BUSY;
+		f->next++;
+
+		pthread_mutex_unlock(&f->mutex);
+		ret = ready ? deflateBlock(&z, &stored, block) : -1;
+		pthread_mutex_lock(&f->mutex);
+
+		if (ret != 0) {
+			f->error = 1;
+			block->outlength = 0;
+		}
+		block->state = BLOCK_DONE;
+		pthread_cond_broadcast(&f->done);
+	}
+	pthread_mutex_unlock(&f->mutex);
+
+	deflateEnd(&z);
+	deflateEnd(&stored);
+	return NULL;
+}
+
+/******************************************************************************
+ * Writer: appends the compressed blocks to the file in their order
+ ******************************************************************************/
+static void *writeBlocks(void *arg) {
+	struct bamfile_t *f = (struct bamfile_t*) arg;
+	struct block_t *block;
+
+	pthread_mutex_lock(&f->mutex);
+	while (1) {
+		block = &f->blocks[f->head % f->blockcount];
+		if (f->head == f->tail) {
+			if (f->stop) {
+				break;
+			}
+			pthread_cond_wait(&f->done, &f->mutex);
+			continue;
+		}
+		if (block->state != BLOCK_DONE) {
+			pthread_cond_wait(&f->done, &f->mutex);
+			continue;
+		}
+
+		pthread_mutex_unlock(&f->mutex);
+		if (fwrite(block->out, 1, block->outlength, f->file) != block->outlength) {
+			f->error = 1;
+		}
+		pthread_mutex_lock(&f->mutex);
+
+		block->state = BLOCK_FREE;
+		f->head++;
+		pthread_cond_broadcast(&f->freed);
+	}
+	pthread_mutex_unlock(&f->mutex);
+
+	return NULL;
+}
+
+/******************************************************************************
+ * Creates a BAM file and starts the threads
+ ******************************************************************************/
+struct bamfile_t *bamOpen(const char *name) {
+	struct bamfile_t *f;
+	const char *codes = "=ACMGRSVTWYHKDBN";
+	unsigned int i;
+	long threads;
+
+	for (i = 0; i < 256; i++) {
+		base_code[i] = 15;
+	}
+	for (i = 0; i < 16; i++) {
+		base_code[(unsigned char) codes[i]] = i;
+		base_code[(unsigned char) codes[i] | 0x20] = i;
+	}
+
+	f = (struct bamfile_t*) calloc(1, sizeof(struct bamfile_t));
+	if (f == NULL) {
+		return NULL;
+	}
+	threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads < 1) {
+		threads = 1;
+	}
+	f->file = fopen(name, "wb");
+	f->blockcount = 2 * threads + 2;
+	f->blocks = (struct block_t*) calloc(f->blockcount, sizeof(struct block_t));
+	f->workers = (pthread_t*) calloc(threads, sizeof(pthread_t));
+	if ((f->file == NULL) || (f->blocks == NULL) || (f->workers == NULL)) {
+		if (f->file != NULL) {
+			fclose(f->file);
+		}
+		free(f->blocks);
+		free(f->workers);
+		free(f);
+		return NULL;
+	}
+	for (i = 0; i < f->blockcount; i++) {
+		f->blocks[i].in = (char*) malloc(BAM_BLOCK);
+		if (f->blocks[i].in == NULL) {
+			f->error = 1;
+		}
+	}
+
+	pthread_mutex_init(&f->mutex, NULL);
+	pthread_cond_init(&f->full, NULL);
+	pthread_cond_init(&f->done, NULL);
+	pthread_cond_init(&f->freed, NULL);
+	for (f->threads = 0; f->threads < threads; f->threads++) {
+		if (pthread_create(&f->workers[f->threads], NULL, deflateWorker, f)) {
+			break;
+		}
+	}
+	f->writing = (pthread_create(&f->writer, NULL, writeBlocks, f) == 0);
+	if ((f->threads == 0) || !f->writing || f->error) {
+		f->error = 1;
+		bamClose(f);
+		return NULL;
+	}
+	return f;
+}
+
+int bamBuffer(struct bambuffer_t *buffer) {
+	buffer->length = 0;
+	buffer->data = (char*) malloc(BAM_BLOCK);
+	return (buffer->data == NULL) ? -1 : 0;
+}
+
+/******************************************************************************
+ * Hands the records of a buffer to the pool, the buffer gets a free block
+ ******************************************************************************/
+int bamFlush(struct bamfile_t *f, struct bambuffer_t *buffer) {
+	struct block_t *block;
+	char *data;
+
+	if (buffer->length == 0) {
+		return f->error ? -1 : 0;
+	}
+
+	pthread_mutex_lock(&f->mutex);
+	block = &f->blocks[f->tail % f->blockcount];
+	while (block->state != BLOCK_FREE) {
+		pthread_cond_wait(&f->freed, &f->mutex);
+	}
+	data = block->in;
+	block->in = buffer->data;
+	block->inlength = buffer->length;
+	block->state = BLOCK_FULL;
+	f->tail++;
+	pthread_cond_signal(&f->full);
+	pthread_mutex_unlock(&f->mutex);
+
+	buffer->data = data;
+	buffer->length = 0;
+	return f->error ? -1 : 0;
+}
+
+/* appends bytes to the buffer, a header may fill several blocks */
+static int bufferBytes(struct bamfile_t *f, struct bambuffer_t *buffer, const char *data, unsigned int length) {
+	unsigned int n;
+
+	while (length > 0) {
+		if (buffer->length == BAM_BLOCK && bamFlush(f, buffer)) {
+			return -1;
+		}
+		n = BAM_BLOCK - buffer->length;
+		if (n > length) {
+			n = length;
+		}
+		memcpy(buffer->data + buffer->length, data, n);
+		buffer->length += n;
+		data += n;
+		length -= n;
+	}
+	return 0;
+}
+
+static int bufferWord(struct bamfile_t *f, struct bambuffer_t *buffer, uint32_t value) {
+	char word[4];
+
+	put32(word, value);
+	return bufferBytes(f, buffer, word, 4);
+}
+
+/******************************************************************************
+ * Writes the header with the text of a SAM header and the references. Names
+ * end at the first blank.
+ ******************************************************************************/
+int bamHeader(struct bamfile_t *f, struct bambuffer_t *buffer, unsigned int references,
+		const char *const *names, const uint64_t *lengths) {
+	char line[64];
+	size_t text = 0;
+	unsigned int i, n;
+
+	/* length of the text first */
+	text = strlen("@HD\tVN:1.3\tSO:unsorted\n");
+	for (i = 0; i < references; i++) {
+		n = strcspn(names[i], " \t");
+		text += n + snprintf(line, sizeof(line), "@SQ\tSN:\tLN:%llu\n", (unsigned long long) lengths[i]);
+	}
+
+	if (bufferBytes(f, buffer, "BAM\1", 4) || bufferWord(f, buffer, text) ||
+		bufferBytes(f, buffer, "@HD\tVN:1.3\tSO:unsorted\n", strlen("@HD\tVN:1.3\tSO:unsorted\n"))) {
+		return -1;
+	}
+	for (i = 0; i < references; i++) {
+		n = strcspn(names[i], " \t");
+		if (bufferBytes(f, buffer, "@SQ\tSN:", 7) || bufferBytes(f, buffer, names[i], n) ||
+			bufferBytes(f, buffer, line, snprintf(line, sizeof(line), "\tLN:%llu\n", (unsigned long long) lengths[i]))) {
+			return -1;
+		}
+	}
+
+	if (bufferWord(f, buffer, references)) {
+		return -1;
+	}
+	for (i = 0; i < references; i++) {
+		n = strcspn(names[i], " \t");
+		if (bufferWord(f, buffer, n + 1) || bufferBytes(f, buffer, names[i], n) || bufferBytes(f, buffer, "", 1) ||
+			bufferWord(f, buffer, (lengths[i] > INT32_MAX) ? INT32_MAX : lengths[i])) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Encodes one alignment with a single M operation into the buffer
+ ******************************************************************************/
+int bamRecord(struct bamfile_t *f, struct bambuffer_t *buffer, const struct bamrecord_t *record) {
+	unsigned int name = strcspn(record->name, " \t");
+	uint32_t bases = (record->bases == NULL) ? 0 : record->length;
+	unsigned int size, i;
+	char *p;
+
+	if (name > 254) {
+		name = 254;
+	}
+	size = 36 + name + 1 + 4 + (bases + 1) / 2 + bases;
+	if ((buffer->length + size > BAM_BLOCK) && bamFlush(f, buffer)) {
+		return -1;
+	}
+
+	p = buffer->data + buffer->length;
+	p = put32(p, size - 4);
+	p = put32(p, record->reference);
+	p = put32(p, record->position);
+	*p++ = name + 1;
+	*p++ = (char) 255;						/* MAPQ not available */
+	p = put16(p, reg2bin(record->position, record->position + (record->length ? record->length : 1)));
+	p = put16(p, 1);						/* one CIGAR operation */
+	p = put16(p, record->flag);
+	p = put32(p, bases);
+	p = put32(p, (uint32_t) -1);			/* no mate */
+	p = put32(p, (uint32_t) -1);
+	p = put32(p, 0);
+	memcpy(p, record->name, name);
+	p[name] = 0;
+	p += name + 1;
+	p = put32(p, record->length << 4);		/* M */
+
+	for (i = 0; i < bases; i += 2) {
+		*p++ = (base_code[(unsigned char) record->bases[i]] << 4) |
+				((i + 1 < bases) ? base_code[(unsigned char) record->bases[i + 1]] : 0);
+	}
+	for (i = 0; i < bases; i++) {
+		*p++ = (record->quality == NULL) ? (char) 0xff : record->quality[i] - 33;
+	}
+
+	buffer->length += size;
+	return 0;
+}
+
+/******************************************************************************
+ * Waits for the last blocks, writes the end-of-file block and closes the
+ * file. Returns -1 if a block could not be compressed or written.
+ ******************************************************************************/
+int bamClose(struct bamfile_t *f) {
+	unsigned int t;
+	int error;
+
+	pthread_mutex_lock(&f->mutex);
+	f->stop = 1;
+	pthread_cond_broadcast(&f->full);
+	pthread_cond_broadcast(&f->done);
+	pthread_mutex_unlock(&f->mutex);
+	for (t = 0; t < f->threads; t++) {
+		pthread_join(f->workers[t], NULL);
+	}
+	if (f->writing) {
+		pthread_join(f->writer, NULL);
+	}
+
+	if (fwrite(bgzf_eof, 1, sizeof(bgzf_eof), f->file) != sizeof(bgzf_eof)) {
+		f->error = 1;
+	}
+	if (fclose(f->file) != 0) {
+		f->error = 1;
+	}
+	error = f->error;
+
+	for (t = 0; t < f->blockcount; t++) {
+		free(f->blocks[t].in);
+	}
+	free(f->blocks);
+	free(f->workers);
+	free(f);
+	return error ? -1 : 0;
+}
@@ -0,0 +1,152 @@
+#!/bin/sh
+#
+# bench.sh
+# Project:	FPGA-DNA-Sequence-Search
+#
+# Benchmark of the host program, started by "make bench". fpga-benchgen
+# generates a reference and reads with the same seed on every host, then
+# the stages of the host program are timed one by one: the transformation
+# of the database, the encoding of the reads, the decoding of the results
+# into PAM and into SAM on the CPU path, and whole runs on the CPU and
+# against fpga-emu on a local socket as the device. fpga-textbench times
+# the formatting of the same hits with fprintf and with textout.c. Every run appends its
+# results to bench/bench.csv and writes bench/bench-<revision>.json with
+# the revision and the CPU, so releases can be compared.
+#
+# The sizes come from the environment, e.g.
+#	make bench BENCH_GENOME=50000000 BENCH_READS=200000
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+DIR=${BENCH_DIR:-$HERE/bench}
+GENOME=${BENCH_GENOME:-4000000}
+CONTIGS=${BENCH_CONTIGS:-8}
+REPEATS=${BENCH_REPEATS:-0.1}
+GAPS=${BENCH_GAPS:-4}
+READS=${BENCH_READS:-20000}
+LENGTH=${BENCH_LENGTH:-50}
+DISTRIBUTION=${BENCH_MISMATCH:-60,25,10,5}
+MISMATCH=${BENCH_THRESHOLD:-3}
+EMUREADS=${BENCH_EMU_READS:-2000}
+HITS=${BENCH_HITS:-2000000}
+SEED=${BENCH_SEED:-1}
+
+REVISION=$(git -C "$HERE" rev-parse --short HEAD 2>/dev/null || echo unknown)
+if [ "$REVISION" != unknown ] && ! git -C "$HERE" diff --quiet HEAD -- . 2>/dev/null; then
+	REVISION="$REVISION-dirty"
+fi
+CPU=$(sed -n 's/^model name[[:space:]]*: //p' /proc/cpuinfo | head -n 1)
+CORES=$(getconf _NPROCESSORS_ONLN)
+DATE=$(date -u +%Y-%m-%dT%H:%M:%SZ)
+JSON="$DIR/bench-$REVISION.json"
+STAGES=""
+
+now() {
+	date +%s.%N
+}
+
+# stage seconds rate unit
+record() {
+	printf "%-16s %10.3f s %12.2f %s\n" "$1" "$2" "$3" "$4"
+	printf "%s,%s,\"%s\",%s,%s,%s,%s,%s\n" "$DATE" "$REVISION" "$CPU" "$CORES" "$1" "$2" "$3" "$4" >> "$DIR/bench.csv"
+	STAGES="$STAGES${STAGES:+,
+}    { \"stage\": \"$1\", \"seconds\": $2, \"rate\": $3, \"unit\": \"$4\" }"
+}
+
+# value of a line "name: value" of a log
+field() {
+	sed -n "s/^$1[[:space:]]*\([0-9.e+-]*\).*/\1/p" "$2" | head -n 1
+}
+
+# sum of a histogram of a metrics file
+histogram() {
+	awk -v name="\"$1\":" '$1 == name { found = 1 } found && $1 == "\"sum\":" { print $2; exit }' "$2"
+}
+
+# a / b with 0 for b = 0
+ratio() {
+	awk -v a="$1" -v b="$2" 'BEGIN { printf "%.3f", (b > 0) ? a / b : 0 }'
+}
+
+elapsed() {
+	awk -v a="$1" -v b="$2" 'BEGIN { printf "%.3f", b - a }'
+}
+
+mkdir -p "$DIR"
+cd "$DIR"
+if [ ! -f bench.csv ]; then
+	echo "date,revision,cpu,cores,stage,seconds,rate,unit" > bench.csv
+fi
+
+echo "--- benchmark of $REVISION on $CPU ($CORES cores) ---"
+"$HERE/fpga-benchgen" -o ref -g "$GENOME" -c "$CONTIGS" -r "$REPEATS" -n "$GAPS" -q "$READS" -l "$LENGTH" -m "$DISTRIBUTION" -s "$SEED"
+
+# transformation of the database
+t0=$(now)
+"$HERE/main" -d ref.fa -b ref.bindb -t > transform.log
+t1=$(now)
+s=$(elapsed "$t0" "$t1")
+record transformdb "$s" "$(ratio "$GENOME" "$s" | awk '{ printf "%.3f", $1 / 1e6 }')" MBases/s
+
+# CPU search, the decoding of the results is timed by the metrics
+t0=$(now)
+"$HERE/main" -b ref.bindb -q ref.fq -o pam -m "$MISMATCH" -r -c 0 -i -M pam.json > pam.log
+t1=$(now)
+s=$(elapsed "$t0" "$t1")
+e=$(field "encoding reads:" pam.log)
+record transformread "$e" "$(ratio "$READS" "$e")" reads/s
+d=$(histogram format_seconds pam.json)
+record decode-pam "$d" "$(ratio "$READS" "$d")" reads/s
+record cpu-run "$s" "$(ratio "$READS" "$s")" reads/s
+
+t0=$(now)
+"$HERE/main" -b ref.bindb -q ref.fq -o sam -m "$MISMATCH" -r -c 0 -s -M sam.json > sam.log
+t1=$(now)
+d=$(histogram format_seconds sam.json)
+record decode-sam "$d" "$(ratio "$READS" "$d")" reads/s
+
+# formatting of the result lines alone, the old fprintf calls against textout.c
+"$HERE/fpga-textbench" -n "$HITS" -l "$LENGTH" -s "$SEED" > text.log
+for f in pam sam; do
+	s=$(field "fprintf $f:" text.log)
+	record text-fprintf-$f "$s" "$(ratio "$HITS" "$s")" hits/s
+	s=$(field "text $f:" text.log)
+	record text-buffer-$f "$s" "$(ratio "$HITS" "$s")" hits/s
+done
+grep '^speedup' text.log
+
+mapped=$(sed -n 's/^mapped [0-9]* (\([0-9.]*\) %).*/\1/p' pam.log)
+
+# whole run against fpga-emu on a socket of its own
+head -n $((4 * EMUREADS)) ref.fq > emu.fq
+rm -f emu.sock
+"$HERE/fpga-emu" -s "$DIR/emu.sock" > emu.log 2>&1 &
+EMU=$!
+trap 'kill $EMU 2>/dev/null' EXIT
+printf 'FPGA = [0x00, 0x0a, 0x35, 0x02, 0x2a, 0x42];\nHOST = [0x00, 0x19, 0x99, 0x12, 0x3d, 0x08];\nSOCKET = "%s";\n' "$DIR/emu.sock" > mac.config
+sleep 1
+t0=$(now)
+"$HERE/main" -b ref.bindb -q emu.fq -o emu -m "$MISMATCH" -r -M emu.json > emu-run.log
+t1=$(now)
+s=$(elapsed "$t0" "$t1")
+record emu-run "$s" "$(ratio "$EMUREADS" "$s")" reads/s
+kill $EMU 2>/dev/null || true
+trap - EXIT
+
+cat > "$JSON" <<END
+{
+  "date": "$DATE",
+  "revision": "$REVISION",
+  "cpu": "$CPU",
+  "cores": $CORES,
+  "parameters": { "genome": $GENOME, "contigs": $CONTIGS, "repeats": $REPEATS, "gaps": $GAPS, "reads": $READS,
+                  "length": $LENGTH, "distribution": "$DISTRIBUTION", "mismatch": $MISMATCH, "emureads": $EMUREADS, "hits": $HITS, "seed": $SEED },
+  "mapped": ${mapped:-0},
+  "stages": [
+$STAGES
+  ]
+}
+END
+echo "mapped: ${mapped:-0} %"
+echo "results: $DIR/bench.csv, $JSON"
@@ -0,0 +1,384 @@
+/*
+    benchgen.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Generator of the synthetic reference and reads of the benchmark. The
+    reference has a given number of bases in several contigs, a share of
+    repeats copied with few changes from earlier parts and runs of N. The
+    reads are taken from both strands of the reference and get a number of
+    mismatches drawn from a given distribution, a share of them is random.
+    The name of a read lists its contig, position, strand and mismatches.
+    The same seed gives the same files on every host.
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#define LINE		60			/* bases per FASTA line */
+#define MAXLENGTH	256			/* bases of a read, like the host program */
+#define MAXMISMATCH	8
+#define REPEAT		2650		/* average bases of a repeat */
+
+static const char bases[4] = { 'A', 'C', 'G', 'T' };
+
+static struct option gen_lopts[] = {
+	{ "output",		required_argument, NULL, 'o' },
+	{ "genome",		required_argument, NULL, 'g' },
+	{ "contigs",	required_argument, NULL, 'c' },
+	{ "repeats",	required_argument, NULL, 'r' },
+	{ "gaps",		required_argument, NULL, 'n' },
+	{ "gaplength",	required_argument, NULL, 'N' },
+	{ "reads",		required_argument, NULL, 'q' },
+	{ "length",		required_argument, NULL, 'l' },
+	{ "mismatch",	required_argument, NULL, 'm' },
+	{ "random",		required_argument, NULL, 'u' },
+	{ "seed",		required_argument, NULL, 's' },
+	{ "help",		no_argument		 , NULL, 'h' },
+	{ 0, 0, 0, 0 }
+};
+
+static char gen_sopts[] = "o:g:c:r:n:N:q:l:m:u:s:h";
+
+static uint64_t state;
+
+/* xorshift64*, the same sequence with every C library */
+static uint64_t next() {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 0x2545F4914F6CDD1DULL;
+}
+
+static uint64_t below(uint64_t n) {
+	return (n > 0) ? (next() >> 11) % n : 0;
+}
+
+static double uniform() {
+	return (double) (next() >> 11) / (double) (1ULL << 53);
+}
+
+static void print_help() {
+
+	printf("\nFPGA-Alignment benchmark data\n");
+	printf("Usage:\n");
+	printf("\tfpga-benchgen [options] \n\n");
+	printf("Options:\n");
+	printf("\t--output \t-o <name> \tbase name of name.fa and name.fq (default: bench)\n");
+	printf("\t--genome \t-g [int] \tbases of the reference (default: 4000000)\n");
+	printf("\t--contigs \t-c [int] \tcontigs of the reference (default: 8)\n");
+	printf("\t--repeats \t-r [float] \tshare of repeated bases (default: 0.1)\n");
+	printf("\t--gaps \t\t-n [int] \truns of N (default: 4)\n");
+	printf("\t--gaplength \t-N [int] \tbases of a run of N (default: 70000)\n");
+	printf("\t--reads \t-q [int] \tnumber of reads (default: 20000)\n");
+	printf("\t--length \t-l [int] \tbases of a read (default: 50)\n");
+	printf("\t--mismatch \t-m <list> \tshares of reads with 0, 1, ... mismatches (default: 60,25,10,5)\n");
+	printf("\t--random \t-u [float] \tshare of random reads (default: 0.05)\n");
+	printf("\t--seed \t\t-s [int] \tseed of the generator (default: 1)\n");
+	printf("\t--help \t\t-h \t\tprint this usage message\n");
+}
+
+/* the shares of 0, 1, ... mismatches as cumulative probabilities */
+static int parseMismatch(const char *list, double *share) {
+	double sum = 0;
+	unsigned int i, n = 0;
+	char *end;
+
+	while ((*list != 0) && (n < MAXMISMATCH)) {
+		share[n] = strtod(list, &end);
+		if ((end == list) || (share[n] < 0)) {
+			return -1;
+		}
+		sum = sum + share[n];
+		n++;
+		list = (*end == ',') ? end + 1 : end;
+		if ((*end != ',') && (*end != 0)) {
+			return -1;
+		}
+	}
+	if (sum <= 0) {
+		return -1;
+	}
+	for (i = 0; i < MAXMISMATCH; i++) {
+		share[i] = ((i > 0) ? share[i-1] : 0) + ((i < n) ? share[i] / sum : 0);
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Reference of genome bases. A repeat copies an earlier part of 300 to 5000
+ * bases with one change in 100 bases, it starts with the probability that
+ * gives the share of repeats; the runs of N are placed at random.
+ ******************************************************************************/
+static char *generateGenome(uint64_t genome, double repeats, unsigned int gaps, uint64_t gaplength) {
+	uint64_t i, j, length, from;
+	double start;
+	char *g;
+
+	start = (repeats < 1) ? repeats / ((1 - repeats) * REPEAT) : 1;
+
+	g = (char*) malloc(genome);
+	if (g == NULL) {
+		return NULL;
+	}
+
+	i = 0;
+	while (i < genome) {
+		if ((i > 5000) && (uniform() < start)) {
+			length = 300 + below(4701);
+			from = below(i - length);
+			for (j = 0; (j < length) && (i < genome); j++, i++) {
+				g[i] = (below(100) == 0) ? bases[below(4)] : g[from + j];
+			}
+		} else {
+			g[i++] = bases[below(4)];
+		}
+	}
+
+	for (j = 0; (j < gaps) && (gaplength < genome); j++) {
+		from = below(genome - gaplength);
+		memset(g + from, 'N', gaplength);
+	}
+	return g;
+}
+
+static int writeGenome(const char *name, const char *g, uint64_t genome, unsigned int contigs) {
+	uint64_t start, end, i;
+	unsigned int c;
+	FILE *f;
+
+	f = fopen(name, "w");
+	if (f == NULL) {
+		fprintf(stderr, "\nError: can not create File %s\n", name);
+		return -1;
+	}
+	for (c = 0; c < contigs; c++) {
+		start = genome * c / contigs;
+		end = genome * (c + 1) / contigs;
+		fprintf(f, ">contig%u synthetic %llu bases\n", c + 1, (unsigned long long) (end - start));
+		for (i = start; i < end; i = i + LINE) {
+			fwrite(g + i, 1, (end - i < LINE) ? end - i : LINE, f);
+			fputc('\n', f);
+		}
+	}
+	if (fclose(f) != 0) {
+		fprintf(stderr, "\nError: writing %s\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+static char complement(char c) {
+	switch (c) {
+		case 'A': return 'T';
+		case 'C': return 'G';
+		case 'G': return 'C';
+		default:  return 'A';
+	}
+}
+
+/******************************************************************************
+ * Reads of length bases from positions without N inside one contig. The
+ * mismatches are at different positions of the read.
+ ******************************************************************************/
+static int writeReads(const char *name, const char *g, uint64_t genome, unsigned int contigs,
+					  unsigned long reads, unsigned int length, const double *share, double random) {
+	char read[MAXLENGTH + 1], quality[MAXLENGTH + 1];
+	uint64_t pos, start, end;
+	unsigned int i, c, m, k, p, tries;
+	unsigned long r;
+	int reverse;
+	FILE *f;
+
+	f = fopen(name, "w");
+	if (f == NULL) {
+		fprintf(stderr, "\nError: can not create File %s\n", name);
+		return -1;
+	}
+	memset(quality, 'I', length);
+	quality[length] = 0;
+	read[length] = 0;
+
+	for (r = 0; r < reads; r++) {
+		if (uniform() < random) {
+			for (i = 0; i < length; i++) {
+				read[i] = bases[below(4)];
+			}
+			fprintf(f, "@r%lu_random\n%s\n+\n%s\n", r + 1, read, quality);
+			continue;
+		}
+
+		/* a window without N inside one contig */
+		for (tries = 0; tries < 1000; tries++) {
+			c = (unsigned int) below(contigs);
+			start = genome * c / contigs;
+			end = genome * (c + 1) / contigs;
+			if (end - start < length) {
+				continue;
+			}
+			pos = start + below(end - start - length + 1);
+			if (memchr(g + pos, 'N', length) == NULL) {
+				break;
+			}
+		}
+		if (tries == 1000) {
+			fprintf(stderr, "\nError: no window of %u bases without N\n", length);
+			fclose(f);
+			return -1;
+		}
+
+		reverse = (int) below(2);
+		for (i = 0; i < length; i++) {
+			read[i] = reverse ? complement(g[pos + length - 1 - i]) : g[pos + i];
+		}
+
+		for (m = 0; (m < MAXMISMATCH - 1) && (uniform() >= share[m]); m++);
+		if (m > length) {
+			m = length;
+		}
+		for (k = 0; k < m; k++) {
+			/* a position that is not changed yet, changed ones are lower case */
+			do {
+				p = (unsigned int) below(length);
+			} while (read[p] >= 'a');
+			read[p] = bases[((const char*) memchr(bases, read[p], 4) - bases + 1 + below(3)) % 4] + ('a' - 'A');
+		}
+		for (i = 0; i < length; i++) {
+			if (read[i] >= 'a') {
+				read[i] = read[i] - ('a' - 'A');
+			}
+		}
+
+		fprintf(f, "@r%lu_contig%u_%llu_%c_%u\n%s\n+\n%s\n", r + 1, c + 1,
+				(unsigned long long) (pos - start + 1), reverse ? '-' : '+', m, read, quality);
+	}
+
+	if (fclose(f) != 0) {
+		fprintf(stderr, "\nError: writing %s\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	uint64_t genome = 4000000, gaplength = 70000, seed = 1;
+	unsigned int contigs = 8, gaps = 4, length = 50;
+	unsigned long reads = 20000;
+	double repeats = 0.1, random = 0.05, share[MAXMISMATCH];
+	const char *output = "bench";
+	char name[4096];
+	char *g;
+	int opt;
+
+	parseMismatch("60,25,10,5", share);
+
+	while ((opt = getopt_long(argc, argv, gen_sopts, gen_lopts, NULL)) != -1) {
+		switch (opt) {
+			case 'o':
+				output = optarg;
+				break;
+
+			case 'g':
+				genome = strtoull(optarg, NULL, 10);
+				break;
+
+			case 'c':
+				contigs = atoi(optarg);
+				break;
+
+			case 'r':
+				repeats = atof(optarg);
+				break;
+
+			case 'n':
+				gaps = atoi(optarg);
+				break;
+
+			case 'N':
+				gaplength = strtoull(optarg, NULL, 10);
+				break;
+
+			case 'q':
+				reads = strtoul(optarg, NULL, 10);
+				break;
+
+			case 'l':
+				length = atoi(optarg);
+				break;
+
+			case 'm':
+				if (parseMismatch(optarg, share) == -1) {
+					fprintf(stderr, "\nError: invalid mismatch distribution %s\n", optarg);
+					return -1;
+				}
+				break;
+
+			case 'u':
+				random = atof(optarg);
+				break;
+
+			case 's':
+				seed = strtoull(optarg, NULL, 10);
+				break;
+
+			default:
+				print_help();
+				return -1;
+		}
+	}
+
+	if ((contigs == 0) || (genome < contigs) || (length == 0) || (length > MAXLENGTH)) {
+		fprintf(stderr, "\nError: invalid genome, contigs or read length\n");
+		return -1;
+	}
+
+	/* a seed of 0 would stay 0 */
+	state = seed * 0x9E3779B97F4A7C15ULL + 1;
+
+	g = generateGenome(genome, repeats, gaps, gaplength);
+	if (g == NULL) {
+		fprintf(stderr, "\nError: allocating the genome\n");
+		return -1;
+	}
+
+	snprintf(name, sizeof(name), "%s.fa", output);
+	if (writeGenome(name, g, genome, contigs) == -1) {
+		free(g);
+		return -1;
+	}
+	snprintf(name, sizeof(name), "%s.fq", output);
+	if (writeReads(name, g, genome, contigs, reads, length, share, random) == -1) {
+		free(g);
+		return -1;
+	}
+
+	printf("%llu bases in %u contigs, %lu reads of %u bases\n", (unsigned long long) genome, contigs, reads, length);
+	free(g);
+	return 0;
+}
@@ -0,0 +1,186 @@
+#!/bin/sh
+#
+# check.sh
+# Project:	FPGA-DNA-Sequence-Search
+#
+# Regression check of the host program, started by "make check". A small
+# reference and reads from fpga-benchgen are searched on the CPU
+# (cpusearch.c) and the results serve as the expected output: runs
+# against fpga-emu with overflows, SAM with qualities, long reads and
+# --whole must give the same hits, and a run with lost packets must fail.
+# The BAM output is read back with fpga-bamcat and compared with the SAM
+# output. Edge cases of the read files (qualities starting with '@', '+'
+# lines with the name, CRLF, FASTA wrapped over lines, a line longer than
+# the buffer, reads longer than 256 bases, gzip) must give the hits of the
+# plain file, truncated gzip and BGZF files must fail, and the read cache
+# must find the copies of reads in later batches. The outputs are compared
+# sorted, as the boards write their results interleaved.
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+DIR=${CHECK_DIR:-$HERE/check}
+MISMATCH=3
+FAILED=0
+
+mkdir -p "$DIR"
+cd "$DIR" || exit 1
+rm -f ./*.pam ./*.sam ./*.bam ./*.log
+
+# name expected actual, both sorted before the comparison
+same() {
+	sort "$2" > "$2.sorted"
+	sort "$3" > "$3.sorted"
+	if cmp -s "$2.sorted" "$3.sorted"; then
+		echo "ok      $1"
+	else
+		echo "FAIL    $1 ($2 and $3 differ)"
+		FAILED=1
+	fi
+}
+
+# name status, 0 is ok
+status() {
+	if [ "$2" -eq 0 ]; then
+		echo "ok      $1"
+	else
+		echo "FAIL    $1"
+		FAILED=1
+	fi
+}
+
+# names of the references up to the first blank, as BAM keeps them
+bamnames() {
+	awk 'BEGIN { FS = OFS = "\t" }
+		/^@SQ/ { n = split($0, field, " "); $0 = field[1] " " field[2] " " field[n] }
+		!/^@/ { sub(/ .*/, " ", $3) }
+		{ print }' "$1"
+}
+
+cpu() {
+	"$HERE/main" -b ref.bindb -m "$MISMATCH" -r -c 1 "$@" > /dev/null
+}
+
+emu() {
+	"$HERE/main" -b ref.bindb -m "$MISMATCH" -r "$@" > /dev/null
+}
+
+# fpga-emu with the given options on a socket of its own
+start() {
+	stop
+	rm -f emu.sock
+	"$HERE/fpga-emu" -s "$DIR/emu.sock" "$@" > emu.log 2>&1 &
+	EMU=$!
+	sleep 1
+}
+
+stop() {
+	if [ -n "$EMU" ]; then
+		kill "$EMU" 2>/dev/null
+		wait "$EMU" 2>/dev/null
+		EMU=""
+	fi
+}
+
+EMU=""
+trap 'stop' EXIT
+printf 'SOCKET = "%s";\n' "$DIR/emu.sock" > mac.config
+
+"$HERE/fpga-benchgen" -o ref -g 500000 -c 4 -n 2 -N 5000 -q 1000 -l 50 -s 7 > /dev/null &&
+"$HERE/fpga-benchgen" -o long -g 500000 -c 4 -n 2 -N 5000 -q 200 -l 150 -s 7 > /dev/null &&
+"$HERE/fpga-benchgen" -o over -g 500000 -c 4 -n 2 -N 5000 -q 200 -l 256 -s 7 > /dev/null &&
+"$HERE/main" -d ref.fa -b ref.bindb -t > /dev/null || exit 1
+
+# CPU search as the expected output
+cpu -q ref.fq -o cpu
+cpu -q ref.fq -o cpu -s -Q
+cpu -q ref.fq -o cpuw -w
+cpu -q long.fq -o cpulong
+
+# fpga-emu against the CPU
+start
+emu -q ref.fq -o emu
+same "fpga-emu pam" cpu.pam emu.pam
+emu -q ref.fq -o emu -s -Q
+same "fpga-emu sam with qualities" cpu.sam emu.sam
+emu -q ref.fq -o emuw -w
+same "fpga-emu whole" cpuw.pam emuw.pam
+emu -q long.fq -o emulong
+same "fpga-emu long reads" cpulong.pam emulong.pam
+emu -q ref.fq -o bam -B -Q
+"$HERE/fpga-bamcat" bam.bam > bam.txt
+status "bam readable" $?
+bamnames cpu.sam > cpubam.txt
+same "bam as sam" cpubam.txt bam.txt
+
+# the read cache, two more copies of every read in later batches
+cat ref.fq ref.fq ref.fq > dup.fq
+cat cpu.pam > cpudup.pam
+grep -v '^@' cpu.pam >> cpudup.pam
+grep -v '^@' cpu.pam >> cpudup.pam
+"$HERE/main" -b ref.bindb -m "$MISMATCH" -r -i -q dup.fq -o dup > dup.log
+same "read cache" cpudup.pam dup.pam
+grep -q "^duplicate reads: 2000 " dup.log
+status "read cache counts the copies" $?
+
+# overflows of the result memory and lost packets
+start -o 50 -r 8
+emu -q ref.fq -o overflow
+same "fpga-emu overflows" cpu.pam overflow.pam
+start -l 0.05
+emu -q ref.fq -o lost 2> lost.log
+[ $? -ne 0 ]
+status "fpga-emu lost packets fail the run" $?
+stop
+
+# edge cases of the read files against the plain file
+awk 'NR % 8 == 4 { $0 = "@" substr($0, 2) } NR % 4 == 3 && NR % 8 == 7 { $0 = "+" substr(prev, 2) } { prev = (NR % 4 == 1) ? $0 : prev; print }' ref.fq > at.fq
+cpu -q at.fq -o at -s -Q
+cut -f 1-11 cpu.sam > cpu.fields
+cut -f 1-11 at.sam > at.fields
+same "fastq with '+' names and '@' qualities" cpu.fields at.fields
+awk '{ printf "%s\r\n", $0 }' at.fq > crlf.fq
+cpu -q crlf.fq -o crlf -s -Q
+same "fastq with CRLF" at.sam crlf.sam
+awk 'NR % 4 == 1 { name = substr($1, 2) } NR % 4 == 0 { print name, $0 }' at.fq | sort > at.quality
+awk '!/^@/ && $2 == "0" { print $1, $12 }' at.sam | sort -u > at.written
+join -v 2 at.quality at.written > at.wrong
+[ ! -s at.wrong ] && [ -s at.written ]
+status "fastq qualities starting with @" $?
+awk 'NR % 4 == 1 { print ">" substr($0, 2) } NR % 4 == 2 { for (i = 1; i <= length($0); i += 20) print substr($0, i, 20) }' ref.fq > wrapped.fa
+cpu -q wrapped.fa -o wrapped
+same "fasta over several lines" cpu.pam wrapped.pam
+{ head -c 5000000 /dev/zero | tr '\0' 'N'; echo; cat ref.fq; } > longline.fq
+cpu -q longline.fq -o longline
+same "line longer than the buffer" cpu.pam longline.pam
+awk 'NR % 4 == 2 { $0 = $0 "ACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGT" } NR % 4 == 0 { $0 = $0 "IIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIII" } { print }' over.fq > longer.fq
+cpu -q over.fq -o over
+cpu -q longer.fq -o longer
+same "reads longer than 256 bases" over.pam longer.pam
+gzip -c ref.fq > gz.fq.gz
+cpu -q gz.fq.gz -o gz
+same "gzip reads" cpu.pam gz.pam
+gzip -c ref.fa > gz.fa.gz
+"$HERE/main" -d gz.fa.gz -b gz.bindb -t > /dev/null
+cmp -s ref.bindb gz.bindb
+status "gzip database" $?
+head -c 20000 gz.fq.gz > cut.fq.gz
+! cpu -q cut.fq.gz -o cut 2> cut.log
+status "truncated gzip reads fail the run" $?
+head -c 100000 gz.fa.gz > cutdb.fa.gz
+! "$HERE/main" -d cutdb.fa.gz -b cutdb.bindb -t > cut.log 2>&1
+status "truncated gzip database fails" $?
+if command -v bgzip > /dev/null; then
+	bgzip -c ref.fq > bgzf.fq.gz
+	cpu -q bgzf.fq.gz -o bgzf
+	same "bgzf reads" cpu.pam bgzf.pam
+	head -c -28 bgzf.fq.gz > noeof.fq.gz
+	! cpu -q noeof.fq.gz -o noeof 2> cut.log
+	status "bgzf reads without the end-of-file block fail the run" $?
+else
+	echo "skip    bgzf reads, no bgzip"
+fi
+
+if [ "$FAILED" -ne 0 ]; then
+	echo "check failed"
+	exit 1
+fi
+echo "all checks passed"
@@ -0,0 +1,175 @@
+/*
+    client.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Client of the alignment daemon (fpga-align --daemon). It sends a job with
+    the query file, the mismatch threshold and the output name to the job
+    socket and waits for the summary of the search, or asks for the status
+    of the queue. The daemon keeps the boards, the index and the mapped
+    database between the jobs.
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "header/jobserver.h"
+
+static struct option client_lopts[] = {
+	{ "socket",		required_argument, NULL, 'S' },
+	{ "query",		required_argument, NULL, 'q' },
+	{ "output",		required_argument, NULL, 'o' },
+	{ "mismatch",	required_argument, NULL, 'm' },
+	{ "sam",		no_argument		 , NULL, 's' },
+	{ "bam",		no_argument		 , NULL, 'B' },
+	{ "quality",	no_argument		 , NULL, 'Q' },
+	{ "unmap",		no_argument		 , NULL, 'u' },
+	{ "queue",		no_argument		 , NULL, 'l' },
+	{ "stop",		no_argument		 , NULL, 'k' },
+	{ "help",		no_argument		 , NULL, 'h' },
+	{ 0, 0, 0, 0 }
+};
+
+static char client_sopts[] = "S:q:o:m:sBQulkh";
+
+static void print_help() {
+
+	printf("\nFPGA-Alignment client\n");
+	printf("Usage:\n");
+	printf("\tfpga-client [options] \n\n");
+	printf("Options:\n");
+	printf("\t--socket \t-S <path> \tjob socket of the daemon (default: %s)\n", JOB_SOCKET);
+	printf("\t--query \t-q <filename> \tquery input file\n");
+	printf("\t--output \t-o <filename> \tbase name for output files\n");
+	printf("\t--mismatch \t-m [int] number of mismatches (default: 0)\n");
+	printf("\t--sam \t\t-s \t \tsave output in SAM-format (default: no)\n");
+	printf("\t--bam \t\t-B \t\tsave output in BAM-format (default: no)\n");
+	printf("\t--quality \t-Q \t\twrite bases and qualities of the reads into SAM or BAM (default: no)\n");
+	printf("\t--unmap \t-u \t \tcreate map and unmap files (default: no)\n");
+	printf("\t--queue \t-l \t\tprint the queue and the latencies of the daemon\n");
+	printf("\t--stop \t\t-k \t\tstop the daemon after the queued jobs\n");
+	printf("\t--help \t\t-h \t\tprint this usage message\n");
+}
+
+/* the daemon runs in another directory */
+static int absolutePath(const char *name, char *path) {
+	char cwd[PATH_MAX];
+
+	if (name[0] == '/') {
+		if (strlen(name) >= JOB_PATH) {
+			return -1;
+		}
+		strcpy(path, name);
+		return 0;
+	}
+	if (getcwd(cwd, sizeof(cwd)) == NULL) {
+		return -1;
+	}
+	return (snprintf(path, JOB_PATH, "%s/%s", cwd, name) < JOB_PATH) ? 0 : -1;
+}
+
+int main(int argc, char** argv) {
+	static char query[JOB_PATH], output[JOB_PATH], request[2 * JOB_PATH + 64];
+	const char *socketname = JOB_SOCKET;
+	char *queryname = NULL, *outputname = NULL;
+	unsigned int mismatch = 0, flags = 0;
+	int opt, status = 0, stop = 0;
+
+	while ((opt = getopt_long(argc, argv, client_sopts, client_lopts, NULL)) != -1) {
+		switch (opt) {
+			case 'S':
+				socketname = optarg;
+				break;
+
+			case 'q':
+				queryname = optarg;
+				break;
+
+			case 'o':
+				outputname = optarg;
+				break;
+
+			case 'm':
+				mismatch = atoi(optarg);
+				break;
+
+			case 's':
+				flags = flags | JOB_SAM;
+				break;
+
+			case 'B':
+				flags = flags | JOB_BAM;
+				break;
+
+			case 'Q':
+				flags = flags | JOB_QUALITY;
+				break;
+
+			case 'u':
+				flags = flags | JOB_MAP;
+				break;
+
+			case 'l':
+				status = 1;
+				break;
+
+			case 'k':
+				stop = 1;
+				break;
+
+			default:
+				print_help();
+				return -1;
+		}
+	}
+
+	if (status) {
+		return jobRequest(socketname, "STATUS\n", stdout) == 0 ? 0 : 1;
+	}
+	if (stop) {
+		return jobRequest(socketname, "STOP\n", stdout) == 0 ? 0 : 1;
+	}
+
+	if ((queryname == NULL) || (outputname == NULL)) {
+		printf("No query or output file specified\n");
+		print_help();
+		return -1;
+	}
+	if ((absolutePath(queryname, query) == -1) || (absolutePath(outputname, output) == -1) ||
+		(strchr(query, '\t') != NULL) || (strchr(output, '\t') != NULL) ||
+		(strchr(query, '\n') != NULL) || (strchr(output, '\n') != NULL)) {
+		fprintf(stderr, "\nError: invalid file name\n");
+		return -1;
+	}
+
+	snprintf(request, sizeof(request), "JOB\t%u\t%x\t%s\t%s\n", mismatch, flags, query, output);
+	return jobRequest(socketname, request, stdout) == 0 ? 0 : 1;
+}
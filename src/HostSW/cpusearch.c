@@ -0,0 +1,531 @@
+/*
+    cpusearch.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Search engine for the host CPU. The reads are decoded from the readmap,
+    which is also loaded into the FPGA, and compared bit-parallel with every
+    text position of the binary database. A segment of the database is split
+    into shards, which are searched by one thread each. The windows of 8
+    (AVX-512) or 4 (AVX2) neighbouring text positions are compared with a
+    read in one step. The results are returned in the layout of the result
+    download of the FPGA.
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <immintrin.h>
+
+#include "header/readmap.h"
+#include "header/cpusearch.h"
+
+#define MIN_SHARD	(1 << 20)		/* minimal bases per thread */
+#define PLANE_PAD	32				/* zero bytes behind the bit planes */
+
+/* hits of one read in one shard */
+struct hits_t {
+	uint32_t *pos;
+	unsigned int count;
+	unsigned int size;
+	uint8_t min;
+};
+
+/* one thread of the search */
+struct shard_t {
+	const uint8_t *text;			/* packed segment */
+	uint32_t bases;					/* bases of the segment */
+	uint32_t start, end;			/* window positions of the shard */
+	uint32_t first;					/* position of bit 0 in the planes */
+	uint8_t *hi, *lo;				/* bit planes of the text */
+	unsigned long planesize;
+	struct hits_t *hits;			/* per read */
+	pthread_t thread;
+};
+
+struct read_bits *cpu_reads;
+uint8_t *cpu_mismatch;
+unsigned int cpu_readcount;
+int cpu_positions;
+
+struct shard_t *cpu_shards;
+unsigned int cpu_threads, cpu_used;
+unsigned int cpu_capacity;			/* reads with allocated hit lists */
+
+/* download state of cpuResults() */
+unsigned int *cpu_cursor;
+int cpu_pending;
+
+/* bases of one packed byte, in the low 4 bits of the bit planes */
+uint8_t nib_hi[256], nib_lo[256];
+
+typedef void (*kernel_t)(struct shard_t *shard, uint32_t s, uint32_t e);
+kernel_t cpu_kernel;
+const char *cpu_kernelname;
+
+/******************************************************************************
+ * Stores one hit of read r at window position s
+ ******************************************************************************/
+static void addHit(struct shard_t *shard, unsigned int r, uint32_t s) {
+
+	struct hits_t *h = &shard->hits[r];
+
+	if (h->count == h->size) {
+		h->size = h->size ? h->size * 2 : 64;
+		h->pos = (uint32_t*) realloc(h->pos, h->size * sizeof(uint32_t));
+	}
+	/* positions are reported like the FPGA, starting with 1 */
+	h->pos[h->count++] = s + 1;
+}
+
+/******************************************************************************
+ * Text window of 64 bases beginning at position s
+ ******************************************************************************/
+static inline uint64_t window(const uint8_t *plane, uint32_t s) {
+
+	uint64_t a, b;
+	unsigned int sh = s & 7;
+
+	memcpy(&a, plane + (s >> 3), 8);
+	memcpy(&b, plane + (s >> 3) + 8, 8);
+	return sh ? (a >> sh) | (b << (64 - sh)) : a;
+}
+
+/******************************************************************************
+ * Scalar search of the window positions [s, e), also used for the end of a
+ * segment where the reads must not exceed the text
+ ******************************************************************************/
+static void searchScalar(struct shard_t *shard, uint32_t s, uint32_t e) {
+
+	unsigned int r, mis;
+	uint64_t h, l;
+	struct read_bits *read;
+
+	for (; s < e; s++) {
+		h = window(shard->hi, s - shard->first);
+		l = window(shard->lo, s - shard->first);
+		for (r = 0; r < cpu_readcount; r++) {
+			read = &cpu_reads[r];
+			if (s + read->length > shard->bases) {
+				continue;
+			}
+			mis = __builtin_popcountll(((h ^ read->hi) | (l ^ read->lo)) & read->care);
+			if (mis < shard->hits[r].min) {
+				shard->hits[r].min = mis > MAX_MISMATCH ? MAX_MISMATCH : mis;
+			}
+			if (mis <= cpu_mismatch[r]) {
+				addHit(shard, r, s);
+			}
+		}
+	}
+}
+
+/******************************************************************************
+ * AVX2: 4 window positions per compare, popcount with a nibble table
+ ******************************************************************************/
+__attribute__((target("avx2")))
+static void searchAVX2(struct shard_t *shard, uint32_t s, uint32_t e) {
+
+	const __m256i table = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+											0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+	const __m256i low = _mm256_set1_epi8(0x0F);
+	__m256i shr, shl, H, L, x, c, thr, *minv;
+	uint64_t a, b;
+	uint32_t p;
+	unsigned int r, lane, mask;
+
+	minv = (__m256i*) aligned_alloc(32, cpu_readcount * sizeof(__m256i));
+	for (r = 0; r < cpu_readcount; r++) {
+		minv[r] = _mm256_set1_epi64x(MAX_MISMATCH);
+	}
+
+	for (; s + 4 <= e; s += 4) {
+		p = s - shard->first;
+		shr = _mm256_add_epi64(_mm256_set1_epi64x(p & 7), _mm256_setr_epi64x(0, 1, 2, 3));
+		shl = _mm256_sub_epi64(_mm256_set1_epi64x(64), shr);
+
+		memcpy(&a, shard->hi + (p >> 3), 8);
+		memcpy(&b, shard->hi + (p >> 3) + 8, 8);
+		H = _mm256_or_si256(_mm256_srlv_epi64(_mm256_set1_epi64x(a), shr),
+							_mm256_sllv_epi64(_mm256_set1_epi64x(b), shl));
+		memcpy(&a, shard->lo + (p >> 3), 8);
+		memcpy(&b, shard->lo + (p >> 3) + 8, 8);
+		L = _mm256_or_si256(_mm256_srlv_epi64(_mm256_set1_epi64x(a), shr),
+							_mm256_sllv_epi64(_mm256_set1_epi64x(b), shl));
+
+		for (r = 0; r < cpu_readcount; r++) {
+			x = _mm256_or_si256(_mm256_xor_si256(H, _mm256_set1_epi64x(cpu_reads[r].hi)),
+								_mm256_xor_si256(L, _mm256_set1_epi64x(cpu_reads[r].lo)));
+			x = _mm256_and_si256(x, _mm256_set1_epi64x(cpu_reads[r].care));
+			c = _mm256_add_epi8(_mm256_shuffle_epi8(table, _mm256_and_si256(x, low)),
+								_mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi64(x, 4), low)));
+			c = _mm256_sad_epu8(c, _mm256_setzero_si256());
+
+			/* counts are below 2^31, a signed compare is sufficient */
+			minv[r] = _mm256_blendv_epi8(minv[r], c, _mm256_cmpgt_epi64(minv[r], c));
+			thr = _mm256_set1_epi64x(cpu_mismatch[r]);
+			mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(c, thr))) ^ 0xF;
+			for (; mask; mask &= mask - 1) {
+				lane = __builtin_ctz(mask);
+				addHit(shard, r, s + lane);
+			}
+		}
+	}
+
+	for (r = 0; r < cpu_readcount; r++) {
+		uint64_t m[4];
+		_mm256_storeu_si256((__m256i*) m, minv[r]);
+		for (lane = 0; lane < 4; lane++) {
+			if (m[lane] < shard->hits[r].min) shard->hits[r].min = m[lane];
+		}
+	}
+	free(minv);
+
+	searchScalar(shard, s, e);
+}
+
+/******************************************************************************
+ * AVX-512: 8 window positions per compare with native popcount
+ ******************************************************************************/
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static void searchAVX512(struct shard_t *shard, uint32_t s, uint32_t e) {
+
+	__m512i shr, shl, H, L, x, c, *minv;
+	uint64_t a, b;
+	uint32_t p;
+	unsigned int r, lane;
+	__mmask8 mask;
+
+	minv = (__m512i*) aligned_alloc(64, cpu_readcount * sizeof(__m512i));
+	for (r = 0; r < cpu_readcount; r++) {
+		minv[r] = _mm512_set1_epi64(MAX_MISMATCH);
+	}
+
+	for (; s + 8 <= e; s += 8) {
+		p = s - shard->first;
+		shr = _mm512_add_epi64(_mm512_set1_epi64(p & 7), _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7));
+		shl = _mm512_sub_epi64(_mm512_set1_epi64(64), shr);
+
+		memcpy(&a, shard->hi + (p >> 3), 8);
+		memcpy(&b, shard->hi + (p >> 3) + 8, 8);
+		H = _mm512_or_si512(_mm512_srlv_epi64(_mm512_set1_epi64(a), shr),
+							_mm512_sllv_epi64(_mm512_set1_epi64(b), shl));
+		memcpy(&a, shard->lo + (p >> 3), 8);
+		memcpy(&b, shard->lo + (p >> 3) + 8, 8);
+		L = _mm512_or_si512(_mm512_srlv_epi64(_mm512_set1_epi64(a), shr),
+							_mm512_sllv_epi64(_mm512_set1_epi64(b), shl));
+
+		for (r = 0; r < cpu_readcount; r++) {
+			/* (H ^ hi) | (L ^ lo), the second step as ternary logic A | (B ^ C) */
+			x = _mm512_xor_si512(H, _mm512_set1_epi64(cpu_reads[r].hi));
+			x = _mm512_ternarylogic_epi64(x, L, _mm512_set1_epi64(cpu_reads[r].lo), 0xF6);
+			x = _mm512_and_si512(x, _mm512_set1_epi64(cpu_reads[r].care));
+			c = _mm512_popcnt_epi64(x);
+
+			minv[r] = _mm512_min_epu64(minv[r], c);
+			mask = _mm512_cmple_epu64_mask(c, _mm512_set1_epi64(cpu_mismatch[r]));
+			for (; mask; mask &= mask - 1) {
+				lane = __builtin_ctz(mask);
+				addHit(shard, r, s + lane);
+			}
+		}
+	}
+
+	for (r = 0; r < cpu_readcount; r++) {
+		uint64_t m = _mm512_reduce_min_epu64(minv[r]);
+		if (m < shard->hits[r].min) shard->hits[r].min = m;
+	}
+	free(minv);
+
+	searchScalar(shard, s, e);
+}
+
+/******************************************************************************
+ * Converts the packed bytes of a shard into bit planes and searches it
+ ******************************************************************************/
+static void *searchShard(void *arg) {
+
+	struct shard_t *shard = (struct shard_t*) arg;
+	uint32_t first, last, i, n, full;
+	unsigned int r;
+
+	/* planes begin at a byte boundary of the packed text */
+	first = shard->start & ~7u;
+	last = shard->end + MAX_BASES;
+	if (last > shard->bases) {
+		last = shard->bases;
+	}
+	n = (last - first + 7) / 8 + PLANE_PAD;
+
+	if (n > shard->planesize) {
+		shard->hi = (uint8_t*) realloc(shard->hi, n);
+		shard->lo = (uint8_t*) realloc(shard->lo, n);
+		shard->planesize = n;
+	}
+	memset(shard->hi, 0, n);
+	memset(shard->lo, 0, n);
+	shard->first = first;
+
+	for (i = first / 4; i * 4 < last; i++) {
+		unsigned int sh = 4 * ((i - first / 4) & 1);
+		shard->hi[(i - first / 4) >> 1] |= nib_hi[shard->text[i]] << sh;
+		shard->lo[(i - first / 4) >> 1] |= nib_lo[shard->text[i]] << sh;
+	}
+
+	for (r = 0; r < cpu_readcount; r++) {
+		shard->hits[r].count = 0;
+		shard->hits[r].min = MAX_MISMATCH;
+	}
+
+	/* all reads fit into the text up to this window position */
+	full = shard->bases >= MAX_BASES ? shard->bases - MAX_BASES + 1 : 0;
+	if (full > shard->end) {
+		full = shard->end;
+	}
+	if (full > shard->start) {
+		cpu_kernel(shard, shard->start, full);
+		searchScalar(shard, full, shard->end);
+	} else {
+		searchScalar(shard, shard->start, shard->end);
+	}
+
+	return NULL;
+}
+
+/******************************************************************************
+ * Selects the kernel and allocates the threads
+ ******************************************************************************/
+int cpuInit(unsigned int threads) {
+
+	unsigned int b, j, base;
+
+	if (threads == 0) {
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	cpu_threads = threads;
+
+	for (b = 0; b < 256; b++) {
+		nib_hi[b] = 0;
+		nib_lo[b] = 0;
+		for (j = 0; j < 4; j++) {
+			base = (b >> (2 * (3 - j))) & 3;
+			nib_hi[b] |= (base >> 1) << j;
+			nib_lo[b] |= (base & 1) << j;
+		}
+	}
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq")) {
+		cpu_kernel = searchAVX512;
+		cpu_kernelname = "AVX-512";
+	} else if (__builtin_cpu_supports("avx2")) {
+		cpu_kernel = searchAVX2;
+		cpu_kernelname = "AVX2";
+	} else {
+		cpu_kernel = searchScalar;
+		cpu_kernelname = "scalar";
+	}
+
+	cpu_shards = (struct shard_t*) calloc(cpu_threads, sizeof(struct shard_t));
+	if (cpu_shards == NULL) {
+		fprintf(stderr, "\nError: allocating search threads\n");
+		return -1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Name of the selected kernel
+ ******************************************************************************/
+const char *cpuKernel() {
+	return cpu_kernelname;
+}
+
+/******************************************************************************
+ * Loads the reads of one iteration from the readmap
+ ******************************************************************************/
+void cpuLoadReads(const char *readmap, const uint8_t *mismatch, unsigned int reads, int positions) {
+
+	unsigned int r, t;
+
+	cpu_reads 	 = (struct read_bits*) realloc(cpu_reads, reads * sizeof(struct read_bits));
+	cpu_mismatch = (uint8_t*) realloc(cpu_mismatch, reads);
+	cpu_cursor 	 = (unsigned int*) realloc(cpu_cursor, reads * sizeof(unsigned int));
+
+	for (r = 0; r < reads; r++) {
+		decodeRead(readmap + r * READ_BYTES, &cpu_reads[r]);
+		cpu_mismatch[r] = mismatch[r];
+	}
+
+	if (reads > cpu_capacity) {
+		for (t = 0; t < cpu_threads; t++) {
+			cpu_shards[t].hits = (struct hits_t*) realloc(cpu_shards[t].hits, reads * sizeof(struct hits_t));
+			memset(&cpu_shards[t].hits[cpu_capacity], 0, (reads - cpu_capacity) * sizeof(struct hits_t));
+		}
+		cpu_capacity = reads;
+	}
+	cpu_readcount = reads;
+	cpu_positions = positions;
+	cpu_used = 0;
+}
+
+/******************************************************************************
+ * Searches one segment of the packed database
+ ******************************************************************************/
+void cpuSearch(const char *text, unsigned long bytes) {
+
+	uint32_t bases = bytes * 4, step;
+	unsigned int t, r;
+
+	cpu_used = (bases + MIN_SHARD - 1) / MIN_SHARD;
+	if (cpu_used > cpu_threads) {
+		cpu_used = cpu_threads;
+	}
+	if (cpu_used == 0) {
+		cpu_used = 1;
+	}
+	step = (bases / cpu_used + 7) & ~7u;
+
+	for (t = 0; t < cpu_used; t++) {
+		cpu_shards[t].text  = (const uint8_t*) text;
+		cpu_shards[t].bases = bases;
+		cpu_shards[t].start = t * step;
+		cpu_shards[t].end   = (t == cpu_used - 1) ? bases : (t + 1) * step;
+	}
+
+	for (t = 1; t < cpu_used; t++) {
+		if (pthread_create(&cpu_shards[t].thread, NULL, searchShard, &cpu_shards[t])) {
+			fprintf(stderr, "\nError: creating search thread\n");
+			searchShard(&cpu_shards[t]);
+			cpu_shards[t].thread = 0;
+		}
+	}
+	searchShard(&cpu_shards[0]);
+	for (t = 1; t < cpu_used; t++) {
+		if (cpu_shards[t].thread) {
+			pthread_join(cpu_shards[t].thread, NULL);
+		}
+	}
+
+	for (r = 0; r < cpu_readcount; r++) {
+		cpu_cursor[r] = 0;
+	}
+	cpu_pending = 1;
+}
+
+/******************************************************************************
+ * Writes the results of the last segment in the layout of the FPGA: per read
+ * the number of positions (at most 0xFFFF) and the minimal mismatches,
+ * followed by the positions. Returns 1 while results are left for another
+ * call, like a new download after an overflow.
+ ******************************************************************************/
+int cpuResults(char *results, unsigned long size) {
+
+	unsigned long k = 0, room;
+	unsigned int r, t, c, n, total, skip, count, more = 0;
+	uint8_t min;
+	struct hits_t *h;
+
+	if (!cpu_pending) {
+		return 0;
+	}
+
+	/* room for positions behind the info words of all reads */
+	room = size / 4 - cpu_readcount;
+
+	for (r = 0; r < cpu_readcount; r++) {
+		total = 0;
+		min = MAX_MISMATCH;
+		for (t = 0; t < cpu_used; t++) {
+			total += cpu_shards[t].hits[r].count;
+			if (cpu_shards[t].hits[r].min < min) min = cpu_shards[t].hits[r].min;
+		}
+
+		count = total - cpu_cursor[r];
+		if (count > 0xFFFF) count = 0xFFFF;
+		if (cpu_positions) {
+			if (count > room) count = room;
+			room -= count;
+		}
+
+		results[k*4]   = count & 0xFF;
+		results[k*4+1] = count >> 8;
+		results[k*4+2] = min;
+		results[k*4+3] = 0;
+		k++;
+
+		/* copy the positions of all shards, skipping those already sent */
+		skip = cpu_cursor[r];
+		n = cpu_positions ? count : 0;
+		for (t = 0; (t < cpu_used) && n; t++) {
+			h = &cpu_shards[t].hits[r];
+			if (skip >= h->count) {
+				skip -= h->count;
+				continue;
+			}
+			c = h->count - skip;
+			if (c > n) {
+				c = n;
+			}
+			memcpy(results + k*4, h->pos + skip, c * 4);
+			k += c;
+			n -= c;
+			skip = 0;
+		}
+
+		cpu_cursor[r] += count;
+		if (cpu_cursor[r] < total) {
+			more = 1;
+		}
+	}
+
+	cpu_pending = more;
+	return 1;
+}
+
+/******************************************************************************
+ * Frees the search threads
+ ******************************************************************************/
+void cpuFree() {
+
+	unsigned int t, r;
+
+	for (t = 0; t < cpu_threads; t++) {
+		for (r = 0; r < cpu_capacity; r++) {
+			free(cpu_shards[t].hits[r].pos);
+		}
+		free(cpu_shards[t].hits);
+		free(cpu_shards[t].hi);
+		free(cpu_shards[t].lo);
+	}
+	free(cpu_shards);
+	free(cpu_reads);
+	free(cpu_mismatch);
+	free(cpu_cursor);
+}
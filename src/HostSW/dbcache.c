@@ -0,0 +1,203 @@
+/*
+    dbcache.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Memory of the binary database. The default maps the file and asks the
+    kernel to read the window ahead of the stream in the background, so the
+    stream thread does not wait for the disk in the middle of a burst. A
+    pinned database is copied into 2 MB pages, from hugetlbfs or else as
+    transparent huge pages, and locked, so neither page faults nor TLB
+    misses of 4 KB pages slow the sender. faultStart() and faultStop()
+    count the page faults and the dTLB load misses of the search.
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "header/dbcache.h"
+
+#define READ_CHUNK	(64UL << 20)		/* bytes per read of a pinned database */
+
+/* the database into anonymous memory of 2 MB pages */
+static int copyPinned(struct dbcache_t *c, int fd) {
+	uint64_t done = 0;
+	ssize_t n;
+
+	c->length = (c->size + DB_HUGEPAGE - 1) & ~(DB_HUGEPAGE - 1);
+	if (c->length == 0) {
+		c->length = DB_HUGEPAGE;
+	}
+
+	c->base = MAP_FAILED;
+#ifdef MAP_HUGETLB
+	c->base = mmap(NULL, c->length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	c->data = (char*) c->base;
+	c->hugepages = 2;
+#endif
+	if (c->base == MAP_FAILED) {
+		/* transparent huge pages need a range aligned to 2 MB */
+		c->length = c->length + DB_HUGEPAGE;
+		c->base = mmap(NULL, c->length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (c->base == MAP_FAILED) {
+			fprintf(stderr, "\nError: allocating %llu bytes for the database\n", (unsigned long long) c->size);
+			return -1;
+		}
+		c->data = (char*) (((uintptr_t) c->base + DB_HUGEPAGE - 1) & ~(uintptr_t) (DB_HUGEPAGE - 1));
+		c->hugepages = 0;
+#ifdef MADV_HUGEPAGE
+		if (madvise(c->data, c->length - DB_HUGEPAGE, MADV_HUGEPAGE) == 0) {
+			c->hugepages = 1;
+		}
+#endif
+	}
+
+	while (done < c->size) {
+		n = pread(fd, c->data + done, (c->size - done < READ_CHUNK) ? c->size - done : READ_CHUNK, done);
+		if ((n < 0) && (errno == EINTR)) {
+			continue;
+		}
+		if (n <= 0) {
+			fprintf(stderr, "\nError: reading the database\n");
+			return -1;
+		}
+		done = done + n;
+	}
+	mprotect(c->base, c->length, PROT_READ);
+
+	c->locked = (mlock(c->data, c->size) == 0);
+	if (!c->locked) {
+		fprintf(stderr, "Warning: can not lock the database in memory (%s), see ulimit -l\n", strerror(errno));
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Maps the binary database of size bytes from fd, with pin copied into
+ * locked memory of 2 MB pages. The file can be closed afterwards.
+ ******************************************************************************/
+int dbLoad(struct dbcache_t *c, int fd, uint64_t size, int pin) {
+
+	memset(c, 0, sizeof(struct dbcache_t));
+	c->size = size;
+	c->pinned = pin;
+
+	if (pin) {
+		if (copyPinned(c, fd) == -1) {
+			dbFree(c);
+			return -1;
+		}
+		return 0;
+	}
+
+	c->length = size;
+	c->base = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (c->base == MAP_FAILED) {
+		c->base = NULL;
+		fprintf(stderr, "\nError: mapping db\n");
+		return -1;
+	}
+	c->data = (char*) c->base;
+	return 0;
+}
+
+/******************************************************************************
+ * Reads up to DB_PREFETCH bytes of the mapped database from byte from on in
+ * the background; to ends the range. Pinned data is already in memory.
+ ******************************************************************************/
+void dbPrefetch(const struct dbcache_t *c, uint64_t from, uint64_t to) {
+	uintptr_t start, end;
+
+	if (c->pinned || (from >= to) || (from >= c->size)) {
+		return;
+	}
+	if (to > c->size) {
+		to = c->size;
+	}
+	if (to - from > DB_PREFETCH) {
+		to = from + DB_PREFETCH;
+	}
+
+	start = ((uintptr_t) c->data + from) & ~(uintptr_t) (sysconf(_SC_PAGESIZE) - 1);
+	end = (uintptr_t) c->data + to;
+	madvise((void*) start, end - start, MADV_WILLNEED);
+}
+
+void dbFree(struct dbcache_t *c) {
+	if ((c->base != NULL) && (c->base != MAP_FAILED)) {
+		munmap(c->base, c->length);
+	}
+	c->base = NULL;
+	c->data = NULL;
+}
+
+/******************************************************************************
+ * Starts counting the page faults and, where the kernel permits, the dTLB
+ * load misses of the process and of the threads it starts afterwards
+ ******************************************************************************/
+void faultStart(struct faultcount_t *f) {
+	struct perf_event_attr attr;
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	f->minor = usage.ru_minflt;
+	f->major = usage.ru_majflt;
+	f->tlb = -1;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.inherit = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	f->tlbfd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+void faultStop(struct faultcount_t *f) {
+	struct rusage usage;
+	long long count;
+
+	getrusage(RUSAGE_SELF, &usage);
+	f->minor = usage.ru_minflt - f->minor;
+	f->major = usage.ru_majflt - f->major;
+
+	if (f->tlbfd >= 0) {
+		if (read(f->tlbfd, &count, sizeof(count)) == sizeof(count)) {
+			f->tlb = count;
+		}
+		close(f->tlbfd);
+		f->tlbfd = -1;
+	}
+}
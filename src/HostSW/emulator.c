@@ -0,0 +1,711 @@
+/*
+    emulator.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Software stand-in for the ML605 search design. It answers the control
+    codes of the raw Ethernet protocol, loads the reads into emulated search
+    units, searches the streamed database and returns the results in the
+    same layout as the FPGA. The host program is connected either over an
+    AF_UNIX datagram socket (SOCKET in mac.config) or over one end of a
+    veth pair (INTERFACE in mac.config).
+
+    fpga-emu [options]
+    Options:
+    -s <path>		AF_UNIX datagram socket (default: fpga-emu.sock)
+    -e <ifname>		raw Ethernet on interface, e.g. the peer of a veth pair
+    -u [int]		number of search units (default: 600)
+    -5				identify as Virtex-5 instead of Virtex-6
+    -f [int]		size of the text FIFO in bytes (default: 65535)
+    -r [int]		result memory per unit in positions (default: 511)
+    -o [int]		induce an overflow every n database packets (default: off)
+    -l [float]		probability for the loss of a database packet (default: 0)
+    -n				no search, only flow-control (all reads unmapped)
+    -v				print protocol messages
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/if_arp.h>
+
+#include "header/protocol.h"
+#include "header/readmap.h"
+
+#define UNIT_DATA	 136		/* control word + readmap per unit */
+
+/* emulated search unit */
+struct unit_t {
+	struct read_bits read;
+	uint8_t  mismatch;			/* threshold of the unit */
+	uint8_t  active;
+	uint8_t  positions;			/* store positions for this unit */
+	uint8_t  min;				/* minimal number of mismatches */
+	uint16_t count;				/* stored positions */
+	uint32_t *pos;
+};
+
+enum STATE {
+	st_idle,					/* waiting for reads */
+	st_load,					/* receiving reads */
+	st_stream,					/* receiving the database */
+	st_overflow,				/* result memory full, waiting for download */
+	st_finished					/* segment searched, waiting for next segment */
+};
+
+/* options */
+struct emuArgs_t {
+	char *socketname;
+	char *ifname;
+	unsigned int units;
+	unsigned int v5;
+	unsigned int fifo;
+	unsigned int capacity;
+	unsigned int overflow_every;
+	double loss;
+	unsigned int nosearch;
+	unsigned int verbose;
+} emu_opt;
+
+/* connection */
+int sock;
+struct sockaddr_un peer_un;
+struct sockaddr_ll peer_ll;
+char fpga_mac[6] = {0x00, 0x0a, 0x35, 0x02, 0x2a, 0x42};
+char host_mac[6];
+int ifindex;
+
+/* device state */
+enum STATE state = st_idle;
+struct unit_t *units;
+unsigned int loaded, unitcount;
+int send_positions;
+
+/* result memory of all units in the download layout */
+uint8_t *results;
+
+/* text FIFO: packed bytes which are received but not yet searched */
+uint8_t *fifo;
+unsigned int fifo_fill, fifo_base;	/* fill in bytes, next base in fifo[0] */
+uint64_t text_hi, text_lo;			/* text window, bit 63 is the newest base */
+uint32_t text_pos;					/* bases shifted into the window */
+unsigned int grant, granted;		/* packets allowed by the last credit */
+unsigned int packets_searched;
+int last_data, downloaded;
+
+/* statistics */
+unsigned long rx_frames, tx_frames, lost_frames, overflows, hits;
+
+/******************************************************************************
+ * Sends one payload (without Ethernet header) to the host
+ ******************************************************************************/
+static void reply(uint8_t *payload, unsigned int length) {
+
+	uint8_t frame[BUF_SIZE + 16];
+	int sd;
+
+	if (emu_opt.ifname == NULL) {
+		sd = sendto(sock, payload, length, 0, (struct sockaddr *)&peer_un, sizeof(peer_un));
+	} else {
+		memcpy(frame, host_mac, 6);
+		memcpy(frame+6, fpga_mac, 6);
+		frame[12] = ETH_P_FPGA >> 8;
+		frame[13] = ETH_P_FPGA & 0xFF;
+		memcpy(frame+14, payload, length);
+		length = length + 14;
+		if (length < CTR_BUF_SIZE) {
+			memset(frame + length, 0, CTR_BUF_SIZE - length);
+			length = CTR_BUF_SIZE;
+		}
+		sd = sendto(sock, frame, length, 0, (struct sockaddr *)&peer_ll, sizeof(peer_ll));
+	}
+	if (sd == -1) {
+		perror("fpga-emu: sending");
+	}
+	tx_frames++;
+}
+
+/******************************************************************************
+ * Sends a control message with a 16 bit argument
+ ******************************************************************************/
+static void reply_control(uint8_t ctr, uint16_t value) {
+
+	uint8_t payload[CTR_BUF_SIZE - 14];
+
+	memset(payload, 0, sizeof(payload));
+	payload[0] = ctr;
+	memcpy(payload+1, &value, 2);
+
+	if (emu_opt.verbose) {
+		printf("-> 0x%02x %u\n", ctr, value);
+	}
+	reply(payload, sizeof(payload));
+}
+
+/******************************************************************************
+ * Packets the host sends on a credit, computed like in stream()
+ ******************************************************************************/
+static unsigned int creditPackets(unsigned int bytes) {
+
+	unsigned int packets = (bytes / REAL_DB_DATA) - 4;
+	if (packets > 43) {
+		packets = 2;
+	}
+	return packets;
+}
+
+/******************************************************************************
+ * Grants the free space of the text FIFO to the host
+ ******************************************************************************/
+static void credit(uint8_t ctr) {
+
+	unsigned int free_bytes = emu_opt.fifo - fifo_fill;
+
+	if (free_bytes > 0xFFFF) {
+		free_bytes = 0xFFFF;
+	}
+	grant = creditPackets(free_bytes);
+	granted = 0;
+	reply_control(ctr, (uint16_t) free_bytes);
+}
+
+/******************************************************************************
+ * Loads the units of one packet. The first packet holds the number of units
+ * and the global flags in front of the unit data.
+ ******************************************************************************/
+static void loadReads(uint8_t *data, unsigned int length) {
+
+	unsigned int i, n = length / UNIT_DATA;
+	struct unit_t *unit;
+
+	for (i = 0; (i < n) && (loaded < unitcount); i++) {
+		unit = &units[loaded];
+		unit->mismatch	= data[i * UNIT_DATA] & 7;
+		unit->positions = send_positions && !(data[i * UNIT_DATA + 1] & 0x08);
+		unit->active	= (data[i * UNIT_DATA + 2] & 0x08) != 0;
+		unit->count		= 0;
+		unit->min		= MAX_MISMATCH;
+		decodeRead((char*) data + i * UNIT_DATA + 4, &unit->read);
+		loaded++;
+	}
+}
+
+/******************************************************************************
+ * Compares all units with the text window ending at the newest base.
+ * "valid" is the number of valid bases in the window, counted from its start.
+ * Returns 1 if the result memory of a unit is full.
+ ******************************************************************************/
+static int searchWindow(unsigned int valid) {
+
+	unsigned int u, mis, full = 0;
+	uint32_t start = text_pos - MAX_BASES;
+	struct unit_t *unit;
+
+	for (u = 0; u < unitcount; u++) {
+		unit = &units[u];
+		if (!unit->active || unit->read.length > valid) {
+			continue;
+		}
+		mis = __builtin_popcountll(((text_hi ^ unit->read.hi) | (text_lo ^ unit->read.lo)) & unit->read.care);
+		if (mis > MAX_MISMATCH) {
+			mis = MAX_MISMATCH;
+		}
+		if (mis < unit->min) {
+			unit->min = mis;
+		}
+		if (mis <= unit->mismatch) {
+			if (unit->positions) {
+				unit->pos[unit->count] = start + 1;
+			}
+			unit->count++;
+			hits++;
+			if (unit->count == emu_opt.capacity) {
+				full = 1;
+			}
+		}
+	}
+	return full;
+}
+
+/******************************************************************************
+ * Shifts one base into the text window
+ ******************************************************************************/
+static void shiftBase(unsigned int base) {
+
+	text_hi = (text_hi >> 1) | ((uint64_t) (base >> 1) << 63);
+	text_lo = (text_lo >> 1) | ((uint64_t) (base & 1) << 63);
+	text_pos++;
+}
+
+/******************************************************************************
+ * Searches the text FIFO until it is empty or the result memory is full.
+ * Returns 1 on overflow.
+ ******************************************************************************/
+static int searchFifo() {
+
+	unsigned int i, full = 0;
+
+	for (i = 0; (i < fifo_fill) && !full; i++) {
+		while ((fifo_base < 4) && !full) {
+			shiftBase((fifo[i] >> (2 * (3 - fifo_base))) & 3);
+			fifo_base++;
+			if ((text_pos >= MAX_BASES) && !emu_opt.nosearch) {
+				full = searchWindow(MAX_BASES);
+			}
+		}
+		if (fifo_base == 4) {
+			fifo_base = 0;
+		} else {
+			break;
+		}
+	}
+	memmove(fifo, fifo + i, fifo_fill - i);
+	fifo_fill = fifo_fill - i;
+
+	return full;
+}
+
+/******************************************************************************
+ * Shifts the end of the text through the window, so that reads shorter
+ * than the window are compared at the last positions of the segment.
+ * The result memory has room for these windows beyond its capacity.
+ ******************************************************************************/
+static void finishSegment() {
+
+	uint32_t end = text_pos;
+
+	while (!emu_opt.nosearch && (end > 0) && (text_pos < end + MAX_BASES - 1)) {
+		shiftBase(0);
+		if (text_pos >= MAX_BASES) {
+			searchWindow(end - (text_pos - MAX_BASES));
+		}
+	}
+	text_hi = 0;
+	text_lo = 0;
+	text_pos = 0;
+}
+
+/******************************************************************************
+ * Starts the search of a new segment and grants the text FIFO to the host
+ ******************************************************************************/
+static void startSegment() {
+
+	fifo_fill = 0;
+	fifo_base = 0;
+	last_data = 0;
+	text_hi = 0;
+	text_lo = 0;
+	text_pos = 0;
+	state = st_stream;
+	credit(ctr_send_DB);
+}
+
+/******************************************************************************
+ * Raises an overflow to the host, the search waits for the download
+ ******************************************************************************/
+static void overflow() {
+
+	state = st_overflow;
+	downloaded = 0;
+	overflows++;
+	reply_control(ctr_overflow, 0);
+}
+
+/******************************************************************************
+ * Continues the search after the download of the results
+ ******************************************************************************/
+static void resume() {
+
+	state = st_stream;
+	if (searchFifo()) {
+		overflow();
+		return;
+	}
+	if (last_data) {
+		finishSegment();
+		state = st_finished;
+		reply_control(ctr_finished_search, 0);
+		return;
+	}
+	if (granted >= grant) {
+		credit(ctr_send_next);
+	}
+}
+
+/******************************************************************************
+ * Sends the result memory of all units, one word with the number of
+ * positions and the minimal mismatches, followed by the positions. The
+ * first packet carries one byte of padding behind the control code.
+ ******************************************************************************/
+static void sendResults() {
+
+	uint8_t payload[DATA_SIZE + 2];
+	unsigned int u, j, fill, offset, size, length = 0;
+	uint32_t word;
+
+	for (u = 0; u < unitcount; u++) {
+		word = units[u].count | (units[u].min << 16);
+		memcpy(results + length, &word, 4);
+		length += 4;
+		if (units[u].positions) {
+			for (j = 0; j < units[u].count; j++) {
+				memcpy(results + length, &units[u].pos[j], 4);
+				length += 4;
+			}
+		}
+		units[u].count = 0;
+		units[u].min = MAX_MISMATCH;
+	}
+
+	offset = 0;
+	fill = 2;
+	payload[0] = ctr_data;
+	payload[1] = 0;
+	do {
+		size = length - offset;
+		if (size > sizeof(payload) - fill) {
+			size = sizeof(payload) - fill;
+		}
+		memcpy(payload + fill, results + offset, size);
+		reply(payload, fill + size);
+		offset += size;
+		fill = 1;
+	} while (offset < length);
+
+	reply_control(ctr_finished_sending, 0);
+}
+
+/******************************************************************************
+ * Handles one frame of the host
+ ******************************************************************************/
+static void handle(uint8_t *frame, unsigned int length) {
+
+	uint8_t ctr = frame[14], id = frame[15];
+	uint8_t *data = frame + 16;
+	unsigned int size = length > 16 ? length - 16 : 0;
+	uint16_t count;
+
+	rx_frames++;
+	if (emu_opt.verbose) {
+		printf("<- 0x%02x id %u length %u\n", ctr, id, length);
+	}
+
+	switch (ctr) {
+	case ctr_getid:
+		reply_control(emu_opt.v5 ? info_v5 : info_v6, emu_opt.units / 2);
+		break;
+
+	case ctr_reset:		/* also ctr_finished_iteration */
+		state = st_idle;
+		loaded = 0;
+		unitcount = 0;
+		break;
+
+	case ctr_first_data:
+	case ctr_data:
+		if (state == st_idle && ctr == ctr_first_data) {
+			memcpy(&count, data, 2);
+			loaded = 0;
+			unitcount = (unsigned int) count + 1;
+			if (unitcount > emu_opt.units) {
+				unitcount = emu_opt.units;
+			}
+			send_positions = (data[2] & 0x10) != 0;
+			state = st_load;
+			loadReads(data + 4, size - 4);
+		} else if (state == st_load) {
+			if (loaded < unitcount) {
+				loadReads(data, size);
+			} else {
+				/* closing packet of the reads */
+				startSegment();
+			}
+		} else if (state == st_stream || state == st_overflow) {
+			granted++;
+			if ((emu_opt.loss > 0) && (drand48() < emu_opt.loss)) {
+				uint8_t payload[CTR_BUF_SIZE - 14];
+				memset(payload, 0, sizeof(payload));
+				payload[0] = error;
+				payload[1] = id;
+				lost_frames++;
+				reply(payload, sizeof(payload));
+				break;
+			}
+			size = (size > 1 + REAL_DB_DATA) ? REAL_DB_DATA : (size > 0 ? size - 1 : 0);
+			if (fifo_fill + size > emu_opt.fifo + BUF_SIZE) {
+				fprintf(stderr, "fpga-emu: text FIFO overrun\n");
+				size = emu_opt.fifo + BUF_SIZE - fifo_fill;
+			}
+			memcpy(fifo + fifo_fill, data + 1, size);
+			fifo_fill += size;
+			packets_searched++;
+
+			if (state == st_overflow) {
+				break;
+			}
+			if (searchFifo() || (emu_opt.overflow_every &&
+					(packets_searched % emu_opt.overflow_every) == 0)) {
+				overflow();
+			} else if (granted >= grant) {
+				credit(ctr_send_next);
+			}
+		}
+		break;
+
+	case ctr_last_data:
+		if (state == st_stream) {
+			last_data = 1;
+			resume();
+		} else if (state == st_overflow) {
+			last_data = 1;
+		}
+		break;
+
+	case ctr_get_data:
+		sendResults();
+		if (state == st_overflow) {
+			downloaded = 1;
+		}
+		break;
+
+	case ctr_overflow_ready:
+		/* the host acknowledges the overflow before the download and
+		 * releases the search after it */
+		if (state == st_overflow && downloaded) {
+			resume();
+		}
+		break;
+
+	case ctr_next_segment:
+		if (state == st_finished || state == st_stream) {
+			startSegment();
+		}
+		break;
+
+	default:
+		if (emu_opt.verbose) {
+			printf("unknown control 0x%02x\n", ctr);
+		}
+		break;
+	}
+}
+
+/******************************************************************************
+ * Opens the AF_UNIX socket or the raw socket on the given interface
+ ******************************************************************************/
+static int openDevice() {
+
+	struct sockaddr_un addr;
+	struct sockaddr_ll ll;
+	struct ifreq ifr;
+
+	if (emu_opt.ifname == NULL) {
+		sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+		if (sock == -1) {
+			perror("fpga-emu: socket");
+			return -1;
+		}
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, emu_opt.socketname, sizeof(addr.sun_path)-1);
+		unlink(addr.sun_path);
+		if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+			perror("fpga-emu: bind");
+			return -1;
+		}
+		printf("fpga-emu: listening on %s\n", emu_opt.socketname);
+		return 0;
+	}
+
+	sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_FPGA));
+	if (sock == -1) {
+		perror("fpga-emu: socket");
+		return -1;
+	}
+
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, emu_opt.ifname, IFNAMSIZ-1);
+	if (ioctl(sock, SIOCGIFINDEX, &ifr) == -1) {
+		fprintf(stderr, "fpga-emu: unknown interface %s\n", emu_opt.ifname);
+		return -1;
+	}
+	ifindex = ifr.ifr_ifindex;
+
+	memset(&ll, 0, sizeof(ll));
+	ll.sll_family	= AF_PACKET;
+	ll.sll_ifindex	= ifindex;
+	ll.sll_protocol	= htons(ETH_P_FPGA);
+	if (bind(sock, (struct sockaddr *)&ll, sizeof(ll)) == -1) {
+		perror("fpga-emu: bind");
+		return -1;
+	}
+
+	memset(&peer_ll, 0, sizeof(peer_ll));
+	peer_ll.sll_family	 = AF_PACKET;
+	peer_ll.sll_ifindex	 = ifindex;
+	peer_ll.sll_protocol = htons(ETH_P_FPGA);
+	peer_ll.sll_halen	 = 6;
+
+	printf("fpga-emu: listening on %s\n", emu_opt.ifname);
+	return 0;
+}
+
+/******************************************************************************
+ * Reads the command line options
+ ******************************************************************************/
+static int readingEmuOptions(int argc, char** argv) {
+
+	int opt;
+
+	emu_opt.socketname 	   = "fpga-emu.sock";
+	emu_opt.ifname 		   = NULL;
+	emu_opt.units 		   = MAXUNITS_V6;
+	emu_opt.v5 			   = 0;
+	emu_opt.fifo 		   = 0xFFFF;
+	emu_opt.capacity 	   = 511;
+	emu_opt.overflow_every = 0;
+	emu_opt.loss 		   = 0;
+	emu_opt.nosearch 	   = 0;
+	emu_opt.verbose 	   = 0;
+
+	while ((opt = getopt(argc, argv, "s:e:u:5f:r:o:l:nvh")) != -1) {
+		switch (opt) {
+			case 's': emu_opt.socketname 	 = optarg; 					break;
+			case 'e': emu_opt.ifname 		 = optarg; 					break;
+			case 'u': emu_opt.units 		 = atoi(optarg) & ~1u;		break;
+			case '5': emu_opt.v5 			 = 1; 						break;
+			case 'f': emu_opt.fifo 			 = atoi(optarg); 			break;
+			case 'r': emu_opt.capacity 		 = atoi(optarg); 			break;
+			case 'o': emu_opt.overflow_every = atoi(optarg); 			break;
+			case 'l': emu_opt.loss 			 = atof(optarg); 			break;
+			case 'n': emu_opt.nosearch 		 = 1; 						break;
+			case 'v': emu_opt.verbose 		 = 1; 						break;
+			default:
+				printf("\nFPGA-Emulator\n");
+				printf("Usage:\n");
+				printf("\tfpga-emu [options] \n\n");
+				printf("Options:\n");
+				printf("\t-s <path> \tAF_UNIX datagram socket (default: fpga-emu.sock)\n");
+				printf("\t-e <ifname> \traw Ethernet on interface, e.g. peer of a veth pair\n");
+				printf("\t-u [int] \tnumber of search units (default: 600)\n");
+				printf("\t-5 \t\tidentify as Virtex-5 (default: Virtex-6)\n");
+				printf("\t-f [int] \ttext FIFO in bytes (default: 65535)\n");
+				printf("\t-r [int] \tresult memory per unit in positions (default: 511)\n");
+				printf("\t-o [int] \tinduce an overflow every n database packets (default: off)\n");
+				printf("\t-l [float] \tloss probability of database packets (default: 0)\n");
+				printf("\t-n \t\tno search, flow-control only\n");
+				printf("\t-v \t\tprint protocol messages\n");
+				return -1;
+		}
+	}
+
+	if (emu_opt.units < 2 || emu_opt.capacity < 1 || emu_opt.capacity > 1023) {
+		fprintf(stderr, "fpga-emu: invalid number of units or result memory\n");
+		return -1;
+	}
+	if (emu_opt.fifo < 5 * REAL_DB_DATA) {
+		fprintf(stderr, "fpga-emu: text FIFO smaller than %u bytes\n", 5 * REAL_DB_DATA);
+		return -1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Main loop of the emulator
+ ******************************************************************************/
+int main(int argc, char** argv) {
+
+	uint8_t frame[BUF_SIZE + 16];
+	struct sockaddr_un from_un;
+	struct sockaddr_ll from_ll;
+	socklen_t fromlen;
+	unsigned int u;
+	int length;
+
+	if (readingEmuOptions(argc, argv) == -1) {
+		return -1;
+	}
+	if (emu_opt.verbose) {
+		setvbuf(stdout, NULL, _IOLBF, 0);
+	}
+
+	units = (struct unit_t*) calloc(emu_opt.units, sizeof(struct unit_t));
+	for (u = 0; u < emu_opt.units; u++) {
+		units[u].pos = (uint32_t*) malloc((emu_opt.capacity + MAX_BASES) * sizeof(uint32_t));
+	}
+	results = (uint8_t*) malloc(emu_opt.units * (emu_opt.capacity + MAX_BASES + 1) * 4);
+	fifo = (uint8_t*) malloc(emu_opt.fifo + 2 * BUF_SIZE);
+	srand48(getpid());
+
+	if (openDevice() == -1) {
+		return -1;
+	}
+
+	while (1) {
+		if (emu_opt.ifname == NULL) {
+			fromlen = sizeof(from_un);
+			length = recvfrom(sock, frame, sizeof(frame), 0, (struct sockaddr *)&from_un, &fromlen);
+			if (length > 0) {
+				peer_un = from_un;
+			}
+		} else {
+			fromlen = sizeof(from_ll);
+			length = recvfrom(sock, frame, sizeof(frame), 0, (struct sockaddr *)&from_ll, &fromlen);
+			if (length > 0 && (from_ll.sll_pkttype == PACKET_OUTGOING ||
+					memcmp(frame+6, fpga_mac, 6) == 0)) {
+				continue;	/* own frames */
+			}
+			if (length > 0) {
+				memcpy(host_mac, frame+6, 6);
+				memcpy(fpga_mac, frame, 6);
+				memcpy(peer_ll.sll_addr, host_mac, 6);
+			}
+		}
+		if (length < 16) {
+			continue;
+		}
+		handle(frame, length);
+
+		if (emu_opt.verbose && frame[14] == ctr_finished_iteration) {
+			printf("frames rx %lu tx %lu lost %lu overflows %lu hits %lu\n",
+					rx_frames, tx_frames, lost_frames, overflows, hits);
+		}
+	}
+
+	return 0;
+}
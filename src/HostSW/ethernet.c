@@ -32,10 +32,17 @@
 	SOFTWARE. 
  */
 
+/* sendmmsg and struct mmsghdr */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <sys/ioctl.h>
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <asm/types.h>
 
@@ -45,6 +52,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <signal.h>
+#include <poll.h>
+#include <net/if.h>
 
 #include <linux/if_packet.h>
 #include <linux/if_ether.h>
@@ -54,40 +63,65 @@
 
 
 #include "header/gettime.h"
+#include "header/protocol.h"
+#include "header/ethernet.h"
+#include "header/trace.h"
 
-#define CTR_BUF_SIZE 60
+/* defaults of a board without own entry in mac.config */
+static const char host_mac[6] = {0x00, 0x19, 0x99, 0x12, 0x3d, 0x08};
+static const char client_mac[6] = {0x00, 0x0a, 0x35, 0x02, 0x2a, 0x42};
 
-/* MAC and interface*/
- char host_mac[6] = {0x00, 0x19, 0x99, 0x12, 0x3d, 0x08};
- char client_mac[6] = {0x00, 0x0a, 0x35, 0x02, 0x2a, 0x42};
-const char* ifname = "eth1";
+/*****************************************************************************
+* Reads interface, socket and MACs of one board from a group of mac.config
+******************************************************************************/
+static void readDevice(const config_setting_t *group, struct device_t *dev) {
+
+	const config_setting_t *mac;
+	const char *name;
+	int count = 0, i;
+
+	memset(dev, 0, sizeof(struct device_t));
+	memcpy(dev->host_mac, host_mac, 6);
+	memcpy(dev->client_mac, client_mac, 6);
+	strcpy(dev->ifname, "eth1");
 
-/* Socketdescriptor */
-int send_socket = 0;
-int recv_socket = 0;
-struct sockaddr_ll sa;
-struct sockaddr_ll ra;
-struct ifreq ifinfo;
+	/* interface of the board, e.g. one end of a veth pair for fpga-emu */
+	if (config_setting_lookup_string(group, "INTERFACE", &name)) {
+		strncpy(dev->ifname, name, IFNAMSIZ-1);
+	}
+
+	/* datagram socket of fpga-emu instead of a network interface */
+	if (config_setting_lookup_string(group, "SOCKET", &name)) {
+		strncpy(dev->devsocket, name, sizeof(dev->devsocket)-1);
+	}
+
+	mac = config_setting_get_member(group, "FPGA");
+	count = (mac != NULL) ? config_setting_length(mac) : 0;
+	if(count == 6) {
+		for (i = 0; i < count; i++) {
+			dev->client_mac[i] = config_setting_get_int_elem(mac, i);
+		}
+	}
 
-/* Packet */
-//unsigned  rec_length;
-unsigned  send_length;
-socklen_t rec_length = 0;
+	mac = config_setting_get_member(group, "HOST");
+	count = (mac != NULL) ? config_setting_length(mac) : 0;
+	if(count == 6) {
+		for (i = 0; i < count; i++) {
+			dev->host_mac[i] = config_setting_get_int_elem(mac, i);
+		}
+	}
+}
 
 /*****************************************************************************
-* Initialization of the Ethernet connection with header,
-* containing host/client MAC and send/receive socket for
-* a specified interface
+* Reads the boards from mac.config, either a list BOARDS with one group per
+* board or a single board with the settings on the top level. Returns the
+* number of boards.
 ******************************************************************************/
-void initializeEthernetConnection(char* send_buffer){
-
-	rec_length = sizeof(ra);
-	int ifindex;
+int readDeviceConfiguration(struct device_t *devices, unsigned int max) {
 
 	config_t cfg, *cf;
-	const config_setting_t *mac;
-	int count = 0, i;
-
+	const config_setting_t *boards;
+	unsigned int count = 0, i;
 
 	//Read config-file
 	cf = &cfg;
@@ -107,34 +141,46 @@ void initializeEthernetConnection(char* send_buffer){
 		    exit(1);
 		}
 
-		 /*
-		 config_lookup_int(cf, "ETH", &iface);
-
-		 if(iface == 0) {
-			 interface = "eth0";
-		 } else{
-			 interface = "eth1";
-		 }
-		*/
-
-	mac = config_lookup(cf, "FPGA");
-	count = config_setting_length(mac);
-	if(count == 6) {
-		for (i = 0; i < count; i++) {
-			client_mac[i] = config_setting_get_int_elem(mac, i);
+	boards = config_lookup(cf, "BOARDS");
+	if (boards != NULL) {
+		count = config_setting_length(boards);
+		if (count > max) {
+			fprintf(stderr, "Warning: using the first %u of %u boards\n", max, count);
+			count = max;
 		}
-	}
-
-	mac = config_lookup(cf, "HOST");
-	count = config_setting_length(mac);
-	if(count == 6) {
 		for (i = 0; i < count; i++) {
-			host_mac[i] = config_setting_get_int_elem(mac, i);
+			readDevice(config_setting_get_elem(boards, i), &devices[i]);
 		}
+	} else {
+		readDevice(config_root_setting(cf), &devices[0]);
+		count = 1;
 	}
 
 	config_destroy(cf);
 
+	return count;
+}
+
+/*****************************************************************************
+* Initialization of the Ethernet connection with header,
+* containing host/client MAC and send/receive socket for
+* a specified interface
+******************************************************************************/
+void initializeEthernetConnection(struct device_t *dev, char* send_buffer){
+
+	int ifindex;
+
+	/*prepare send header*/
+	memcpy(send_buffer, dev->client_mac, 6);
+	memcpy(send_buffer+6, dev->host_mac, 6);
+	send_buffer[12] = 0x08; // X.75 -> X.75 allows network-generated reset and
+	send_buffer[13] = 0x01; // clearing causes to be passed in either direction
+
+	if (dev->devsocket[0] != 0) {
+		initializeSocketConnection(dev);
+		return;
+	}
+
 	/*------------------------------------------------------
 				initialize ethernet connection
 	------------------------------------------------------*/
@@ -149,72 +195,119 @@ void initializeEthernetConnection(char* send_buffer){
 						Transmitter
 	------------------------------------------------------*/
 
-	if ((ifindex = if_nametoindex(ifname)) == 0) {
-		fprintf(stderr, "Error: Could not read address of interface '%s' for receiver!\n", ifname);
+	if ((ifindex = if_nametoindex(dev->ifname)) == 0) {
+		fprintf(stderr, "Error: Could not read address of interface '%s' for receiver!\n", dev->ifname);
 		exit(1);
 	}
 
-	/*prepare send header*/
-	memcpy(send_buffer, client_mac, 6);
-	memcpy(send_buffer+6, host_mac, 6);
-	send_buffer[12] = 0x08; // X.75 -> X.75 allows network-generated reset and
-	send_buffer[13] = 0x01; // clearing causes to be passed in either direction
-
-	send_socket = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+	dev->send_socket = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
 
-	if (send_socket == -1) {
+	if (dev->send_socket == -1) {
 		fprintf(stderr, "Error: Could not open socket for receiver!");
 	    exit(1);
 	}
 
-	memset(&sa, 0, sizeof (sa));
-	sa.sll_family    = AF_PACKET;
-	sa.sll_ifindex   = ifindex;
-	sa.sll_protocol  = htons(ETH_P_ALL);
+	memset(&dev->sa, 0, sizeof (dev->sa));
+	dev->sa.sll_family    = AF_PACKET;
+	dev->sa.sll_ifindex   = ifindex;
+	dev->sa.sll_protocol  = htons(ETH_P_ALL);
 
 	/*------------------------------------------------------
 						Receiver
 	------------------------------------------------------*/
 
-	recv_socket = socket(AF_PACKET, SOCK_DGRAM, htons(ETH_P_ALL));
+	dev->recv_socket = socket(AF_PACKET, SOCK_DGRAM, htons(ETH_P_ALL));
 
-	if (recv_socket == -1) {
+	if (dev->recv_socket == -1) {
 		fprintf(stderr, "Error: Could not open socket for receiver!");
 	  	exit(1);
 	}
 
 	struct ifreq ifr;
 	bzero(&ifr, sizeof(struct ifreq));
-	strncpy(ifr.ifr_name, ifname, sizeof(ifname));
+	memcpy(ifr.ifr_name, dev->ifname, IFNAMSIZ-1);
 
-	if (ioctl(recv_socket, SIOCGIFHWADDR, &ifr) == -1) {
+	if (ioctl(dev->recv_socket, SIOCGIFHWADDR, &ifr) == -1) {
 		fprintf(stderr, "Error: Could not read local MAC address for receiver!\n");
 	    exit(1);
 	}
 
-	memset(&ra, 0, sizeof(ra));
-	ra.sll_family    = AF_PACKET;
-	ra.sll_ifindex   = ifindex;
-	ra.sll_protocol  = htons(0x0801);
-	memcpy(ra.sll_addr, client_mac, 6);
+	memset(&dev->ra, 0, sizeof(dev->ra));
+	dev->ra.sll_family    = AF_PACKET;
+	dev->ra.sll_ifindex   = ifindex;
+	dev->ra.sll_protocol  = htons(ETH_P_FPGA);
+	memcpy(dev->ra.sll_addr, dev->client_mac, 6);
 
-	if (bind(recv_socket, (struct sockaddr *)&ra, sizeof(ra)) == -1) {
+	if (bind(dev->recv_socket, (struct sockaddr *)&dev->ra, sizeof(dev->ra)) == -1) {
 		fprintf(stderr, "Error: Could not bind socket for receiver!\n");
 		exit(EXIT_FAILURE);
 	}
 }
 
+/*****************************************************************************
+* Connection to a software device over an AF_UNIX datagram socket. The
+* frames are sent unchanged including the Ethernet header, the device
+* answers with the payload only, like the raw receive socket delivers it.
+******************************************************************************/
+void initializeSocketConnection(struct device_t *dev){
+
+	struct sockaddr_un ua;
+	int sock;
+
+	sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+	if (sock == -1) {
+		fprintf(stderr, "Error: Could not open socket %s!\n", dev->devsocket);
+		exit(1);
+	}
+
+	/* own address for the answers of the device */
+	memset(&ua, 0, sizeof(ua));
+	ua.sun_family = AF_UNIX;
+	snprintf(ua.sun_path, sizeof(ua.sun_path), "%s.host", dev->devsocket);
+	unlink(ua.sun_path);
+
+	if (bind(sock, (struct sockaddr *)&ua, sizeof(ua)) == -1) {
+		fprintf(stderr, "Error: Could not bind socket %s!\n", ua.sun_path);
+		exit(1);
+	}
+
+	memset(&ua, 0, sizeof(ua));
+	ua.sun_family = AF_UNIX;
+	strncpy(ua.sun_path, dev->devsocket, sizeof(ua.sun_path)-1);
+
+	if (connect(sock, (struct sockaddr *)&ua, sizeof(ua)) == -1) {
+		fprintf(stderr, "Error: Could not connect to device %s!\n", dev->devsocket);
+		exit(1);
+	}
+
+	dev->send_socket = sock;
+	dev->recv_socket = sock;
+}
+
+/******************************************************************************
+ * Transmits one frame on the raw or on the device socket
+ ******************************************************************************/
+static int transmit(struct device_t *dev, char* send_buffer, int length, int flags) {
+
+	/* the datagram queue of a local socket is short, block instead of dropping */
+	if (dev->devsocket[0] != 0) {
+		return send(dev->send_socket, send_buffer, length, 0);
+	}
+	return sendto(dev->send_socket, send_buffer, length, flags, (struct sockaddr *)&dev->sa, sizeof (dev->sa));
+}
+
 /******************************************************************************
  * Send Data with length "length"
  ******************************************************************************/
-void sendData(int length, char ctr, char* send_buffer, unsigned int id) {
+void sendData(struct device_t *dev, int length, char ctr, char* send_buffer, unsigned int id) {
 
 	int sd;
 
 	send_buffer[15] = (char) id;
 	send_buffer[14] = ctr;
 
-	sd = sendto(send_socket, send_buffer, length+16, MSG_DONTWAIT, (struct sockaddr *)&sa, sizeof (sa));
+	sd = transmit(dev, send_buffer, length+16, MSG_DONTWAIT);
+	traceFrame(dev, TRACE_TX, ctr, id, length+16);
 	if (sd <= 0) {
 		fprintf(stderr, "\nError: sending Data\n");
 	}
@@ -223,10 +316,176 @@ void sendData(int length, char ctr, char* send_buffer, unsigned int id) {
 	}
 }
 
+/******************************************************************************
+ * Maps a PACKET_TX_RING on the raw send socket of a board
+ ******************************************************************************/
+int initializeTxRing(struct device_t *dev) {
+
+	struct tpacket_req req;
+	int version = TPACKET_V2;
+
+	if (dev->devsocket[0] != 0) {
+		return -1;
+	}
+
+	/* all sends of a socket with a TX ring go through the ring, controls need their own socket */
+	dev->ring_socket = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+	if (dev->ring_socket == -1) {
+		return -1;
+	}
+
+	if (setsockopt(dev->ring_socket, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) == -1) {
+		close(dev->ring_socket);
+		return -1;
+	}
+
+	/* two frames per 4k block, a burst of the FPGA has at most 43 frames */
+	memset(&req, 0, sizeof(req));
+	req.tp_frame_size = TX_FRAME_SIZE;
+	req.tp_block_size = 4096;
+	req.tp_block_nr   = TX_FRAMES / 2;
+	req.tp_frame_nr   = TX_FRAMES;
+
+	if (setsockopt(dev->ring_socket, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) == -1) {
+		close(dev->ring_socket);
+		return -1;
+	}
+
+	dev->txring = (char*) mmap(0, req.tp_block_size * req.tp_block_nr, PROT_READ | PROT_WRITE, MAP_SHARED, dev->ring_socket, 0);
+	if (dev->txring == MAP_FAILED) {
+		dev->txring = NULL;
+		close(dev->ring_socket);
+		return -1;
+	}
+	dev->txframe = 0;
+
+	return 0;
+}
+
+/******************************************************************************
+ * Frames of the database stream over the TX ring, one system call per burst
+ ******************************************************************************/
+static int sendRing(struct device_t *dev, char* send_buffer, const struct frame_t *frames, unsigned int count) {
+
+	struct tpacket2_hdr *hdr;
+	struct pollfd pfd;
+	unsigned int i;
+	char *data;
+	int length;
+
+	for (i = 0; i < count; i++) {
+		hdr = (struct tpacket2_hdr*) (dev->txring + (dev->txframe * TX_FRAME_SIZE));
+
+		/* the kernel is still sending this frame, a rejected frame is not sent again */
+		while (hdr->tp_status != TP_STATUS_AVAILABLE) {
+			if (hdr->tp_status == TP_STATUS_WRONG_FORMAT) {
+				fprintf(stderr, "\nError: frame of the TX ring rejected by the kernel\n");
+				hdr->tp_status = TP_STATUS_AVAILABLE;
+				return -1;
+			}
+			pfd.fd = dev->ring_socket;
+			pfd.events = POLLOUT;
+			pfd.revents = 0;
+			if (poll(&pfd, 1, 100) == -1 && errno != EINTR) {
+				return -1;
+			}
+		}
+
+		data = (char*) hdr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+		length = frames[i].length + 16;
+		memcpy(data, send_buffer, 17);
+		data[14] = frames[i].ctr;
+		data[15] = (char) frames[i].id;
+		if (length > 17) {
+			memcpy(data + 17, frames[i].data, length - 17);
+		}
+		hdr->tp_len = length;
+
+		/* the frame is complete before the kernel sees its status */
+		__sync_synchronize();
+		hdr->tp_status = TP_STATUS_SEND_REQUEST;
+		traceFrame(dev, TRACE_TX, frames[i].ctr, frames[i].id, length);
+
+		dev->txframe = (dev->txframe + 1) % TX_FRAMES;
+	}
+
+	if (sendto(dev->ring_socket, NULL, 0, 0, (struct sockaddr *)&dev->sa, sizeof (dev->sa)) == -1) {
+		return -1;
+	}
+
+	return count;
+}
+
+/******************************************************************************
+ * Frames of the database stream with one sendmmsg, the data is sent from
+ * where it is, e.g. the mapped database, behind a header of 17 bytes
+ ******************************************************************************/
+int sendFrames(struct device_t *dev, char* send_buffer, const struct frame_t *frames, unsigned int count) {
+
+	char header[TX_BURST][17];
+	struct iovec iov[TX_BURST][2];
+	struct mmsghdr msgs[TX_BURST];
+	unsigned int i, sent = 0;
+	int length, r;
+
+	if (dev->tx == TX_RING) {
+		return sendRing(dev, send_buffer, frames, count);
+	}
+
+	memset(msgs, 0, count * sizeof(struct mmsghdr));
+
+	for (i = 0; i < count; i++) {
+		length = frames[i].length + 16;
+
+		memcpy(header[i], send_buffer, 17);
+		header[i][14] = frames[i].ctr;
+		header[i][15] = (char) frames[i].id;
+
+		iov[i][0].iov_base = header[i];
+		iov[i][0].iov_len  = (length < 17) ? length : 17;
+		iov[i][1].iov_base = (void*) frames[i].data;
+		iov[i][1].iov_len  = (length > 17) ? length - 17 : 0;
+
+		msgs[i].msg_hdr.msg_iov = iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 2;
+		if (dev->devsocket[0] == 0) {
+			msgs[i].msg_hdr.msg_name = &dev->sa;
+			msgs[i].msg_hdr.msg_namelen = sizeof(dev->sa);
+		}
+	}
+
+	while (sent < count) {
+		r = sendmmsg(dev->send_socket, msgs + sent, count - sent, 0);
+		if (r == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if ((errno == ENOSYS) && (sent == 0)) {
+				/* no sendmmsg in this kernel, back to one copy per frame */
+				fprintf(stderr, "Warning: no sendmmsg, copying the database frames\n");
+				dev->tx = TX_COPY;
+				for (i = 0; i < count; i++) {
+					memcpy(send_buffer + 17, frames[i].data, frames[i].length);
+					sendData(dev, frames[i].length, frames[i].ctr, send_buffer, frames[i].id);
+				}
+				return count;
+			}
+			fprintf(stderr, "\nError: sending Data\n");
+			return -1;
+		}
+		for (i = sent; i < sent + r; i++) {
+			traceFrame(dev, TRACE_TX, frames[i].ctr, frames[i].id, frames[i].length + 16);
+		}
+		sent = sent + r;
+	}
+
+	return sent;
+}
+
 /******************************************************************************
  * Send Data with length "length"
  ******************************************************************************/
-void sendControl(char ctr,  char* send_buffer, unsigned int id) {
+void sendControl(struct device_t *dev, char ctr,  char* send_buffer, unsigned int id) {
 
 	int sd, i;
 
@@ -236,37 +495,207 @@ void sendControl(char ctr,  char* send_buffer, unsigned int id) {
 		send_buffer[i] = 0x00;
 	}
 
-	sd = sendto(send_socket, send_buffer, CTR_BUF_SIZE, 0, (struct sockaddr *)&sa, sizeof (sa));
+	sd = transmit(dev, send_buffer, CTR_BUF_SIZE, 0);
+	traceFrame(dev, TRACE_TX, ctr, id, CTR_BUF_SIZE);
 	if (sd == -1) {
 		fprintf(stderr, "\nError: sending Control\n");
 	}
 }
 
 /******************************************************************************
- * Receive Data
+ * Receives one frame into a buffer, returns its length or -1
  ******************************************************************************/
-char receive(int buf_size, char* rec_buffer) {
+static int receiveCopy(struct device_t *dev, int buf_size, char* rec_buffer) {
 
+	struct sockaddr_ll ra;
+	socklen_t rec_length;
 	int sd;
 
-		sd = (int) recvfrom(recv_socket, (void*)rec_buffer, buf_size, 0, (struct sockaddr *)&ra, &rec_length);
-		if(sd == -1) {
+	do {
+		rec_length = sizeof(ra);
+		sd = (int) recvfrom(dev->recv_socket, (void*)rec_buffer, buf_size, 0, (struct sockaddr *)&ra, &rec_length);
+		/* own frames are looped back to the packet socket, e.g. on a veth pair */
+	} while ((sd != -1) && (dev->devsocket[0] == 0) && (ra.sll_pkttype == PACKET_OUTGOING));
+
+	if (sd >= 3) {
+		traceFrame(dev, TRACE_RX, rec_buffer[0], (uint8_t) rec_buffer[1] | ((uint8_t) rec_buffer[2] << 8), sd + 14);
+	}
+	return sd;
+}
+
+/******************************************************************************
+ * Receive Data
+ ******************************************************************************/
+char receive(struct device_t *dev, int buf_size, char* rec_buffer) {
+
+	const char *data;
+	int length;
+	char ctr;
+
+	if (dev->rxring != NULL) {
+		ctr = receiveFrame(dev, &data, &length);
+		if (length != -1) {
+			memcpy(rec_buffer, data, (length < buf_size) ? length : buf_size);
+			releaseFrame(dev);
+		}
+		return ctr;
+	}
+
+	if(receiveCopy(dev, buf_size, rec_buffer) == -1) {
+		printf("\nError: receiving\n");
+		return 0x14;
+	} else {
+		return rec_buffer[0];
+	}
+
+}
+
+/*****************************************************************************
+* Maps a PACKET_RX_RING into the receive socket. All frames of the board are
+* then received in the ring and read without a copy or system call while the
+* kernel fills the next frames. Returns -1 if the ring is not available, e.g.
+* with fpga-emu on an AF_UNIX socket, frames are then received with recvfrom.
+******************************************************************************/
+int initializeRxRing(struct device_t *dev) {
+
+	struct tpacket_req req;
+	int version = TPACKET_V2;
+	int ignore = 1;
+
+	dev->rxring = NULL;
+	if (dev->devsocket[0] != 0) {
+		return -1;
+	}
+
+	if (setsockopt(dev->recv_socket, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) == -1) {
+		return -1;
+	}
+
+	/* two frames per 4k block */
+	memset(&req, 0, sizeof(req));
+	req.tp_frame_size = RX_FRAME_SIZE;
+	req.tp_block_size = 4096;
+	req.tp_block_nr   = RX_FRAMES / 2;
+	req.tp_frame_nr   = RX_FRAMES;
+
+	if (setsockopt(dev->recv_socket, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) == -1) {
+		return -1;
+	}
+
+	dev->rxring = (char*) mmap(0, req.tp_block_size * req.tp_block_nr, PROT_READ | PROT_WRITE, MAP_SHARED, dev->recv_socket, 0);
+	if (dev->rxring == MAP_FAILED) {
+		dev->rxring = NULL;
+		memset(&req, 0, sizeof(req));
+		setsockopt(dev->recv_socket, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+		return -1;
+	}
+	dev->rxframe = 0;
+
+#ifdef PACKET_IGNORE_OUTGOING
+	/* keeps own frames looped back on a veth pair out of the ring */
+	setsockopt(dev->recv_socket, SOL_PACKET, PACKET_IGNORE_OUTGOING, &ignore, sizeof(ignore));
+#else
+	(void) ignore;
+#endif
+
+	return 0;
+}
+
+/*****************************************************************************
+* Receives the next frame of the board. data points into the RX ring or
+* into dev->frame and stays valid until releaseFrame. Returns the control
+* code of the frame, on an error 0x14 and a length of -1.
+******************************************************************************/
+char receiveFrame(struct device_t *dev, const char **data, int *length) {
+
+	struct tpacket2_hdr *hdr;
+	struct sockaddr_ll *ra;
+	struct pollfd pfd;
+
+	if (dev->rxring == NULL) {
+		*data = dev->frame;
+		*length = receiveCopy(dev, BUF_SIZE, dev->frame);
+		if (*length == -1) {
 			printf("\nError: receiving\n");
 			return 0x14;
-		} else {
-			return rec_buffer[0];
 		}
+		return dev->frame[0];
+	}
+
+	do {
+		hdr = (struct tpacket2_hdr*) (dev->rxring + dev->rxframe * RX_FRAME_SIZE);
+
+		while ((hdr->tp_status & TP_STATUS_USER) == 0) {
+			pfd.fd = dev->recv_socket;
+			pfd.events = POLLIN | POLLERR;
+			pfd.revents = 0;
+			if ((poll(&pfd, 1, -1) == -1) && (errno != EINTR)) {
+				*length = -1;
+				printf("\nError: receiving\n");
+				return 0x14;
+			}
+		}
+		__sync_synchronize();
+
+		ra = (struct sockaddr_ll*) ((char*) hdr + TPACKET_ALIGN(sizeof(struct tpacket2_hdr)));
+		if (ra->sll_pkttype == PACKET_OUTGOING) {
+			releaseFrame(dev);
+			hdr = NULL;
+		}
+	} while (hdr == NULL);
+
+	*data = (char*) hdr + hdr->tp_net;
+	*length = (int) hdr->tp_snaplen;
+	if (*length >= 3) {
+		traceFrame(dev, TRACE_RX, (*data)[0], (uint8_t) (*data)[1] | ((uint8_t) (*data)[2] << 8), *length + 14);
+	}
+
+	return (*data)[0];
+}
+
+/*****************************************************************************
+* Hands the frame of the last receiveFrame back to the kernel
+******************************************************************************/
+void releaseFrame(struct device_t *dev) {
+
+	struct tpacket2_hdr *hdr;
+
+	if (dev->rxring == NULL) {
+		return;
+	}
+
+	hdr = (struct tpacket2_hdr*) (dev->rxring + dev->rxframe * RX_FRAME_SIZE);
+	__sync_synchronize();
+	hdr->tp_status = TP_STATUS_KERNEL;
+	dev->rxframe = (dev->rxframe + 1) % RX_FRAMES;
+}
+
+/*****************************************************************************
+* Frames the kernel dropped since the connection was opened because the
+* host did not read them in time, a full RX ring or socket buffer
+******************************************************************************/
+unsigned long droppedFrames(struct device_t *dev) {
+
+	struct tpacket_stats stats;
+	socklen_t len = sizeof(stats);
+
+	/* the statistics are reset by every read */
+	if ((dev->devsocket[0] == 0) &&
+		(getsockopt(dev->recv_socket, SOL_PACKET, PACKET_STATISTICS, &stats, &len) == 0)) {
+		dev->drops = dev->drops + stats.tp_drops;
+	}
 
+	return dev->drops;
 }
 
 /******************************************************************************
  * search possible devices and number of units
  ******************************************************************************/
-uint16_t searchDevice(char* send_buffer, char* rec_buffer, unsigned int id) {
+uint16_t searchDevice(struct device_t *dev, char* send_buffer, char* rec_buffer, unsigned int id) {
 	uint16_t units;
 
-	sendControl(0x20, send_buffer, id);
-	char ctr = receive(CTR_BUF_SIZE, rec_buffer);
+	sendControl(dev, 0x20, send_buffer, id);
+	char ctr = receive(dev, CTR_BUF_SIZE, rec_buffer);
 	memcpy(&units, rec_buffer+1, 2);
 	units = units * 2;
 
@@ -5,8 +5,8 @@
  	Created by Oliver Knodel on 12.07.10.
 
 	Description:
-    Initialization of independent transmitter and receiver interfaces
-    for parallel send and receive.
+    Transforms the original ASCII characters of a FASTA database into
+    binary symbols and creates the binary index of the sequences.
  
 
  	MIT License
@@ -31,18 +31,22 @@
 	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 	SOFTWARE. 
  */
-**Project : FPGA -
-	DNA - Sequence - Search **Created by Oliver Knodel on 12.07.10. * Copyright 2010 Technische Universitaet Dresden.All rights reserved.**Description : *Transforms the original ASCI - characters to binary Symbols ******************************************************************************* /
 
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <immintrin.h>
 #include "header/align.h"
 #include "header/gettime.h"
+#include "header/formatdb.h"
+#include "header/gzinput.h"
 
-#define LABEL 200
-
-																																															 /*
+/*
  * Transforms nucleotide-database in a binary database
  * and creates index with positions from the different
  * sequences in the databas
@@ -54,109 +58,842 @@
  * C -> 11		0xC0	0x30	0x0C	0x03
  */
 
-																																															 char nucA[4] = {0x00, 0x00, 0x00, 0x00};
+char nucA[4] = {0x00, 0x00, 0x00, 0x00};
 char nucG[4] = {0x40, 0x10, 0x04, 0x01};
 char nucT[4] = {0x80, 0x20, 0x08, 0x02};
 char nucC[4] = {0xC0, 0x30, 0x0C, 0x03};
 
+#define CHECKSUM_BLOCK	(1 << 20)
+#define FNV_OFFSET		0xcbf29ce484222325ULL
+#define FNV_PRIME		0x100000001b3ULL
+
+#define TRANSFORM_JOB		(8 << 20)	/* minimal input bytes of one job */
+#define TRANSFORM_CHUNK		(1 << 20)	/* bases compacted at once, multiple of 32 */
+#define TRANSFORM_BUFFER	(4 << 20)	/* output buffer of one thread */
+
+/* sequence part of one record in the mapped database */
+struct record_t {
+	uint64_t seq, end;
+	uint64_t gaps;					/* runs of N in the record */
+};
+
+/* runs of N found in one job, relative to their records */
+struct runs_t {
+	struct dbgap_t *gaps;
+	uint64_t count, size;
+	int error;
+};
+
+/* state shared by the threads of the transformation */
+struct transform_t {
+	const char *db;
+	struct record_t *records;
+	struct dbentry_t *entries;
+	unsigned int *jobs;				/* first record of each job, one more at the end */
+	struct runs_t *runs;			/* per job */
+	unsigned int jobcount;
+	unsigned int next;				/* next job, taken atomically */
+	int pass;						/* 0: count bases, 1: pack and write */
+	int fd;
+	int error;
+};
+
+/* one thread of the transformation or the checksum */
+struct worker_t {
+	struct transform_t *transform;
+	char *chunk, *buffer;
+	const char *data;				/* checksum: blocks first to last-1 */
+	uint64_t bytes, first, last;
+	uint64_t *hashes;
+	pthread_t thread;
+};
+
+typedef uint64_t (*count_t)(const char *seq, uint64_t length, struct runs_t *runs);
+typedef unsigned long (*compact_t)(const char *seq, unsigned long length, char *out);
+typedef void (*pack_t)(const char *bases, unsigned long count, char *out);
+
+count_t count_kernel;
+compact_t compact_kernel;
+pack_t pack_kernel;
+const char *transform_kernelname;
+
+#define NORUN	(~0ull)
+
+/******************************************************************************
+ * Adds a run of N to the runs of the job
+ ******************************************************************************/
+static void addRun(struct runs_t *runs, uint64_t start, uint64_t bases) {
+	struct dbgap_t *gaps;
+
+	if (runs->count == runs->size) {
+		runs->size = runs->size ? 2 * runs->size : 256;
+		gaps = (struct dbgap_t*) realloc(runs->gaps, runs->size * sizeof(struct dbgap_t));
+		if (gaps == NULL) {
+			runs->error = 1;
+			runs->size = runs->count;
+			return;
+		}
+		runs->gaps = gaps;
+	}
+	runs->gaps[runs->count].start = start;
+	runs->gaps[runs->count].bases = bases;
+	runs->count++;
+}
+
+/******************************************************************************
+ * Counts the bases of a sequence part, every character from 'A' on is a
+ * base, and collects the runs of N. run is the start of an open run.
+ ******************************************************************************/
+static inline void scanBases(const char *seq, uint64_t length, uint64_t *bases, uint64_t *run, struct runs_t *runs) {
+	uint64_t i;
+
+	for (i = 0; i < length; i++) {
+		if ((unsigned char) seq[i] < 'A') {
+			continue;
+		}
+		if ((seq[i] | 0x20) == 'n') {
+			if (*run == NORUN) {
+				*run = *bases;
+			}
+		} else if (*run != NORUN) {
+			addRun(runs, *run, *bases - *run);
+			*run = NORUN;
+		}
+		(*bases)++;
+	}
+}
+
+static uint64_t countScalar(const char *seq, uint64_t length, struct runs_t *runs) {
+	uint64_t bases = 0, run = NORUN;
+
+	scanBases(seq, length, &bases, &run, runs);
+	if (run != NORUN) {
+		addRun(runs, run, bases - run);
+	}
+	return bases;
+}
+
+/* only parts with N or the end of a run take the scalar path */
+__attribute__((target("avx2,popcnt")))
+static uint64_t countAVX2(const char *seq, uint64_t length, struct runs_t *runs) {
+	const __m256i a = _mm256_set1_epi8('A');
+	const __m256i lower = _mm256_set1_epi8(0x20);
+	const __m256i n = _mm256_set1_epi8('n');
+	__m256i v;
+	uint64_t i, bases = 0, run = NORUN;
+
+	for (i = 0; i + 32 <= length; i += 32) {
+		v = _mm256_loadu_si256((const __m256i*) (seq + i));
+		if ((run == NORUN) &&
+			(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_or_si256(v, lower), n)) == 0)) {
+			v = _mm256_cmpeq_epi8(_mm256_max_epu8(v, a), v);
+			bases += _mm_popcnt_u32((uint32_t) _mm256_movemask_epi8(v));
+		} else {
+			scanBases(seq + i, 32, &bases, &run, runs);
+		}
+	}
+	scanBases(seq + i, length - i, &bases, &run, runs);
+	if (run != NORUN) {
+		addRun(runs, run, bases - run);
+	}
+	return bases;
+}
+
+/******************************************************************************
+ * Copies the bases of a sequence part without line breaks and other
+ * characters, returns the number of bases. out needs 32 bytes of slack.
+ ******************************************************************************/
+static unsigned long compactScalar(const char *seq, unsigned long length, char *out) {
+	unsigned long i, n = 0;
+
+	for (i = 0; i < length; i++) {
+		out[n] = seq[i];
+		n += ((unsigned char) seq[i] >= 'A');
+	}
+	return n;
+}
+
+__attribute__((target("avx2")))
+static unsigned long compactAVX2(const char *seq, unsigned long length, char *out) {
+	const __m256i a = _mm256_set1_epi8('A');
+	__m256i v;
+	unsigned long i, j, n = 0;
+
+	for (i = 0; i + 32 <= length; i += 32) {
+		v = _mm256_loadu_si256((const __m256i*) (seq + i));
+		_mm256_storeu_si256((__m256i*) (out + n), v);
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(v, a), v)) == -1) {
+			n += 32;
+		} else {
+			/* line break in the 32 characters */
+			for (j = i; j < i + 32; j++) {
+				out[n] = seq[j];
+				n += ((unsigned char) seq[j] >= 'A');
+			}
+		}
+	}
+	return n + compactScalar(seq + i, length - i, out + n);
+}
+
+/******************************************************************************
+ * Packs count bases into count/4 bytes, the last byte padded with A
+ ******************************************************************************/
+static void packScalar(const char *bases, unsigned long count, char *out) {
+	unsigned long i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		*out++ = (PACK_BASE(bases[i]) << 6) | (PACK_BASE(bases[i+1]) << 4) |
+				 (PACK_BASE(bases[i+2]) << 2) | PACK_BASE(bases[i+3]);
+	}
+	if (i < count) {
+		*out = 0x00;
+		for (; i < count; i++) {
+			*out |= PACK_BASE(bases[i]) << (2*(3-(i & 3)));
+		}
+	}
+}
+
+/* 32 bases per step: the 2 bit codes are merged pairwise into 4 and 8 bits */
+__attribute__((target("avx2")))
+static void packAVX2(const char *bases, unsigned long count, char *out) {
+	const __m256i three = _mm256_set1_epi8(3);
+	const __m256i pair = _mm256_set1_epi16(0x0104);
+	const __m256i quad = _mm256_set1_epi32(0x00010010);
+	const __m256i low = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	const __m256i gather = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+											0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	__m256i v;
+	unsigned long i;
+
+	for (i = 0; i + 32 <= count; i += 32) {
+		v = _mm256_loadu_si256((const __m256i*) (bases + i));
+		v = _mm256_and_si256(_mm256_srli_epi16(v, 1), three);
+		v = _mm256_maddubs_epi16(v, pair);
+		v = _mm256_madd_epi16(v, quad);
+		v = _mm256_shuffle_epi8(v, gather);
+		v = _mm256_permutevar8x32_epi32(v, low);
+		_mm_storel_epi64((__m128i*) out, _mm256_castsi256_si128(v));
+		out += 8;
+	}
+	packScalar(bases + i, count - i, out);
+}
+
+/******************************************************************************
+ * Selects the kernels of the transformation
+ ******************************************************************************/
+static void transformInit() {
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+		count_kernel = countAVX2;
+		compact_kernel = compactAVX2;
+		pack_kernel = packAVX2;
+		transform_kernelname = "AVX2";
+	} else {
+		count_kernel = countScalar;
+		compact_kernel = compactScalar;
+		pack_kernel = packScalar;
+		transform_kernelname = "scalar";
+	}
+}
+
+/******************************************************************************
+ * Number of threads for work of the given size
+ ******************************************************************************/
+static unsigned int workers(uint64_t parts) {
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (threads < 1) {
+		threads = 1;
+	}
+	if ((uint64_t) threads > parts) {
+		threads = parts ? parts : 1;
+	}
+	return threads;
+}
+
+/*
+ * FNV-1a over 64 bit words of one block, folded after every word
+ */
+static uint64_t checksumBlock(const char *data, uint64_t bytes) {
+	uint64_t h = FNV_OFFSET, w, i;
+
+	for (i = 0; i + 8 <= bytes; i += 8) {
+		memcpy(&w, data + i, 8);
+		h = (h ^ w) * FNV_PRIME;
+		h ^= h >> 32;
+	}
+	if (i < bytes) {
+		w = 0;
+		memcpy(&w, data + i, bytes - i);
+		h = (h ^ w) * FNV_PRIME;
+		h ^= h >> 32;
+	}
+	return h;
+}
+
+static void *checksumBlocks(void *arg) {
+	struct worker_t *w = (struct worker_t*) arg;
+	uint64_t b, o;
+
+	for (b = w->first; b < w->last; b++) {
+		o = b * CHECKSUM_BLOCK;
+		w->hashes[b] = checksumBlock(w->data + o, (w->bytes - o < CHECKSUM_BLOCK) ? w->bytes - o : CHECKSUM_BLOCK);
+	}
+	return NULL;
+}
+
+/*
+ * Checksum of the binary database, combined from blocks of 1 MiB. The
+ * blocks are hashed in parallel.
+ */
+uint64_t dbChecksum(const char *data, uint64_t bytes) {
+	uint64_t h = FNV_OFFSET ^ bytes, blocks, b, o, n;
+	struct worker_t *w;
+	unsigned int threads, t;
+
+	blocks = (bytes + CHECKSUM_BLOCK - 1) / CHECKSUM_BLOCK;
+	threads = workers(blocks / 16);
+	w = (struct worker_t*) calloc(threads, sizeof(struct worker_t));
+	if ((threads > 1) && (w != NULL)) {
+		w[0].hashes = (uint64_t*) malloc(blocks * sizeof(uint64_t));
+	}
+
+	if ((w == NULL) || (w[0].hashes == NULL)) {
+		for (o = 0; o < bytes; o += CHECKSUM_BLOCK) {
+			n = (bytes - o < CHECKSUM_BLOCK) ? bytes - o : CHECKSUM_BLOCK;
+			h = (h ^ checksumBlock(data + o, n)) * FNV_PRIME;
+			h ^= h >> 32;
+		}
+		free(w);
+		return h;
+	}
+
+	for (t = 0; t < threads; t++) {
+		w[t].data = data;
+		w[t].bytes = bytes;
+		w[t].hashes = w[0].hashes;
+		w[t].first = blocks * t / threads;
+		w[t].last = blocks * (t + 1) / threads;
+	}
+	for (t = 1; t < threads; t++) {
+		if (pthread_create(&w[t].thread, NULL, checksumBlocks, &w[t])) {
+			checksumBlocks(&w[t]);
+			w[t].thread = 0;
+		}
+	}
+	checksumBlocks(&w[0]);
+	for (t = 1; t < threads; t++) {
+		if (w[t].thread) {
+			pthread_join(w[t].thread, NULL);
+		}
+	}
+
+	for (b = 0; b < blocks; b++) {
+		h = (h ^ w[0].hashes[b]) * FNV_PRIME;
+		h ^= h >> 32;
+	}
+	free(w[0].hashes);
+	free(w);
+	return h;
+}
+
+/*
+ * Checksum of a binary database file
+ */
+static int checksumFile(char *bindbname, uint64_t bytes, uint64_t *checksum) {
+	char *map;
+	int fd;
+
+	*checksum = dbChecksum(NULL, 0);
+	if (bytes == 0) {
+		return 0;
+	}
+
+	fd = open(bindbname, O_RDONLY);
+	if (fd == -1) {
+		fprintf(stderr, "\nError: can not open File %s\n", bindbname);
+		return -1;
+	}
+	map = (char*) mmap(0, bytes, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "\nError: mapping %s\n", bindbname);
+		return -1;
+	}
+	*checksum = dbChecksum(map, bytes);
+	munmap(map, bytes);
+
+	return 0;
+}
+
+/******************************************************************************
+ * Writes the filled part of the output buffer at its offset in the binary
+ * database
+ ******************************************************************************/
+static int flushBuffer(struct transform_t *t, const char *buffer, unsigned long fill, uint64_t offset) {
+	ssize_t n;
+
+	while (fill > 0) {
+		n = pwrite(t->fd, buffer, fill, offset);
+		if (n <= 0) {
+			return -1;
+		}
+		buffer += n;
+		fill -= n;
+		offset += n;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Packs the records of one job into the output buffer, the records of a job
+ * are contiguous in the binary database
+ ******************************************************************************/
+static int packJob(struct worker_t *w, unsigned int first, unsigned int last) {
+	struct transform_t *t = w->transform;
+	uint64_t offset = t->entries[first].offset, seq, step;
+	unsigned long fill = 0, count;
+	unsigned int r;
+
+	for (r = first; r < last; r++) {
+		seq = t->records[r].seq;
+		count = 0;
+		while (seq < t->records[r].end) {
+			/* whole bytes except at the end of the sequence */
+			step = t->records[r].end - seq;
+			if (step > TRANSFORM_CHUNK - count) {
+				step = TRANSFORM_CHUNK - count;
+			}
+			count += compact_kernel(t->db + seq, step, w->chunk + count);
+			seq += step;
+			if ((count < TRANSFORM_CHUNK) && (seq < t->records[r].end)) {
+				continue;
+			}
+
+			if (fill + (count + 3) / 4 > TRANSFORM_BUFFER) {
+				if (flushBuffer(t, w->buffer, fill, offset) == -1) {
+					return -1;
+				}
+				offset += fill;
+				fill = 0;
+			}
+			if (seq < t->records[r].end) {
+				pack_kernel(w->chunk, count & ~3ul, w->buffer + fill);
+				fill += count / 4;
+				memmove(w->chunk, w->chunk + (count & ~3ul), count & 3);
+				count &= 3;
+			} else {
+				pack_kernel(w->chunk, count, w->buffer + fill);
+				fill += (count + 3) / 4;
+				count = 0;
+			}
+		}
+	}
+	return flushBuffer(t, w->buffer, fill, offset);
+}
+
+/******************************************************************************
+ * Takes jobs until all are done, counting the bases of the records in the
+ * first pass and writing them in the second
+ ******************************************************************************/
+static void *transformJobs(void *arg) {
+	struct worker_t *w = (struct worker_t*) arg;
+	struct transform_t *t = w->transform;
+	unsigned int j, r;
+	uint64_t runs;
+
+	while ((j = __sync_fetch_and_add(&t->next, 1)) < t->jobcount) {
+		if (t->pass == 0) {
+			for (r = t->jobs[j]; r < t->jobs[j+1]; r++) {
+				runs = t->runs[j].count;
+				t->entries[r].bases = count_kernel(t->db + t->records[r].seq, t->records[r].end - t->records[r].seq, &t->runs[j]);
+				t->records[r].gaps = t->runs[j].count - runs;
+			}
+		} else if (packJob(w, t->jobs[j], t->jobs[j+1]) == -1) {
+			t->error = 1;
+		}
+	}
+	return NULL;
+}
+
+/******************************************************************************
+ * Runs one pass of the transformation on all threads
+ ******************************************************************************/
+static void transformPass(struct worker_t *w, unsigned int threads, int pass) {
+	unsigned int n;
+
+	w[0].transform->pass = pass;
+	w[0].transform->next = 0;
+	for (n = 1; n < threads; n++) {
+		if (pthread_create(&w[n].thread, NULL, transformJobs, &w[n])) {
+			w[n].thread = 0;
+		}
+	}
+	transformJobs(&w[0]);
+	for (n = 1; n < threads; n++) {
+		if (w[n].thread) {
+			pthread_join(w[n].thread, NULL);
+		}
+	}
+}
 
 /*
- * Transformation for the database
+ * Inflates a compressed database into memory
  */
-int transformdb(char *databasename, char *bindbname, char *infodbname) {
-	double seqlength = 0, dblength = 0;
-	double dbsequences = 0;
-	double dbcharcount = 0;
-
-	unsigned int i = 0;
-	char line[150];
-	char dbchar, binchar;
+static char *inflateDB(const char *name, uint64_t *size) {
+	uint64_t capacity = TRANSFORM_BUFFER;
+	char *text, *ptr;
+	size_t n;
+	FILE *file;
+
+	file = openInput(name);
+	if (file == NULL) {
+		fprintf(stderr, "\nError: can not open File %s\n", name);
+		return NULL;
+	}
+	text = (char*) malloc(capacity);
+	if (text == NULL) {
+		fprintf(stderr, "\nError: allocating %s in memory\n", name);
+		fclose(file);
+		return NULL;
+	}
+
+	*size = 0;
+	while ((n = fread(text + *size, 1, capacity - *size, file)) > 0) {
+		*size = *size + n;
+		if (*size == capacity) {
+			capacity = 2 * capacity;
+			ptr = (char*) realloc(text, capacity);
+			if (ptr == NULL) {
+				fprintf(stderr, "\nError: allocating %s in memory\n", name);
+				free(text);
+				fclose(file);
+				return NULL;
+			}
+			text = ptr;
+		}
+	}
+	if (ferror(file)) {
+		fprintf(stderr, "\nError: inflating %s\n", name);
+		free(text);
+		fclose(file);
+		return NULL;
+	}
+	fclose(file);
+
+	return text;
+}
+
+/*
+ * Transformation for the database. The records are found in the mapped
+ * FASTA file, then threads count their bases and pack them, each job of
+ * records at its offset in the binary database.
+ */
+int transformdb(char *databasename, char *bindbname, char *indexname) {
+	struct dbindex_t header;
+	struct transform_t t;
+	struct worker_t *w;
+	struct stat sb;
+	unsigned int count = 0, capacity = 0, jobcapacity = 0, threads, n, j;
+	struct dbgap_t *gaps;
+	uint64_t gapcount = 0, masked = 0, g, i;
+	char *names = NULL, *ptr;
+	const char *p, *end, *line, *seq;
+	size_t namesfill = 0, namessize = 0, length;
+	uint64_t bytes = 0, bases = 0, jobsize = 0;
+	uint64_t size;
 	double time0, time1;
-	long int bppos;
+	int fd, compressed;
 
-	FILE *db, *bindb, *infodb;
+	FILE *index;
 
 	printf("\n--- Starting Database Transformation for %s ---\n", databasename);
 
-	db = fopen64(databasename, "rb");
-	if (db == NULL) {
-		fprintf(stderr, "\nError: can not open File %s\n", databasename);
-		return -1;
+	transformInit();
+	time0 = gettime(0);
+
+	memset(&t, 0, sizeof(t));
+	compressed = compressedInput(databasename);
+	if (compressed > 0) {
+		t.db = inflateDB(databasename, &size);
+		if (t.db == NULL) {
+			return -1;
+		}
+	} else {
+		fd = open(databasename, O_RDONLY);
+		if ((fd == -1) || (fstat(fd, &sb) == -1)) {
+			fprintf(stderr, "\nError: can not open File %s\n", databasename);
+			return -1;
+		}
+		size = sb.st_size;
+		t.db = "";
+		if (size > 0) {
+			t.db = (const char*) mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+			if (t.db == MAP_FAILED) {
+				fprintf(stderr, "\nError: mapping %s\n", databasename);
+				return -1;
+			}
+			madvise((void*) t.db, size, MADV_SEQUENTIAL);
+		}
+		close(fd);
 	}
 
-	bindb = fopen64(bindbname, "wb");
-	if (bindb == NULL) {
+	t.fd = open(bindbname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (t.fd == -1) {
 		fprintf(stderr, "\nError: can not create File %s\n", bindbname);
 		return -1;
 	}
 
-	infodb = fopen(infodbname, "wb");
-	if (infodb == NULL) {
-		fprintf(stderr, "\nError: can not create File %s\n", infodbname);
+	/*------------------------------------------------------
+				records, names and jobs
+	------------------------------------------------------*/
+
+	/* a record starts at every '>', the name is the rest of its line */
+	end = t.db + size;
+	p = (const char*) memchr(t.db, '>', size);
+	while (p != NULL) {
+		line = p + 1;
+		seq = (const char*) memchr(line, '\n', end - line);
+		length = (seq ? seq : end) - line;
+		seq = seq ? seq + 1 : end;
+		while ((length > 0) && (line[length-1] == '\r')) {
+			length--;
+		}
+		p = (const char*) memchr(seq, '>', end - seq);
+
+		if (count == capacity) {
+			capacity = capacity ? 2 * capacity : 1024;
+			t.records = (struct record_t*) realloc(t.records, capacity * sizeof(struct record_t));
+			t.entries = (struct dbentry_t*) realloc(t.entries, capacity * sizeof(struct dbentry_t));
+			if ((t.records == NULL) || (t.entries == NULL)) {
+				fprintf(stderr, "\nError: allocating sequence index\n");
+				return -1;
+			}
+		}
+		t.records[count].seq = seq - t.db;
+		t.records[count].end = (p ? p : end) - t.db;
+
+		if (namesfill + length + 1 > namessize) {
+			namessize = 2 * (namesfill + length + 1) + 4096;
+			ptr = (char*) realloc(names, namessize);
+			if (ptr == NULL) {
+				fprintf(stderr, "\nError: allocating sequence names\n");
+				return -1;
+			}
+			names = ptr;
+		}
+		t.entries[count].name = namesfill;
+		memcpy(names + namesfill, line, length);
+		names[namesfill + length] = 0;
+		namesfill = namesfill + length + 1;
+
+		/* jobs of whole records with at least TRANSFORM_JOB bytes */
+		if (jobsize == 0) {
+			if (t.jobcount + 2 > jobcapacity) {
+				jobcapacity = jobcapacity ? 2 * jobcapacity : 1024;
+				t.jobs = (unsigned int*) realloc(t.jobs, jobcapacity * sizeof(unsigned int));
+				if (t.jobs == NULL) {
+					fprintf(stderr, "\nError: allocating transformation jobs\n");
+					return -1;
+				}
+			}
+			t.jobs[t.jobcount++] = count;
+		}
+		jobsize += t.records[count].end - t.records[count].seq;
+		if (jobsize >= TRANSFORM_JOB) {
+			jobsize = 0;
+		}
+		count++;
+	}
+	if (t.jobs != NULL) {
+		t.jobs[t.jobcount] = count;
+	}
+
+	/*------------------------------------------------------
+				count bases, pack and write
+	------------------------------------------------------*/
+
+	threads = workers(t.jobcount);
+	w = (struct worker_t*) calloc(threads, sizeof(struct worker_t));
+	t.runs = (struct runs_t*) calloc(t.jobcount + 1, sizeof(struct runs_t));
+	if ((w == NULL) || (t.runs == NULL)) {
+		fprintf(stderr, "\nError: allocating transformation threads\n");
 		return -1;
 	}
+	for (n = 0; n < threads; n++) {
+		w[n].transform = &t;
+	}
+	transformPass(w, threads, 0);
 
-	time0 = gettime(0);
+	for (n = 0; n < count; n++) {
+		t.entries[n].offset = bytes;
+		t.entries[n].start = bases;
+		t.entries[n].bytes = (t.entries[n].bases + 3) / 4;
+		bytes = bytes + t.entries[n].bytes;
+		bases = bases + t.entries[n].bases;
+	}
 
-	fprintf(infodb, "# %10.0f\n", 0.0);
-	bppos = ftell(infodb);
-
-	i = 0;
-	binchar = 0x00;
-	while (((dbchar = getc(db)) != EOF)) {
-	  if(dbchar < 'A') {
-		if (dbchar == '>') {
-			if(i != 0){ //Always end of sequence in last char
-				fwrite(&binchar, sizeof(binchar), 1, bindb);
-				i = 0;
-				dbcharcount++;
+	/* runs of N of all jobs in order, in bases of the whole database */
+	for (j = 0; j < t.jobcount; j++) {
+		if (t.runs[j].error != 0) {
+			fprintf(stderr, "\nError: allocating runs of N\n");
+			return -1;
+		}
+		gapcount = gapcount + t.runs[j].count;
+	}
+	gaps = (struct dbgap_t*) malloc(gapcount * sizeof(struct dbgap_t) + 1);
+	if (gaps == NULL) {
+		fprintf(stderr, "\nError: allocating runs of N\n");
+		return -1;
+	}
+	gapcount = 0;
+	for (j = 0; j < t.jobcount; j++) {
+		g = 0;
+		for (n = t.jobs[j]; n < t.jobs[j+1]; n++) {
+			for (i = 0; i < t.records[n].gaps; i++, g++) {
+				gaps[gapcount].start = t.entries[n].start + t.runs[j].gaps[g].start;
+				gaps[gapcount].bases = t.runs[j].gaps[g].bases;
+				masked = masked + gaps[gapcount].bases;
+				gapcount++;
 			}
-			fprintf(infodb, "# %10.0f\n\n", dbcharcount); //number of chars
-			dbcharcount = 0;
-			fgets(line, 150, db);
-			dblength = dblength + seqlength;
-			fprintf(infodb, "# %10.0f\n", dblength); //position
-			fprintf(infodb, "%s", line);
-			dbsequences++;
-			seqlength = 0;
-		}
-	  }
-	  else {
-	    binchar |= PACK_BASE(dbchar) << (2*(3-i));
-	    seqlength++;
-
-	    if(i == 3) {
-	      fwrite(&binchar, sizeof(binchar), 1, bindb);
-	      i = 0;
-	      binchar = 0x00;
-	      dbcharcount++;
-	    }
-	    else  i++;
-	  }
-	}
-	dblength = dblength + seqlength;
-
-	fprintf(infodb, "# %10.0f\n\n", dbcharcount);
-	fseek(infodb, 0, SEEK_SET);
-	fprintf(infodb, "# %10.0f\n\n", dbsequences);
-	fseek(infodb, bppos, SEEK_SET);
-	fprintf(infodb, "# %10.0f\n", dblength);
+		}
+		free(t.runs[j].gaps);
+	}
+	free(t.runs);
+
+	if (ftruncate(t.fd, bytes) == -1) {
+		fprintf(stderr, "\nError: can not create File %s\n", bindbname);
+		return -1;
+	}
+	for (n = 0; n < threads; n++) {
+		w[n].chunk = (char*) malloc(TRANSFORM_CHUNK + 32);
+		w[n].buffer = (char*) malloc(TRANSFORM_BUFFER);
+		if ((w[n].chunk == NULL) || (w[n].buffer == NULL)) {
+			fprintf(stderr, "\nError: allocating transformation buffers\n");
+			return -1;
+		}
+	}
+	transformPass(w, threads, 1);
+
+	for (n = 0; n < threads; n++) {
+		free(w[n].chunk);
+		free(w[n].buffer);
+	}
+	free(w);
+	free(t.records);
+	free(t.jobs);
+	if (compressed > 0) {
+		free((void*) t.db);
+	} else if (size > 0) {
+		munmap((void*) t.db, size);
+	}
+	if ((close(t.fd) != 0) || (t.error != 0)) {
+		fprintf(stderr, "\nError: writing %s\n", bindbname);
+		return -1;
+	}
 
+	/*------------------------------------------------------
+						write index
+	------------------------------------------------------*/
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, DBINDEX_MAGIC, 8);
+	header.version = DBINDEX_VERSION;
+	header.sequences = count;
+	header.bases = bases;
+	header.bytes = bytes;
+	header.gaps = gapcount;
+	header.masked = masked;
+	header.names = sizeof(header) + count * sizeof(struct dbentry_t) + gapcount * sizeof(struct dbgap_t);
+	if (checksumFile(bindbname, bytes, &header.checksum) == -1) {
+		return -1;
+	}
+
+	index = fopen(indexname, "wb");
+	if (index == NULL) {
+		fprintf(stderr, "\nError: can not create File %s\n", indexname);
+		return -1;
+	}
+	if ((fwrite(&header, sizeof(header), 1, index) != 1) ||
+		(fwrite(t.entries, sizeof(struct dbentry_t), count, index) != count) ||
+		(fwrite(gaps, sizeof(struct dbgap_t), gapcount, index) != gapcount) ||
+		(fwrite(names, 1, namesfill, index) != namesfill) ||
+		(fclose(index) != 0)) {
+		fprintf(stderr, "\nError: writing %s\n", indexname);
+		return -1;
+	}
+	free(t.entries);
+	free(gaps);
+	free(names);
 
 	time1 = gettime(time0);
 
 
-	printf("Characters: %.0f\n", dblength);
-	printf("Sequences: %.0f\n", dbsequences);
-	printf("Time: %f seconds\n\n", time1);
-	printf("create files: %s and %s \n", bindbname, infodbname);
+	printf("Characters: %llu\n", (unsigned long long) bases);
+	printf("Sequences: %u\n", count);
+	printf("Runs of N: %llu with %llu bases\n", (unsigned long long) gapcount, (unsigned long long) masked);
+	printf("Time: %f seconds\n", time1);
+	printf("Throughput: %.2f GB/s (%s, %u threads)\n\n", size / time1 / 1e9, transform_kernelname, threads);
+	printf("create files: %s and %s \n", bindbname, indexname);
 
 	printf("\n-> finished transformation for %s\n\n", databasename);
 
-	fclose(db);
-	fclose(bindb);
-	fclose(infodb);
-
 	return 0;
 }
 
+/*
+ * Maps the binary index of a database and checks its layout, returns NULL
+ * if the index is missing or invalid
+ */
+const struct dbindex_t *mapDBIndex(const char *indexname, uint64_t *size) {
+	const struct dbindex_t *index;
+	const struct dbentry_t *entries;
+	struct stat sb;
+	unsigned int s;
+	int fd;
+
+	fd = open(indexname, O_RDONLY);
+	if (fd == -1) {
+		return NULL;
+	}
+	if ((fstat(fd, &sb) == -1) || ((uint64_t) sb.st_size < sizeof(struct dbindex_t))) {
+		fprintf(stderr, "\nError: %s is no database index\n", indexname);
+		close(fd);
+		return NULL;
+	}
+
+	index = (const struct dbindex_t*) mmap(0, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (index == MAP_FAILED) {
+		fprintf(stderr, "\nError: mapping %s\n", indexname);
+		return NULL;
+	}
+	*size = sb.st_size;
+
+	if (memcmp(index->magic, DBINDEX_MAGIC, 8) != 0) {
+		fprintf(stderr, "\nError: %s is no database index\n", indexname);
+	} else if (index->version != DBINDEX_VERSION) {
+		fprintf(stderr, "\nError: %s has version %u, expected %u; transform the database again\n",
+				indexname, index->version, DBINDEX_VERSION);
+	} else if ((index->gaps > *size) || (index->names != sizeof(struct dbindex_t) + (uint64_t) index->sequences * sizeof(struct dbentry_t) +
+							   index->gaps * sizeof(struct dbgap_t)) ||
+			   (index->names > *size) || ((index->names < *size) && (((const char*) index)[*size - 1] != 0))) {
+		fprintf(stderr, "\nError: %s is truncated\n", indexname);
+	} else {
+		entries = (const struct dbentry_t*) (index + 1);
+		for (s = 0; s < index->sequences; s++) {
+			if ((index->names + entries[s].name >= *size) ||
+				(entries[s].offset + entries[s].bytes > index->bytes)) {
+				break;
+			}
+		}
+		if (s == index->sequences) {
+			return index;
+		}
+		fprintf(stderr, "\nError: %s has an invalid entry for sequence %u\n", indexname, s);
+	}
+
+	munmap((void*) index, *size);
+	return NULL;
+}
@@ -0,0 +1,404 @@
+/*
+    gzinput.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Reading of gzip compressed reads and databases. A compressed file is
+    opened as a stream of the inflated text, so the parsers keep reading
+    with stdio. The blocks of a BGZF file are inflated in
+    parallel by a pool of threads and handed to the reader in their order,
+    other gzip files are inflated by one thread ahead of the reader.
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+
+#include "header/gzinput.h"
+
+#define SLOT_SIZE	(1 << 16)		/* BGZF blocks have at most 64 KiB */
+#define GZIP_HEADER	12				/* fixed part of the gzip header */
+
+enum slot_state { SLOT_FREE, SLOT_BUSY, SLOT_DONE, SLOT_END };
+
+/* one block, compressed and inflated */
+struct slot_t {
+	unsigned char in[SLOT_SIZE];
+	char out[SLOT_SIZE];
+	unsigned int inlength, outlength;
+	int state;
+};
+
+/* inflated stream of a compressed file */
+struct gzinput_t {
+	FILE *file;
+	int bgzf;
+	z_stream stream;				/* gzip: state of the only worker */
+	unsigned char *gzbuffer;
+
+	struct slot_t *slots;
+	unsigned int slotcount;
+	unsigned long head, tail;		/* next slot to read and to fill */
+	unsigned int position;			/* read bytes of the head slot */
+	int end, error, stop;			/* end: a slot has SLOT_END */
+	int member;						/* gzip: a member is not finished yet */
+	int eofblock;					/* BGZF: the last block was empty, as the end-of-file block */
+
+	pthread_mutex_t mutex;
+	pthread_cond_t filled, freed;
+	pthread_t *workers;
+	unsigned int threads;
+};
+
+/******************************************************************************
+ * Kind of the file: GZINPUT_PLAIN, GZINPUT_GZIP or GZINPUT_BGZF, -1 if it
+ * can not be read
+ ******************************************************************************/
+int compressedInput(const char *name) {
+	unsigned char header[GZIP_HEADER + 4];
+	size_t n;
+	FILE *file;
+
+	file = fopen(name, "rb");
+	if (file == NULL) {
+		return -1;
+	}
+	n = fread(header, 1, sizeof(header), file);
+	fclose(file);
+
+	if ((n < GZIP_HEADER) || (header[0] != 0x1f) || (header[1] != 0x8b)) {
+		return GZINPUT_PLAIN;
+	}
+	/* BGZF: extra field with the subfield BC as the first one */
+	if ((n == sizeof(header)) && (header[3] & 4) && (header[12] == 'B') && (header[13] == 'C')) {
+		return GZINPUT_BGZF;
+	}
+	return GZINPUT_GZIP;
+}
+
+/******************************************************************************
+ * Reads the next BGZF block into a slot, returns 0 at the end of the file.
+ * A file cut within a block or without the end-of-file block is an error.
+ ******************************************************************************/
+static int readBlock(struct gzinput_t *gz, struct slot_t *slot) {
+	unsigned char *h = slot->in;
+	unsigned int xlen, bsize = 0, i;
+	size_t n;
+
+	n = fread(h, 1, GZIP_HEADER, gz->file);
+	if (n != GZIP_HEADER) {
+		return ((n == 0) && !ferror(gz->file) && gz->eofblock) ? 0 : -1;
+	}
+	xlen = h[10] | (h[11] << 8);
+	if ((h[0] != 0x1f) || (h[1] != 0x8b) || !(h[3] & 4) || (GZIP_HEADER + xlen > SLOT_SIZE) ||
+		(fread(h + GZIP_HEADER, 1, xlen, gz->file) != xlen)) {
+		return -1;
+	}
+	for (i = GZIP_HEADER; i + 4 <= GZIP_HEADER + xlen; i += 4 + (h[i+2] | (h[i+3] << 8))) {
+		if ((h[i] == 'B') && (h[i+1] == 'C')) {
+			bsize = (h[i+4] | (h[i+5] << 8)) + 1;
+		}
+	}
+	if ((bsize < GZIP_HEADER + xlen + 8) || (bsize > SLOT_SIZE) ||
+		(fread(h + GZIP_HEADER + xlen, 1, bsize - GZIP_HEADER - xlen, gz->file) != bsize - GZIP_HEADER - xlen)) {
+		return -1;
+	}
+	slot->inlength = bsize;
+	gz->eofblock = ((h[bsize-4] | h[bsize-3] | h[bsize-2] | h[bsize-1]) == 0);
+	return 1;
+}
+
+/******************************************************************************
+ * Inflates a BGZF block and checks its size and CRC
+ ******************************************************************************/
+static int inflateBlock(z_stream *z, struct slot_t *slot) {
+	unsigned char *h = slot->in;
+	unsigned int xlen = h[10] | (h[11] << 8);
+	unsigned char *trailer = h + slot->inlength - 8;
+	uint32_t crc, size;
+
+	crc = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | ((uint32_t) trailer[3] << 24);
+	size = trailer[4] | (trailer[5] << 8) | (trailer[6] << 16) | ((uint32_t) trailer[7] << 24);
+	if (size > SLOT_SIZE) {
+		return -1;
+	}
+
+	inflateReset(z);
+	z->next_in = h + GZIP_HEADER + xlen;
+	z->avail_in = slot->inlength - GZIP_HEADER - xlen - 8;
+	z->next_out = (unsigned char*) slot->out;
+	z->avail_out = SLOT_SIZE;
+	if ((inflate(z, Z_FINISH) != Z_STREAM_END) || (z->total_out != size) ||
+		(crc32(crc32(0, NULL, 0), (unsigned char*) slot->out, size) != crc)) {
+		return -1;
+	}
+	slot->outlength = size;
+	return 0;
+}
+
+/******************************************************************************
+ * Inflates the next part of a gzip stream into a slot, several members are
+ * read as one stream. Returns 0 at the end of the file and -1 if the file
+ * ends within a member.
+ ******************************************************************************/
+static int inflateStream(struct gzinput_t *gz, struct slot_t *slot) {
+	z_stream *z = &gz->stream;
+	int ret;
+
+	z->next_out = (unsigned char*) slot->out;
+	z->avail_out = SLOT_SIZE;
+	while (z->avail_out > 0) {
+		if (z->avail_in == 0) {
+			z->avail_in = fread(gz->gzbuffer, 1, SLOT_SIZE, gz->file);
+			z->next_in = gz->gzbuffer;
+			if (z->avail_in == 0) {
+				if (ferror(gz->file) || gz->member) {
+					return -1;
+				}
+				break;
+			}
+		}
+		gz->member = 1;
+		ret = inflate(z, Z_NO_FLUSH);
+		if (ret == Z_STREAM_END) {
+			inflateReset(z);
+			gz->member = 0;
+		} else if ((ret != Z_OK) && (ret != Z_BUF_ERROR)) {
+			return -1;
+		}
+	}
+	slot->outlength = SLOT_SIZE - z->avail_out;
+	return slot->outlength > 0;
+}
+
+/******************************************************************************
+ * Worker of the pool: takes the next free slot, fills it from the file and
+ * inflates it. The BGZF blocks are read under the lock and inflated in
+ * parallel, a gzip stream has only one worker.
+ ******************************************************************************/
+static void *inflateWorker(void *arg) {
+	struct gzinput_t *gz = (struct gzinput_t*) arg;
+	struct slot_t *slot;
+	z_stream z;
+	int ready, ret;
+
+	memset(&z, 0, sizeof(z));
+	ready = (inflateInit2(&z, -MAX_WBITS) == Z_OK);
+
+	pthread_mutex_lock(&gz->mutex);
+	while (!gz->stop && !gz->end) {
+		slot = &gz->slots[gz->tail % gz->slotcount];
+		if (slot->state != SLOT_FREE) {
+			pthread_cond_wait(&gz->freed, &gz->mutex);
+			continue;
+		}
+		slot->state = SLOT_BUSY;
+		gz->tail++;
+
+		if (gz->bgzf) {
+			ret = readBlock(gz, slot);
+			if ((ret == 1) && !ready) {
+				ret = -1;
+			} else if (ret == 1) {
+				pthread_mutex_unlock(&gz->mutex);
+				ret = inflateBlock(&z, slot);
+				pthread_mutex_lock(&gz->mutex);
+				ret = (ret == 0) ? 1 : -1;
+			}
+		} else {
+			pthread_mutex_unlock(&gz->mutex);
+			ret = inflateStream(gz, slot);
+			pthread_mutex_lock(&gz->mutex);
+		}
+
+		if (ret == 1) {
+			slot->state = SLOT_DONE;
+		} else {
+			/* no slot is taken behind the end or an error */
+			slot->state = SLOT_END;
+			gz->end = 1;
+			gz->error = (ret == -1);
+		}
+		pthread_cond_broadcast(&gz->filled);
+	}
+	pthread_mutex_unlock(&gz->mutex);
+
+	if (ready) {
+		inflateEnd(&z);
+	}
+	return NULL;
+}
+
+/******************************************************************************
+ * Read function of the stream: copies the inflated blocks in their order
+ ******************************************************************************/
+static ssize_t gzRead(void *cookie, char *buffer, size_t size) {
+	struct gzinput_t *gz = (struct gzinput_t*) cookie;
+	struct slot_t *slot;
+	size_t done = 0, n;
+
+	pthread_mutex_lock(&gz->mutex);
+	while (done < size) {
+		slot = &gz->slots[gz->head % gz->slotcount];
+		if (slot->state == SLOT_END) {
+			if ((done == 0) && (gz->error != 0)) {
+				done = -1;
+			}
+			break;
+		}
+		if (slot->state != SLOT_DONE) {
+			if (done > 0) {
+				break;
+			}
+			pthread_cond_wait(&gz->filled, &gz->mutex);
+			continue;
+		}
+
+		n = slot->outlength - gz->position;
+		if (n > size - done) {
+			n = size - done;
+		}
+		memcpy(buffer + done, slot->out + gz->position, n);
+		done += n;
+		gz->position += n;
+		if (gz->position == slot->outlength) {
+			slot->state = SLOT_FREE;
+			gz->position = 0;
+			gz->head++;
+			pthread_cond_broadcast(&gz->freed);
+		}
+	}
+	pthread_mutex_unlock(&gz->mutex);
+
+	return done;
+}
+
+/******************************************************************************
+ * Stops the workers and frees the stream
+ ******************************************************************************/
+static int gzClose(void *cookie) {
+	struct gzinput_t *gz = (struct gzinput_t*) cookie;
+	unsigned int t;
+
+	pthread_mutex_lock(&gz->mutex);
+	gz->stop = 1;
+	pthread_cond_broadcast(&gz->freed);
+	pthread_mutex_unlock(&gz->mutex);
+	for (t = 0; t < gz->threads; t++) {
+		pthread_join(gz->workers[t], NULL);
+	}
+
+	if (!gz->bgzf) {
+		inflateEnd(&gz->stream);
+	}
+	fclose(gz->file);
+	free(gz->gzbuffer);
+	free(gz->slots);
+	free(gz->workers);
+	free(gz);
+	return 0;
+}
+
+/******************************************************************************
+ * Opens a file for reading, compressed files as a stream of the inflated text
+ ******************************************************************************/
+FILE *openInput(const char *name) {
+	cookie_io_functions_t io = {gzRead, NULL, NULL, gzClose};
+	struct gzinput_t *gz;
+	long threads;
+	int kind;
+	FILE *file;
+
+	kind = compressedInput(name);
+	if (kind != GZINPUT_GZIP && kind != GZINPUT_BGZF) {
+		return fopen(name, "rb");
+	}
+
+	gz = (struct gzinput_t*) calloc(1, sizeof(struct gzinput_t));
+	if (gz == NULL) {
+		return NULL;
+	}
+	gz->file = fopen(name, "rb");
+	gz->bgzf = (kind == GZINPUT_BGZF);
+
+	threads = 1;
+	if (gz->bgzf) {
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+		if (threads < 1) {
+			threads = 1;
+		}
+	} else {
+		gz->gzbuffer = (unsigned char*) malloc(SLOT_SIZE);
+		if ((gz->gzbuffer == NULL) || (inflateInit2(&gz->stream, 16 + MAX_WBITS) != Z_OK)) {
+			fclose(gz->file);
+			free(gz->gzbuffer);
+			free(gz);
+			return NULL;
+		}
+	}
+	gz->slotcount = 2 * threads + 2;
+	gz->slots = (struct slot_t*) calloc(gz->slotcount, sizeof(struct slot_t));
+	gz->workers = (pthread_t*) calloc(threads, sizeof(pthread_t));
+	if ((gz->file == NULL) || (gz->slots == NULL) || (gz->workers == NULL)) {
+		if (gz->file != NULL) {
+			fclose(gz->file);
+		}
+		if (!gz->bgzf) {
+			inflateEnd(&gz->stream);
+		}
+		free(gz->gzbuffer);
+		free(gz->slots);
+		free(gz->workers);
+		free(gz);
+		return NULL;
+	}
+
+	pthread_mutex_init(&gz->mutex, NULL);
+	pthread_cond_init(&gz->filled, NULL);
+	pthread_cond_init(&gz->freed, NULL);
+	for (gz->threads = 0; gz->threads < threads; gz->threads++) {
+		if (pthread_create(&gz->workers[gz->threads], NULL, inflateWorker, gz)) {
+			break;
+		}
+	}
+	if (gz->threads == 0) {
+		gzClose(gz);
+		return NULL;
+	}
+
+	file = fopencookie(gz, "r", io);
+	if (file == NULL) {
+		gzClose(gz);
+	}
+	return file;
+}
@@ -0,0 +1,47 @@
+/*
+ * bamout.h
+ *
+ *  Writing of the results as BAM. The records are encoded into a buffer of
+ *  each writer and compressed to BGZF blocks by a pool of threads.
+ */
+
+#ifndef BAMOUT_H_
+#define BAMOUT_H_
+
+#include <stdint.h>
+
+#define BAM_BLOCK	0xff00		/* uncompressed bytes of a BGZF block */
+
+/* records of one writer up to the next block */
+struct bambuffer_t {
+	char *data;
+	unsigned int length;
+};
+
+/* one ungapped alignment */
+struct bamrecord_t {
+	const char *name;			/* read name, up to the first blank */
+	int32_t reference;
+	int32_t position;			/* 0-based */
+	uint16_t flag;
+	uint32_t length;			/* bases of the alignment */
+	const char *bases;			/* NULL: not stored */
+	const char *quality;		/* NULL: not stored, else phred + 33 */
+};
+
+struct bamfile_t;
+
+struct bamfile_t *bamOpen(const char *name);
+
+int bamBuffer(struct bambuffer_t *buffer);
+
+int bamHeader(struct bamfile_t *f, struct bambuffer_t *buffer, unsigned int references,
+		const char *const *names, const uint64_t *lengths);
+
+int bamRecord(struct bamfile_t *f, struct bambuffer_t *buffer, const struct bamrecord_t *record);
+
+int bamFlush(struct bamfile_t *f, struct bambuffer_t *buffer);
+
+int bamClose(struct bamfile_t *f);
+
+#endif /* BAMOUT_H_ */
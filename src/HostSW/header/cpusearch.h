@@ -0,0 +1,26 @@
+/*
+ * cpusearch.h
+ *
+ *  Software search engine for the host CPU, which searches the binary
+ *  database with the reads of the readmap and returns the results in
+ *  the layout of the FPGA.
+ */
+
+#ifndef CPUSEARCH_H_
+#define CPUSEARCH_H_
+
+#include <stdint.h>
+
+int cpuInit(unsigned int threads);
+
+void cpuLoadReads(const char *readmap, const uint8_t *mismatch, unsigned int reads, int positions);
+
+void cpuSearch(const char *text, unsigned long bytes);
+
+int cpuResults(char *results, unsigned long size);
+
+const char *cpuKernel();
+
+void cpuFree();
+
+#endif /* CPUSEARCH_H_ */
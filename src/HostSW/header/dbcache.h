@@ -0,0 +1,45 @@
+/*
+ * dbcache.h
+ *
+ *  Memory of the binary database. By default the file is mapped and the
+ *  part ahead of the stream is read in the background; pinned, it is copied
+ *  into 2 MB pages and locked in memory. The page faults and dTLB misses of
+ *  the search are counted for the status.
+ */
+
+#ifndef DBCACHE_H_
+#define DBCACHE_H_
+
+#include <stdint.h>
+
+#define DB_HUGEPAGE	(2UL << 20)
+#define DB_PREFETCH	(16UL << 20)	/* bytes read ahead of the stream */
+
+struct dbcache_t {
+	char *data;
+	uint64_t size;
+	void *base;					/* mapping of the data */
+	uint64_t length;
+	int pinned;					/* copied into anonymous memory */
+	int hugepages;				/* 2: hugetlbfs, 1: transparent, 0: base pages */
+	int locked;
+};
+
+/* page faults and dTLB misses of the process between start and stop */
+struct faultcount_t {
+	long minor, major;
+	long long tlb;				/* -1: no counter */
+	int tlbfd;
+};
+
+int dbLoad(struct dbcache_t *c, int fd, uint64_t size, int pin);
+
+void dbPrefetch(const struct dbcache_t *c, uint64_t from, uint64_t to);
+
+void dbFree(struct dbcache_t *c);
+
+void faultStart(struct faultcount_t *f);
+
+void faultStop(struct faultcount_t *f);
+
+#endif /* DBCACHE_H_ */
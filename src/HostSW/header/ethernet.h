@@ -8,15 +8,84 @@
 #ifndef ETHERNET_H_
 #define ETHERNET_H_
 
-void initializeEthernetConnection(char* send_buffer);
+#include <stdint.h>
+#include <sys/socket.h>
+#include <linux/if.h>
+#include <linux/if_packet.h>
 
-void sendData(int length, char ctr,  char* send_buffer, unsigned int id);
+#include "protocol.h"
 
-void sendControl(char ctr,  char* send_buffer, unsigned int id);
+#define MAXBOARDS 8
 
-char receive(int buf_size, char* rec_buffer);
+/* Transmit paths of the database stream */
+#define TX_COPY		0	/* copy into the send buffer, one sendto per frame */
+#define TX_MMSG		1	/* one sendmmsg per burst, frames sent in place */
+#define TX_RING		2	/* PACKET_TX_RING, one system call per burst */
 
-uint16_t searchDevice(char* send_buffer, char* rec_buffer, unsigned int id);
+#define TX_BURST		64
+#define TX_FRAMES		128
+#define TX_FRAME_SIZE	2048
+
+/* Receive ring, results are copied out of its frames into the blocks of the
+ * result writer, so a frame is free again before the results are decoded */
+#define RX_FRAMES		1024
+#define RX_FRAME_SIZE	2048
+
+/* Connection to one board or one fpga-emu */
+struct device_t {
+	char host_mac[6];
+	char client_mac[6];
+	char ifname[IFNAMSIZ];
+	char devsocket[100];		/* AF_UNIX socket of fpga-emu, empty for raw Ethernet */
+	int send_socket;
+	int recv_socket;
+	struct sockaddr_ll sa;
+	struct sockaddr_ll ra;
+	int tx;						/* transmit path of the database stream */
+	int ring_socket;
+	char *txring;
+	unsigned int txframe;
+	char *rxring;				/* PACKET_RX_RING, NULL: one recvfrom per frame */
+	unsigned int rxframe;
+	char frame[BUF_SIZE];			/* received frame without RX ring */
+	unsigned long drops;		/* frames dropped by the kernel, ring full */
+	unsigned int board;			/* interface of the board in the trace */
+	uint16_t credit;			/* bytes of the last ctr_send_next, for the trace */
+};
+
+/* Frame of the database stream, length like in sendData */
+struct frame_t {
+	char ctr;
+	unsigned int id;
+	const char *data;
+	int length;
+};
+
+int readDeviceConfiguration(struct device_t *devices, unsigned int max);
+
+void initializeEthernetConnection(struct device_t *dev, char* send_buffer);
+
+void initializeSocketConnection(struct device_t *dev);
+
+void sendData(struct device_t *dev, int length, char ctr,  char* send_buffer, unsigned int id);
+
+void sendControl(struct device_t *dev, char ctr,  char* send_buffer, unsigned int id);
+
+char receive(struct device_t *dev, int buf_size, char* rec_buffer);
+
+int initializeRxRing(struct device_t *dev);
+
+char receiveFrame(struct device_t *dev, const char **data, int *length);
+
+void releaseFrame(struct device_t *dev);
+
+unsigned long droppedFrames(struct device_t *dev);
+
+int initializeTxRing(struct device_t *dev);
+
+int sendFrames(struct device_t *dev, char* send_buffer, const struct frame_t *frames, unsigned int count);
+
+uint16_t searchDevice(struct device_t *dev, char* send_buffer, char* rec_buffer, unsigned int id);
 
 double testMaxBandwidth(char* send_buffer, char* rec_buffer);
 
@@ -8,7 +8,48 @@
 #ifndef FORMATDB_H_
 #define FORMATDB_H_
 
-int transformdb(char *databasename, char *bindbname, char *infodbname);
+#include <stdint.h>
+
+/*
+ * Binary index of the binary database, written by transformdb and mapped
+ * by the host program. The header is followed by one entry per sequence,
+ * the runs of N and the names, each terminated by a zero. All numbers are
+ * in host byte order.
+ */
+#define DBINDEX_MAGIC	"FPGADBIX"
+#define DBINDEX_VERSION	2
+
+struct dbindex_t {
+	char magic[8];
+	uint32_t version;		/* 0: read from an old .dbinfo, no checksum */
+	uint32_t sequences;
+	uint64_t bases;			/* bases of all sequences */
+	uint64_t bytes;			/* size of the binary database */
+	uint64_t checksum;		/* dbChecksum of the binary database */
+	uint64_t gaps;			/* runs of N */
+	uint64_t masked;		/* bases in runs of N */
+	uint64_t names;			/* offset of the names in the index */
+};
+
+struct dbentry_t {
+	uint64_t offset;		/* first byte in the binary database */
+	uint64_t bytes;			/* bytes in the binary database, the last one padded */
+	uint64_t bases;
+	uint64_t start;			/* bases of all sequences before */
+	uint64_t name;			/* offset of the name behind the names offset */
+};
+
+/* run of N, packed like G in the binary database */
+struct dbgap_t {
+	uint64_t start;			/* in bases of the whole database */
+	uint64_t bases;
+};
+
+int transformdb(char *databasename, char *bindbname, char *indexname);
+
+uint64_t dbChecksum(const char *data, uint64_t bytes);
+
+const struct dbindex_t *mapDBIndex(const char *indexname, uint64_t *size);
 
 
 #endif /* FORMATDB_H_ */
@@ -0,0 +1,21 @@
+/*
+ * gzinput.h
+ *
+ *  Reading of gzip and BGZF compressed reads and databases as a stream of
+ *  the inflated text.
+ */
+
+#ifndef GZINPUT_H_
+#define GZINPUT_H_
+
+#include <stdio.h>
+
+#define GZINPUT_PLAIN	0
+#define GZINPUT_GZIP	1
+#define GZINPUT_BGZF	2
+
+int compressedInput(const char *name);
+
+FILE *openInput(const char *name);
+
+#endif /* GZINPUT_H_ */
@@ -0,0 +1,52 @@
+/*
+ * jobserver.h
+ *
+ *  Job socket of the alignment daemon. A client sends one request line over
+ *  a UNIX domain stream socket and reads the reply up to the end of the
+ *  connection; the reply of a job comes when the job is finished.
+ *
+ *  JOB <mismatch> <flags> <query> <output>	tab separated, absolute paths
+ *  STATUS										depth of the queue and latencies
+ *  STOP										end after the queued jobs
+ *
+ *  The first line of a reply is "OK" or "ERROR <reason>".
+ */
+
+#ifndef JOBSERVER_H_
+#define JOBSERVER_H_
+
+#include <stdio.h>
+
+#define JOB_SOCKET	"fpga-align.sock"	/* default path of the socket */
+#define JOB_PATH	4096
+#define JOB_QUEUE	64					/* jobs waiting for the boards */
+
+/* flags of a job */
+#define JOB_SAM		0x01
+#define JOB_BAM		0x02
+#define JOB_QUALITY	0x04
+#define JOB_MAP		0x08
+
+struct job_t {
+	unsigned long id;
+	char query[JOB_PATH];
+	char output[JOB_PATH];
+	unsigned int mismatch;
+	unsigned int flags;
+	int client;					/* connection waiting for the reply */
+	double queued, started;		/* seconds */
+};
+
+struct jobserver_t;
+
+struct jobserver_t *jobListen(const char *path);
+
+int jobNext(struct jobserver_t *s, struct job_t *job, int wait);
+
+void jobDone(struct jobserver_t *s, struct job_t *job, int rc, const char *summary);
+
+void jobClose(struct jobserver_t *s);
+
+int jobRequest(const char *path, const char *request, FILE *out);
+
+#endif /* JOBSERVER_H_ */
@@ -0,0 +1,41 @@
+/*
+ * metrics.h
+ *
+ *  Counters and histograms of the search. They are written as JSON at the
+ *  end of a run and served in the Prometheus text format on a TCP port of
+ *  the local host or a UNIX domain socket while the run is in progress.
+ */
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+/* counters */
+#define METRIC_STREAM_BYTES		0	/* database bytes searched */
+#define METRIC_STREAM_PACKETS	1	/* database packets sent */
+#define METRIC_OVERFLOWS		2
+#define METRIC_READS			3	/* reads with their results written */
+#define METRIC_MAPPED			4
+#define METRIC_COUNTERS			5
+
+/* histograms */
+#define METRIC_SEGMENT_SECONDS	0	/* stream or CPU search of a segment */
+#define METRIC_CREDIT_BYTES		1	/* free bytes of the FPGA text FIFO of a ctr_send_next */
+#define METRIC_PAUSE_SECONDS	2	/* stream paused for an overflow */
+#define METRIC_DOWNLOAD_SECONDS	3	/* results of a run downloaded */
+#define METRIC_READ_HITS		4	/* positions of a read */
+#define METRIC_FORMAT_SECONDS	5	/* results of a download decoded and written */
+#define METRIC_HISTOGRAMS		6
+
+void metricAdd(unsigned int counter, double value);
+
+void metricObserve(unsigned int histogram, double value);
+
+void metricsReset();
+
+int metricsJson(const char *filename);
+
+int metricsServe(const char *address);
+
+void metricsStop();
+
+#endif /* METRICS_H_ */
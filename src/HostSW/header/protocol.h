@@ -0,0 +1,43 @@
+/*
+ * protocol.h
+ *
+ *  Control codes and frame sizes of the raw Ethernet protocol
+ *  between the host and the search design on the FPGA.
+ */
+
+#ifndef PROTOCOL_H_
+#define PROTOCOL_H_
+
+#define BUF_SIZE 	 1514
+#define DATA_SIZE 	 1498
+#define REAL_DB_DATA 1496
+#define CTR_BUF_SIZE 60
+#define MAXUNITS_V5  100
+#define MAXUNITS_V6  600
+
+#define ETH_P_FPGA	 0x0801
+
+enum CONTROL {
+	ctr_first_data 			= 0x10,	/* First Data Packet */
+	ctr_data 				= 0x11,	/* Normal Data Packet */
+	ctr_last_data 			= 0x12,	/* Last Data Packet */
+
+	ctr_send_next 			= 0x13,	/* FPGA -> Host: send next Data Packet */
+	ctr_send_DB 			= 0x14,	/* FPGA -> Host: send DB */
+	ctr_get_data 			= 0x15,	/* Host -> FPGA: send Data */
+	ctr_finished_search 	= 0x16, /* FPGA -> HOST: last DB character */
+	ctr_finished_sending 	= 0x17, /* FPGA -> HOST: finished sending of results */
+	ctr_next_segment		= 0x18, /* Host -> FPGA: begin iteration for next segment of reads */
+	ctr_finished_iteration	= 0x19, /* HOST -> FPGA: finished work -> next state waiting */
+
+	ctr_getid 				= 0x20,	/* Host -> FPGA: get ID */
+	info_v5 				= 0x21,	/* FPGA -> Host: ID = Vertex-5 */
+	info_v6 				= 0x22,	/* FPGA -> Host: ID = Vertex-6 */
+	error					= 0x24, /* FPGA -> Host: packet lost */
+	ctr_reset				= 0x19, /* Host -> FPGA: reset */
+
+	ctr_overflow			= 0x30, /* FPGA -> Host: overflow */
+	ctr_overflow_ready		= 0x31  /* Host -> FPGA: continue searching */
+};
+
+#endif /* PROTOCOL_H_ */
@@ -0,0 +1,46 @@
+/*
+ * readcache.h
+ *
+ *  Hits of the reads searched in a run. A read that comes again in a later
+ *  batch takes the hits of its first copy instead of units of a board; it
+ *  waits if that copy is still searched by another board.
+ */
+
+#ifndef READCACHE_H_
+#define READCACHE_H_
+
+#include <stdint.h>
+
+#define CACHE_MEMORY	(256 << 20)	/* bytes of the cached reads and their hits */
+
+struct cachedhit_t {
+	uint64_t offset;
+	uint32_t sequence;
+	uint16_t reverse;
+	uint16_t read;				/* slot of the batch while the hit is logged */
+};
+
+struct cachedread_t {
+	uint64_t hash;
+	unsigned int length, mismatch;
+	const char *bases;
+	int done;					/* the hits are complete */
+	unsigned int users;			/* reads of taken batches */
+	uint32_t positions;
+	int8_t best, bestmismatch;
+	struct cachedhit_t *hit;
+	unsigned int hits;
+};
+
+struct cachedread_t *cacheTake(uint64_t hash, unsigned int length, unsigned int mismatch, const char *bases, int add, int *found);
+
+void cacheDone(struct cachedread_t *e, struct cachedhit_t *hit, unsigned int hits,
+			   uint32_t positions, int8_t best, int8_t bestmismatch);
+
+void cacheWait(struct cachedread_t *e);
+
+void cacheRelease(struct cachedread_t *e);
+
+void cacheFree();
+
+#endif /* READCACHE_H_ */
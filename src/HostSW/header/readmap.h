@@ -0,0 +1,26 @@
+/*
+ * readmap.h
+ *
+ *  Decoding of the bit-transposed LUT tables in the readmap back into
+ *  bit-parallel read bases, shared by the software search engines.
+ */
+
+#ifndef READMAP_H_
+#define READMAP_H_
+
+#include <stdint.h>
+
+#define READ_BYTES	 132		/* 33 words of one read in the readmap */
+#define MAX_BASES	 64			/* width of the text window */
+#define MAX_MISMATCH 7			/* the mismatch counter saturates at 3 bits */
+
+struct read_bits {
+	uint64_t hi;				/* high bit of every read base */
+	uint64_t lo;				/* low bit of every read base */
+	uint64_t care;				/* bases which are not wildcards */
+	unsigned int length;		/* bases up to the last non-wildcard */
+};
+
+void decodeRead(const char *readmap, struct read_bits *read);
+
+#endif /* READMAP_H_ */
@@ -0,0 +1,31 @@
+/*
+ * seqfile.h
+ *
+ *  Block reader for the records of FASTA and FASTQ read files, plain or
+ *  compressed.
+ */
+
+#ifndef SEQFILE_H_
+#define SEQFILE_H_
+
+#define SEQFILE_BUFFER	(4 << 20)	/* bytes read from the file at once */
+
+/* one record, valid until the next call of nextRecord */
+struct seqrecord_t {
+	const char *name;			/* header line behind '>' or '@' */
+	unsigned int namelength;
+	const char *bases;			/* bases of all sequence lines */
+	unsigned int length;
+	const char *quality;		/* FASTQ: one character per base, FASTA: NULL */
+	int mismatch;				/* "/n" behind the bases, -1 without */
+};
+
+struct seqfile_t;
+
+struct seqfile_t *openSeqFile(const char *name);
+
+int nextRecord(struct seqfile_t *f, struct seqrecord_t *record);
+
+void closeSeqFile(struct seqfile_t *f);
+
+#endif /* SEQFILE_H_ */
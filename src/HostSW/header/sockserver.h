@@ -0,0 +1,47 @@
+/*
+ * sockserver.h
+ *
+ *  Stream sockets of the daemon and the metrics server. A socket file is
+ *  only replaced if it is left behind by an ended process, and the requests
+ *  of all connections are read by one poll loop, so a silent client does
+ *  not hold up the others.
+ */
+
+#ifndef SOCKSERVER_H_
+#define SOCKSERVER_H_
+
+#include <stddef.h>
+
+#define SOCK_REQUEST	(2 * 4096 + 64)	/* bytes of a request */
+#define SOCK_PENDING	16				/* connections still sending their request */
+#define SOCK_TIMEOUT	5				/* seconds for a request */
+
+/* connection whose request is not complete yet */
+struct sockpending_t {
+	int fd;
+	size_t length;
+	double since;
+	char data[SOCK_REQUEST];
+};
+
+struct sockserver_t {
+	int listen;
+	/* 1 if data holds a whole request, which it may cut behind its end */
+	int (*complete)(char *data, size_t length);
+	/* the request of fd, take closes or keeps the connection */
+	void (*take)(void *context, int fd, char *request);
+	void *context;
+	/* replies to a connection without a request, to one too many and at the end, NULL for none */
+	const char *late, *full, *stopped;
+
+	struct sockpending_t pending[SOCK_PENDING];
+	unsigned int pendings;
+};
+
+void sockReply(int fd, const char *data, size_t length);
+
+int sockUnix(const char *path, int owner, int backlog);
+
+void sockServe(struct sockserver_t *s);
+
+#endif /* SOCKSERVER_H_ */
@@ -0,0 +1,144 @@
+/*
+ * textout.h
+ *
+ *  Buffered writing of the PAM and SAM lines without stdio. Every writer
+ *  fills a buffer of its own, full buffers are written with write(). A line
+ *  is formatted in place: textReserve() returns room for it, textCopy() and
+ *  textDecimal() fill it and textCommit() appends it.
+ */
+
+#ifndef TEXTOUT_H_
+#define TEXTOUT_H_
+
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define TEXT_BUFFER	(1 << 20)		/* bytes written at once */
+#define TEXT_SLOT	32				/* bytes of a short field copied at once */
+
+struct textbuffer_t {
+	char *data;
+	unsigned int length, size;
+	int fd;
+	int error;
+};
+
+extern const char text_digit_pairs[200];
+extern const uint32_t text_powers[10];
+
+int textBuffer(struct textbuffer_t *buffer, int fd);
+
+char *textRoom(struct textbuffer_t *buffer, unsigned int length);
+
+int textFlush(struct textbuffer_t *buffer);
+
+/* room for at least length bytes, NULL if the buffer can not grow */
+static inline char *textReserve(struct textbuffer_t *buffer, unsigned int length) {
+	if (buffer->length + length <= buffer->size) {
+		return buffer->data + buffer->length;
+	}
+	return textRoom(buffer, length);
+}
+
+static inline void textCommit(struct textbuffer_t *buffer, char *end) {
+	buffer->length = (unsigned int) (end - buffer->data);
+}
+
+static inline char *textCopy(char *p, const char *data, unsigned int length) {
+	memcpy(p, data, length);
+	return p + length;
+}
+
+/* a field at the start of a slot of at least TEXT_SLOT bytes, e.g. a label:
+ * a short one is copied as the whole slot start without a call of memcpy,
+ * the room reserved must cover TEXT_SLOT bytes */
+static inline char *textCopySlot(char *p, const char *data, unsigned int length) {
+	if (length <= TEXT_SLOT) {
+		memcpy(p, data, TEXT_SLOT);
+		return p + length;
+	}
+	return textCopy(p, data, length);
+}
+
+/* number in decimal, two digits per step from the end */
+static inline char *textDecimalLong(char *p, uint64_t value) {
+	unsigned int digits = 1;
+	uint64_t v;
+	char *end;
+
+	for (v = value; v >= 100; v = v / 100) {
+		digits = digits + 2;
+	}
+	digits = digits + (v >= 10);
+
+	end = p + digits;
+	p = end;
+	while (value >= 100) {
+		p = p - 2;
+		memcpy(p, text_digit_pairs + 2 * (value % 100), 2);
+		value = value / 100;
+	}
+	if (value >= 10) {
+		memcpy(p - 2, text_digit_pairs + 2 * value, 2);
+	} else {
+		p[-1] = '0' + (char) value;
+	}
+	return end;
+}
+
+/* the eight digits of x < 10^8 as characters, the first in the lowest byte */
+static inline uint64_t textEight(uint32_t x) {
+#ifdef __SSE2__
+	/* 10^3 .. 10^0 of both halves in the 16 bit lanes: abcd / 1000, abcd / 100, ... */
+	const __m128i divide = _mm_setr_epi16(8389, 5243, 13108, (short) 0x8000, 8389, 5243, 13108, (short) 0x8000);
+	const __m128i shift = _mm_setr_epi16(1 << 7, 1 << 11, 1 << 13, (short) 0x8000, 1 << 7, 1 << 11, 1 << 13, (short) 0x8000);
+	__m128i v, abcd, efgh;
+
+	v = _mm_cvtsi32_si128((int) x);
+	abcd = _mm_srli_epi64(_mm_mul_epu32(v, _mm_set1_epi32((int) 0xD1B71759)), 45);
+	efgh = _mm_sub_epi32(v, _mm_mul_epu32(abcd, _mm_set1_epi32(10000)));
+	v = _mm_slli_epi64(_mm_unpacklo_epi16(abcd, efgh), 2);
+	v = _mm_unpacklo_epi16(v, v);
+	v = _mm_unpacklo_epi32(v, v);
+	v = _mm_mulhi_epu16(_mm_mulhi_epu16(v, divide), shift);
+	v = _mm_sub_epi16(v, _mm_slli_epi64(_mm_mullo_epi16(v, _mm_set1_epi16(10)), 16));
+	v = _mm_add_epi8(_mm_packus_epi16(v, v), _mm_set1_epi8('0'));
+	return (uint64_t) _mm_cvtsi128_si64(v);
+#else
+	/* two 32 bit lanes of four digits, then 16 bit lanes of two, then bytes */
+	uint64_t v = (x / 10000) | ((uint64_t) (x % 10000) << 32), q;
+
+	q = ((v * 10486) >> 20) & 0x0000007F0000007FULL;
+	v = q | ((v - 100 * q) << 16);
+	q = ((v * 103) >> 10) & 0x000F000F000F000FULL;
+	v = q | ((v - 10 * q) << 8);
+	return v | 0x3030303030303030ULL;
+#endif
+}
+
+/* number in decimal. Below 2^32 without a loop or a branch: the last eight
+ * digits are written as one word of 8 bytes, so up to 7 bytes behind the
+ * number are overwritten, the room reserved for the line must cover them. */
+static inline char *textDecimal(char *p, uint64_t value) {
+	unsigned int digits, n;
+	uint32_t v = (uint32_t) value;
+	uint64_t low;
+
+	if (value >> 32) {
+		return textDecimalLong(p, value);
+	}
+	n = ((32 - __builtin_clz(v | 1)) * 1233) >> 12;
+	digits = n + 1 - ((v | 1) < text_powers[n]);
+
+	/* the one or two leading digits first, the low word overwrites them
+	 * for up to eight digits */
+	memcpy(p, text_digit_pairs + 2 * (v / 100000000) + (digits == 9), 2);
+	low = textEight(v % 100000000) >> (8 * ((digits < 8) ? 8 - digits : 0));
+	memcpy(p + ((digits > 8) ? digits - 8 : 0), &low, 8);
+	return p + digits;
+}
+
+#endif /* TEXTOUT_H_ */
@@ -0,0 +1,30 @@
+/*
+ * trace.h
+ *
+ *  Recorder of the frames between the host and the boards. Every sent and
+ *  received frame is kept in a ring in memory, the oldest are overwritten;
+ *  traceWrite() dumps the ring as pcapng and prints the gaps of the stream
+ *  and the periods the stream waited for credit.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "ethernet.h"
+
+#define TRACE_RECORDS	(1UL << 20)		/* frames kept by default */
+
+#define TRACE_TX		0
+#define TRACE_RX		1
+
+int traceStart(unsigned long records);
+
+void traceDevice(struct device_t *dev, unsigned int number);
+
+void traceFrame(struct device_t *dev, int direction, char ctr, unsigned int id, int length);
+
+int traceWrite(const char *filename);
+
+void traceStop();
+
+#endif /* TRACE_H_ */
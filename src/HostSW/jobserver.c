@@ -0,0 +1,370 @@
+/*
+    jobserver.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Job socket of the alignment daemon. An acceptor thread takes the
+    connections on a UNIX domain stream socket, answers status requests at
+    once and queues the jobs; the search takes them in their order with
+    jobNext() and replies with jobDone(), which also keeps the latencies.
+    jobRequest() is the side of the client.
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "header/jobserver.h"
+#include "header/sockserver.h"
+
+#define REPLY		1024
+
+struct jobserver_t {
+	struct sockserver_t sock;
+	char path[sizeof(((struct sockaddr_un*) 0)->sun_path)];
+	pthread_t acceptor;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t queued_signal;
+	struct job_t queue[JOB_QUEUE];
+	unsigned int head, count;
+	unsigned int running;		/* jobs taken, their reads may share batches */
+	int stop;
+
+	/* statistics */
+	unsigned long jobs, completed, failed;
+	double waiting, latency;		/* sums of the finished jobs */
+	double lastwait, lastrun;
+};
+
+static double now() {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+}
+
+static void reply(int fd, const char *text) {
+	sockReply(fd, text, strlen(text));
+}
+
+/* the request line ends with its '\n' */
+static int completeLine(char *data, size_t length) {
+	char *end = strchr(data, '\n');
+
+	if (end == NULL) {
+		return 0;
+	}
+	*end = 0;
+	return 1;
+}
+
+/* JOB <mismatch> <flags> <query> <output> */
+static int parseJob(char *line, struct job_t *job) {
+	char *field[5];
+	unsigned int i;
+
+	field[0] = line;
+	for (i = 1; i < 5; i++) {
+		field[i] = strchr(field[i - 1], '\t');
+		if (field[i] == NULL) {
+			return -1;
+		}
+		*field[i] = 0;
+		field[i]++;
+	}
+	if ((strcmp(field[0], "JOB") != 0) || (field[3][0] != '/') || (field[4][0] != '/') ||
+		(strlen(field[3]) >= JOB_PATH) || (strlen(field[4]) >= JOB_PATH)) {
+		return -1;
+	}
+	job->mismatch = (unsigned int) strtoul(field[1], NULL, 10);
+	job->flags = (unsigned int) strtoul(field[2], NULL, 16);
+	strcpy(job->query, field[3]);
+	strcpy(job->output, field[4]);
+	return 0;
+}
+
+static void replyStatus(struct jobserver_t *s, int fd) {
+	char text[REPLY];
+	unsigned long finished;
+
+	pthread_mutex_lock(&s->mutex);
+	finished = s->completed + s->failed;
+	snprintf(text, REPLY,
+			"OK\n"
+			"queued jobs: %u\n"
+			"running jobs: %u\n"
+			"completed jobs: %lu\n"
+			"failed jobs: %lu\n"
+			"average latency: %.3f s (waiting %.3f s)\n"
+			"last latency: %.3f s (waiting %.3f s)\n",
+			s->count, s->running, s->completed, s->failed,
+			finished ? (s->waiting + s->latency) / finished : 0, finished ? s->waiting / finished : 0,
+			s->lastwait + s->lastrun, s->lastwait);
+	pthread_mutex_unlock(&s->mutex);
+
+	reply(fd, text);
+}
+
+/******************************************************************************
+ * Answers or queues the request line of a connection. A job keeps its
+ * connection open for the reply, every other request is answered here.
+ ******************************************************************************/
+static void takeRequest(void *server, int fd, char *line) {
+	struct jobserver_t *s = (struct jobserver_t*) server;
+	struct job_t *job;
+
+	if (strcmp(line, "STATUS") == 0) {
+		replyStatus(s, fd);
+		close(fd);
+		return;
+	}
+
+	pthread_mutex_lock(&s->mutex);
+	if (strcmp(line, "STOP") == 0) {
+		s->stop = 1;
+		pthread_cond_signal(&s->queued_signal);
+		pthread_mutex_unlock(&s->mutex);
+		reply(fd, "OK\nstopping after the queued jobs\n");
+		close(fd);
+		return;
+	}
+	if (s->stop) {
+		pthread_mutex_unlock(&s->mutex);
+		reply(fd, "ERROR daemon is stopping\n");
+		close(fd);
+		return;
+	}
+	if (s->count == JOB_QUEUE) {
+		pthread_mutex_unlock(&s->mutex);
+		reply(fd, "ERROR queue is full\n");
+		close(fd);
+		return;
+	}
+	job = &s->queue[(s->head + s->count) % JOB_QUEUE];
+	if (parseJob(line, job) == -1) {
+		pthread_mutex_unlock(&s->mutex);
+		reply(fd, "ERROR unknown request\n");
+		close(fd);
+		return;
+	}
+	job->id = ++s->jobs;
+	job->client = fd;
+	job->queued = now();
+	s->count++;
+	pthread_cond_signal(&s->queued_signal);
+	pthread_mutex_unlock(&s->mutex);
+}
+
+/******************************************************************************
+ * Thread taking the connections, a request line has to arrive within
+ * SOCK_TIMEOUT seconds
+ ******************************************************************************/
+static void *acceptJobs(void *server) {
+	struct jobserver_t *s = (struct jobserver_t*) server;
+
+	sockServe(&s->sock);
+	return NULL;
+}
+
+/******************************************************************************
+ * Creates the socket, readable and writable by its owner only, and starts the
+ * acceptor. A socket file left behind by an ended daemon is replaced, a
+ * running daemon is not.
+ ******************************************************************************/
+struct jobserver_t *jobListen(const char *path) {
+	struct jobserver_t *s;
+
+	s = (struct jobserver_t*) calloc(1, sizeof(struct jobserver_t));
+	if (s == NULL) {
+		fprintf(stderr, "\nError: allocating the job queue\n");
+		return NULL;
+	}
+
+	/* the daemon writes any path a client names, so only its owner may connect */
+	s->sock.listen = sockUnix(path, 1, JOB_QUEUE);
+	if (s->sock.listen < 0) {
+		free(s);
+		return NULL;
+	}
+	strcpy(s->path, path);
+	s->sock.complete = completeLine;
+	s->sock.take = takeRequest;
+	s->sock.context = s;
+	s->sock.late = "ERROR no request\n";
+	s->sock.full = "ERROR too many connections\n";
+	s->sock.stopped = "ERROR daemon stopped\n";
+
+	pthread_mutex_init(&s->mutex, NULL);
+	pthread_cond_init(&s->queued_signal, NULL);
+	if (pthread_create(&s->acceptor, NULL, acceptJobs, (void*) s) != 0) {
+		fprintf(stderr, "\nError: starting the acceptor of %s\n", path);
+		close(s->sock.listen);
+		unlink(path);
+		free(s);
+		return NULL;
+	}
+	return s;
+}
+
+/******************************************************************************
+ * Takes the next job. Returns 1 with a job, 0 if the queue is empty; with
+ * wait only after a stop request.
+ ******************************************************************************/
+int jobNext(struct jobserver_t *s, struct job_t *job, int wait) {
+
+	pthread_mutex_lock(&s->mutex);
+	while (wait && (s->count == 0) && (s->stop == 0)) {
+		pthread_cond_wait(&s->queued_signal, &s->mutex);
+	}
+	if (s->count == 0) {
+		pthread_mutex_unlock(&s->mutex);
+		return 0;
+	}
+	*job = s->queue[s->head];
+	s->head = (s->head + 1) % JOB_QUEUE;
+	s->count--;
+	s->running++;
+	job->started = now();
+	pthread_mutex_unlock(&s->mutex);
+
+	return 1;
+}
+
+/******************************************************************************
+ * Replies to the client of a finished job with the summary and its latency
+ ******************************************************************************/
+void jobDone(struct jobserver_t *s, struct job_t *job, int rc, const char *summary) {
+	char text[REPLY];
+	double run, wait;
+
+	run = now() - job->started;
+	wait = job->started - job->queued;
+
+	pthread_mutex_lock(&s->mutex);
+	if (rc == 0) {
+		s->completed++;
+	} else {
+		s->failed++;
+	}
+	s->waiting = s->waiting + wait;
+	s->latency = s->latency + run;
+	s->lastwait = wait;
+	s->lastrun = run;
+	s->running--;
+	pthread_mutex_unlock(&s->mutex);
+
+	reply(job->client, rc == 0 ? "OK\n" : "ERROR job failed, see the log of the daemon\n");
+	reply(job->client, summary);
+	snprintf(text, REPLY, "job %lu: waiting %.3f s, running %.3f s\n", job->id, wait, run);
+	reply(job->client, text);
+	close(job->client);
+
+	printf("%s%s", rc == 0 ? "" : "failed ", text);
+}
+
+/******************************************************************************
+ * Ends the acceptor, refuses the jobs still queued and removes the socket
+ ******************************************************************************/
+void jobClose(struct jobserver_t *s) {
+
+	pthread_mutex_lock(&s->mutex);
+	s->stop = 1;
+	pthread_mutex_unlock(&s->mutex);
+
+	shutdown(s->sock.listen, SHUT_RDWR);
+	pthread_join(s->acceptor, NULL);
+	close(s->sock.listen);
+	unlink(s->path);
+
+	while (s->count > 0) {
+		reply(s->queue[s->head].client, "ERROR daemon stopped\n");
+		close(s->queue[s->head].client);
+		s->head = (s->head + 1) % JOB_QUEUE;
+		s->count--;
+	}
+	free(s);
+}
+
+/******************************************************************************
+ * Sends a request to the daemon and copies the reply to out. Returns 0 if
+ * the reply starts with OK.
+ ******************************************************************************/
+int jobRequest(const char *path, const char *request, FILE *out) {
+	struct sockaddr_un address;
+	char buffer[REPLY];
+	ssize_t n;
+	int fd, ok = -1, first = 1;
+
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "\nError: socket path %s is too long\n", path);
+		return -1;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ((fd < 0) || (connect(fd, (struct sockaddr*) &address, sizeof(address)) == -1)) {
+		fprintf(stderr, "\nError: no daemon listening on %s\n", path);
+		if (fd >= 0) {
+			close(fd);
+		}
+		return -1;
+	}
+	reply(fd, request);
+
+	/* the reply ends with the connection */
+	while (1) {
+		n = recv(fd, buffer, REPLY, 0);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			break;
+		}
+		if (first) {
+			ok = ((n >= 3) && (memcmp(buffer, "OK\n", 3) == 0)) ? 0 : -1;
+			first = 0;
+		}
+		fwrite(buffer, 1, n, out);
+	}
+	close(fd);
+
+	if (first) {
+		fprintf(stderr, "\nError: no reply from the daemon on %s\n", path);
+	}
+	return ok;
+}
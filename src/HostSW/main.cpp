@@ -54,102 +54,287 @@ extern "C" {
 # include "header/ethernet.h"
 # include "header/gettime.h"
 # include "header/formatdb.h"
+# include "header/protocol.h"
+# include "header/cpusearch.h"
+# include "header/gzinput.h"
+# include "header/seqfile.h"
+# include "header/bamout.h"
+# include "header/textout.h"
+# include "header/jobserver.h"
+# include "header/dbcache.h"
+# include "header/metrics.h"
+# include "header/trace.h"
+# include "header/readcache.h"
 }
 
 using namespace std;
 
-#define BUF_SIZE 	 1514
-#define DATA_SIZE 	 1498
-#define REAL_DB_DATA 1496
-#define CTR_BUF_SIZE 60
-#define MAXUNITS_V5  100
-#define MAXUNITS_V6  600
 #define LABEL		 200
+#define UNIT_NUCS	 64			/* bases of one search unit */
+#define MAX_PIECES	 4			/* units of a longer read per strand */
+#define MAX_NUCS	 (UNIT_NUCS * MAX_PIECES)	/* bases of a read, the rest is cut */
+#define PIECES(len)	 (((len) > UNIT_NUCS) ? ((len) + UNIT_NUCS - 1) / UNIT_NUCS : 1)
+#define PIECE_REVERSE	 0x80		/* the unit searches the reverse complement */
+#define SEQUENCE	 (2 * (MAX_NUCS + 1))	/* bases and qualities of a read */
+#define MAX_THRESHOLD	 7			/* mismatches of a unit, 3 bit */
+#define READS_PER_UNIT	 4			/* reads of a batch per unit, duplicates need no unit */
+#define NO_COPY		 0xFFFF		/* end of the list of duplicates */
+#define CACHED		 0xFFFE		/* original of a read that takes the hits of an earlier batch */
+#define MAXSEGMENT	 0x3FFFFFFF	/* bytes of a segment, positions of 32 bit in bases */
+#define MINSKIP		 (1 << 16)	/* bases of a run of N that is not streamed */
+#define RESULT_BLOCK	 (1 << 20)	/* bytes of a block of downloaded results */
+#define RESULT_BLOCKS	 16			/* blocks queued for the result writer */
 
+struct function_time {
+	double send;
+	double create;
+	double rcv;
+	double search;
+	double save;
+	double txBandwidth;
+	double rxBandwidth;
+	double streams;
+	double pause;				/* stream paused for overflows */
+	double all;
+};
+
+/* downloaded result words with the segment they belong to */
+struct resultblock_t {
+	char *data;
+	unsigned int length;
+	int first;					/* first block of a download */
+	unsigned int seqfirst, seqlast;
+	unsigned long dbmapposition;
+};
+
+/* Read file, output files and counters of one query. The reads of several
+ * jobs of the daemon share the batches, each read points to its query. */
+struct output_t {
+	char *readname;
+	char *name, *mapname, *unmapname;
+	unsigned int mismatch;		/* reads without their own threshold */
+	unsigned int sam, bam, quality, map;
+	struct seqfile_t *readfile;
+	FILE *resultfile, *mapfile, *unmapfile;
+	struct bamfile_t *bamfile;
+	struct bambuffer_t records[MAXBOARDS];	/* records of each board for the BAM file */
+	struct textbuffer_t text[MAXBOARDS];	/* lines of each board for the PAM or SAM file */
+	double positions, mapped, reads, duplicates;
+	unsigned long encoded;		/* reads of the file, set at its end */
+	unsigned long written;		/* reads with their results written */
+	int complete;				/* all reads are encoded */
+	int error;					/* the read file is damaged */
+	struct job_t job;			/* job of the daemon, id 0 for the command line */
+	struct output_t *next;
+};
+
+/* Connection, buffers and search state of one board */
+struct board_t {
+	unsigned int number;
+	struct device_t dev;
+	pthread_t thread;
+
+	/* Buffer */
+	char *send_buffer, *rec_buffer;
+	char *readmap, *results, *indexlabel;
+	char *sequence;				/* SEQUENCE bytes per read */
+	struct output_t **readout;	/* query of each read */
+	uint8_t *labellength;		/* characters of each label */
+	int8_t *readbestmatch;
+	int8_t *readbestmismatch;
+	uint32_t *readposcount;
+	unsigned int reads, maxunits;	/* units of the batch and of the board */
+	unsigned int readcount;		/* reads of the batch */
+	unsigned int readslots;		/* reads a batch can hold, with duplicates */
+	uint16_t *original;			/* read whose units search each read */
+	uint16_t *nextcopy;			/* next read with the same sequence, NO_COPY */
+	uint32_t *copytable;		/* hash table of the reads loaded into units */
+	unsigned int copymask;
+	struct cachedread_t **cached;	/* entry of each read in the run-wide cache or NULL */
+	struct cachedhit_t *hitlog;	/* hits of the cached reads of the batch */
+	unsigned int hitcount, hitsize;
+	uint16_t *unitread;			/* read of each unit */
+	uint8_t *unitpiece;			/* piece of the read in each unit, PIECE_REVERSE */
+	uint8_t *threshold;			/* mismatches of each unit */
+
+	/* Segment */
+	unsigned int first, last;	/* sequences searched by this board */
+	unsigned int seqfirst, seqlast;	/* sequences of the current segment */
+	double seqchars;
+	unsigned int packets;
+	unsigned long dbmapposition;
+	uint64_t prefetch;			/* end of the database read ahead of the stream */
+	uint16_t *readlength;		/* bases of each read for hits across sequences */
+	uint8_t *readmismatch;		/* allowed mismatches of each read */
+
+	/* Stream and receiver thread, created once per run */
+	pthread_t streamer, receiver;
+	pthread_mutex_t next_mutex;	/* guards the control information */
+	pthread_cond_t next_signal;	/* stream: credit, overflow or end of search */
+	pthread_cond_t wait_signal;	/* receiver: overflow downloaded */
+	pthread_cond_t start_signal;	/* both: next segment */
+	pthread_cond_t end_signal;	/* board: both finished the segment */
+	unsigned int round;
+	unsigned int done;
+	int quit;
+
+	/* Control- and status information */
+	unsigned int id;
+	int stream_error;
+	int stream_end;
+	int send_next_stream;
+	int stream_wait;
+	uint16_t sendNext;
+	double overflows;
+
+	/* Result parser, entries may be split between frames */
+	unsigned int unit;			/* unit of the next entry */
+	unsigned int pending;		/* positions of the unit still to come */
+	unsigned int partial;		/* bytes of word received so far */
+	uint8_t word[4];
+	uint16_t count;				/* positions of the current entry */
+	uint8_t min;				/* least mismatches of the current entry */
+	unsigned int kept;			/* positions inside one sequence */
+	uint8_t best;				/* least mismatches of the verified hits of the entry */
+	const struct resultblock_t *decoding;	/* segment of the decoded block */
+
+	/* Result writer thread, decodes and writes the downloads behind the stream */
+	pthread_t writer;
+	pthread_mutex_t result_mutex;
+	pthread_cond_t queued_signal;	/* writer: block queued or end of run */
+	pthread_cond_t decoded_signal;	/* download: block decoded */
+	struct resultblock_t *resultblocks;	/* ring of RESULT_BLOCKS */
+	unsigned long resulthead, resulttail;	/* next block to decode, to fill */
+	int resultquit;
+
+	struct function_time time;
+};
 
 /* Functions */
-int sendingReads(int mismatch, int double_units);
-int sendingDB();
-int saveResults();
-int printResults();
+int initializingBoard(struct board_t *b, unsigned int number);
+int allocatingBoard(struct board_t *b, uint16_t units);
+int readingDBIndex();
+int readingDBInfo();
+int openBam(struct output_t *o);
+int runJob();
+int serveJobs();
+void printFaults();
+int searchReads(struct output_t *o);
+struct output_t *openOutput(const char *readname, const char *base, unsigned int mismatch, unsigned int flags);
+int closeOutput(struct output_t *o);
+void freeOutput(struct output_t *o);
+struct output_t *nextOutput(int wait);
+void finishOutput(struct output_t *o);
+int searchingSplitReads();
+int searchingSplitDB();
+int searchBatch(struct board_t *b);
+int searchSegment(struct board_t *b, unsigned int first, unsigned int last, uint64_t from, uint64_t to);
+uint64_t nextGap(unsigned int s, uint64_t base);
+int maskedHit(uint64_t start, unsigned int length);
+int startingThreads(struct board_t *b);
+void stoppingThreads(struct board_t *b);
+int nextSegment(struct board_t *b, unsigned int *round);
+void finishedSegment(struct board_t *b);
+int streamSegment(struct board_t *b);
+int receiveControls(struct board_t *b);
+void lostPacket(struct board_t *b, const char *frame);
+void finishBatch(struct board_t *b);
+void cacheBatch(struct board_t *b);
+int sendingReads(struct board_t *b);
+int loadingReadsCPU(struct board_t *b);
+int searchingCPU(struct board_t *b);
+int saveResults(struct board_t *b);
+int printResults(struct board_t *b);
+struct resultblock_t *fillingBlock(struct board_t *b, int first);
+void queueBlock(struct board_t *b);
+void appendResults(struct board_t *b, struct resultblock_t **block, const char *data, unsigned int length);
+void waitResults(struct board_t *b);
+void decodeBlock(struct board_t *b, const struct resultblock_t *block);
+void decodeResults(struct board_t *b, const char *data, unsigned int length);
+int writePosition(struct board_t *b, uint32_t position);
+int writeHit(struct board_t *b, unsigned int r, unsigned int s, unsigned long offset, int reverse);
+void logHit(struct board_t *b, unsigned int r, unsigned int s, uint64_t offset, int reverse);
+int verifyHit(struct board_t *b, unsigned int r, unsigned int piece, int reverse, uint64_t offset, unsigned int s);
+void finishEntry(struct board_t *b);
 int readingOptions(int argc, char** argv);
-int transformread();
+int transformread(struct output_t *o, char *label, char *map, uint16_t *length, uint8_t *mismatch, char *sequence, uint64_t *hash);
+void reverseComplement(const char *seq, unsigned int len, char *rev);
+int takeReads(struct board_t *b);
+int fillBatch(struct board_t *b);
+void encodeRead(const char *seq, unsigned int len, char *block);
 int readConfiguration();
-int overflow_response();
+int overflow_response(struct board_t *b);
+unsigned int sendingFrames(struct board_t *b, struct frame_t *frames, unsigned int burst);
 
 void print_help();
 
 /* Threads */
-void *rcvError(void *threadid);
-void *stream(void *threadid);
-
-/* send next*/
-pthread_mutex_t next_mutex;
-pthread_cond_t next_signal;
-
-int sleeping = 0;
-
-/* wait */
-pthread_mutex_t wait_mutex;
-pthread_cond_t wait_signal;
-
-/* wait */
-pthread_mutex_t end_mutex;
-pthread_cond_t end_signal;
+void *rcvError(void *board);
+void *writeResults(void *board);
+void *stream(void *board);
+void *searchBoard(void *board);
+void *searchRange(void *board);
+void *encodeReads(void *arg);
+
+pthread_attr_t attr;
+
+/* map and unmap files and the counts of the outputs, shared by the boards */
+pthread_mutex_t output_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Ring of reads encoded ahead of the boards, one slot per read */
+struct readqueue_t {
+	char *readmap;				/* strands * MAX_PIECES * 132 bytes per slot */
+	char *indexlabel;			/* LABEL bytes per slot */
+	uint16_t *readlength;		/* bases per slot */
+	uint8_t *readmismatch;		/* allowed mismatches per slot */
+	char *sequence;				/* SEQUENCE bytes per slot */
+	uint64_t *readhash;			/* hash of the encoded read per slot */
+	struct output_t **readout;	/* query per slot */
+	unsigned int size;
+	unsigned int head;
+	unsigned int count;
+	int finished;				/* end of the read file, of the daemon */
+	int drained;				/* no reads until the next job, batches are taken partly filled */
+	double encode;				/* time of the encoding thread */
+	pthread_mutex_t mutex;
+	pthread_cond_t filled;
+	pthread_cond_t emptied;
+} readqueue;
+
+/* Boards */
+struct board_t boards[MAXBOARDS];
+unsigned int boardcount = 0;
 
 /* Files */
-FILE *infodb, *readfile, *resultfile, *mapfile, *unmapfile;
+struct jobserver_t *jobserver;		/* job socket of the daemon */
 int bindb;
-char *dbmap, *readmap, *results, *indexlabel;
-unsigned int reads, maxunits;
-
-/* Buffer*/
-char* send_buffer;
-char* rec_buffer;
-char*line;
-
-int8_t* readbestmatch;
-int8_t* readbestmismatch;
-uint16_t* readposcount;
-
-/* Control- and status information */
-unsigned int packets;
-unsigned int id = 1;
-int stream_error = 0;
-int stream_end = 0;
-int send_next_stream = 0;
-int stream_wait = 0;
-uint16_t sendNext;
-
+struct dbcache_t dbcache;
+char *dbmap;
+unsigned int strands = 1;
+
+/* Database */
+const struct dbindex_t *dbindex;	/* mapped index, or image of an old info file */
+const struct dbentry_t *seqtable;
+const struct dbgap_t *gaptable;		/* runs of N */
+const char *seqnames;
+char *samhead;						/* "\t0 \t<name> \t0 \t" of SAM for each sequence and strand */
+uint64_t *samheadstart;				/* offset of each of them in samhead, one more at the end */
+uint64_t indexsize = 0;
+unsigned int sequences = 0;
+uint64_t gapcount = 0;
+double dbchars = 0;
+
+/* Status information */
 double positions = 0;
 double mapped = 0;
-double seqchars = 0;
 double maxreads = 0;
+double duplicates = 0;
 double overflows = 0;
-unsigned int dbmapposition = 0;
-
-enum CONTROL {
-	ctr_first_data 			= 0x10,	/* First Data Packet */
-	ctr_data 				= 0x11,	/* Normal Data Packet */
-	ctr_last_data 			= 0x12,	/* Last Data Packet */
-
-	ctr_send_next 			= 0x13,	/* FPGA -> Host: send next Data Packet */
-	ctr_send_DB 			= 0x14,	/* FPGA -> Host: send DB */
-	ctr_get_data 			= 0x15,	/* Host -> FPGA: send Data */
-	ctr_finished_search 	= 0x16, /* FPGA -> HOST: last DB character */
-	ctr_finished_sending 	= 0x17, /* FPGA -> HOST: finished sending of results */
-	ctr_next_segment		= 0x18, /* Host -> FPGA: begin iteration for next segment of reads */
-	ctr_finished_iteration	= 0x19, /* HOST -> FPGA: finished work -> next state waiting */
-
-	ctr_getid 				= 0x20,	/* Host -> FPGA: get ID */
-	info_v5 				= 0x21,	/* FPGA -> Host: ID = Vertex-5 */
-	info_v6 				= 0x22,	/* FPGA -> Host: ID = Vertex-6 */
-	error					= 0x24, /* FPGA -> Host: packet lost */
-	ctr_reset				= 0x19, /* Host -> FPGA: reset */
-
-	ctr_overflow			= 0x30, /* FPGA -> Host: overflow */
-	ctr_overflow_ready		= 0x31  /* Host -> FPGA: continue searching */
-} ctr;
+double drops = 0;
+double batches = 0;
+double loadedunits = 0;				/* units of the batches with reads */
+double batchunits = 0;				/* units of the boards of the batches */
+struct faultcount_t faults;			/* page faults and dTLB misses of the search */
 
 /* Initialization vectors for the CFGLUT5 primitives used for the
  * sequence aligner. After configuration, the LUT will generate:
@@ -200,11 +385,10 @@ uint32_t const  LUT5_CFG[5][5] = {
 struct globalArgs_t {
 	char *databasename;			/* FASTA database */
 	char *bindbname;			/* binary database */
-	char *infodbname;			/* infofile for database */
+	char *infodbname;			/* old infofile for database */
+	char *indexname;			/* binary index for database */
 	char *readname;				/* query */
 	char *output;				/* -o option */
-	char *unmapoutput;			/* -o option */
-	char *mapoutput;			/* -o option */
 
 	unsigned int mismatch;		/* -m option */
 	unsigned int transform_only;/* -t option */
@@ -214,19 +398,23 @@ struct globalArgs_t {
 	unsigned int map;			/* -u option */
 	unsigned int fpga;			/* Virtex 5 or 6*/
 	unsigned int positions;		/* -p option */
+	unsigned int cpu;			/* -c option */
+	unsigned int threads;		/* -c option */
+	unsigned int reverse;		/* -r option */
+	unsigned int splitdb;		/* -x option */
+	unsigned int tx;			/* -T option */
+	unsigned int whole;			/* -w option */
+	unsigned int quality;		/* -Q option */
+	unsigned int bam;			/* -B option */
+	char *socketname;			/* -D option */
+	unsigned int pin;			/* -P option */
+	char *metricsname;			/* -M option */
+	char *metricsaddress;		/* -L option */
+	char *tracename;			/* -R option */
 } global_opt;
 
-struct function_time {
-	double send;
-	double create;
-	double rcv;
-	double search;
-	double save;
-	double txBandwidth;
-	double rxBandwidth;
-	double streams;
-	double all;
-} func_time;
+struct function_time func_time;
+
 
 static struct option main_lopts[] = {
 	{ "query",		required_argument, NULL, 'q' },
@@ -239,10 +427,22 @@ static struct option main_lopts[] = {
 	{ "map",		no_argument		 , NULL, 'u' },
 	{ "status",		no_argument		 , NULL, 'i' },
 	{ "positions",	no_argument		 , NULL, 'p' },
+	{ "cpu",		required_argument, NULL, 'c' },
+	{ "reverse",	no_argument		 , NULL, 'r' },
+	{ "splitdb",	no_argument		 , NULL, 'x' },
+	{ "tx",			required_argument, NULL, 'T' },
+	{ "whole",		no_argument		 , NULL, 'w' },
+	{ "quality",	no_argument		 , NULL, 'Q' },
+	{ "bam",		no_argument		 , NULL, 'B' },
+	{ "daemon",		required_argument, NULL, 'D' },
+	{ "pin",		no_argument		 , NULL, 'P' },
+	{ "metrics",	required_argument, NULL, 'M' },
+	{ "metrics-listen",	required_argument, NULL, 'L' },
+	{ "trace",		required_argument, NULL, 'R' },
 	{ 0, 0, 0, 0 }
 };
 
-static char main_sopts[] = "q:d:b:tm:o:suip";
+static char main_sopts[] = "q:d:b:tm:o:suipc:rxT:wQBD:PM:L:R:";
 
 
 /********************************************************************************
@@ -260,60 +460,53 @@ static char main_sopts[] = "q:d:b:tm:o:suip";
  * --bindb		-b <filename>	database input files in binary fasta format
  * --transform	-t				only transforms the database from fasta to
  * 								binary fasta (default: no)
- * --mismatch	-m [int]		maximum number of mismatches per read (default: 0)
+ * --mismatch	-m [int]		maximum number of mismatches of reads without a
+ * 								"/n" behind their bases (default: 0)
  * --output		-o <filename>	output file
  * --status		-o 				print status information and performance data
  * 								(default: no)
+ * --cpu		-c [int]		search on the host CPU with n threads instead
+ * 								of the FPGA (0: all cores)
+ * --reverse	-r				search the reverse complement of each read in
+ * 								the same pass (default: no)
+ * --splitdb	-x				split the database instead of the reads between
+ * 								the boards of mac.config (default: no)
+ * --tx		-T <path>		transmit path of the database: copy, mmsg or
+ * 								ring (default: mmsg)
+ * --whole		-w				stream all sequences as one text and map the hits
+ * 								back to the sequences (default: one per segment)
+ * --quality	-Q				write the bases and qualities of the reads into
+ * 								the SAM or BAM output (default: no)
+ * --bam		-B				write the output in BAM format (default: no)
+ * --daemon		-D <socket>		keep the boards and the database and take the
+ * 								jobs of fpga-client on a UNIX domain socket
+ * --pin		-P				copy the database into locked 2 MB pages instead
+ * 								of mapping the file (default: no)
+ * --metrics	-M <filename>	write the counters and histograms of the run
+ * 								as JSON
+ * --metrics-listen -L <address>	serve the metrics in the Prometheus text
+ * 								format on [host:]port or a UNIX socket path
+ * --trace		-R <filename>	record the frames of the boards and write them
+ * 								as pcapng with a summary of the flow-control
  * --help		-h				print this usage message
  ********************************************************************************/
  int main(int argc, char** argv) {
 
-	char ctr, *ptr;
-	double dbchars, sequences;
 	double time0, time1, latency;
 	struct stat sb;
+	struct device_t devices[MAXBOARDS];
 	uint16_t device_units;
-	unsigned int i = 0, j = 0;
-
-	func_time.all = 0;
-	func_time.create = 0;
-	func_time.rcv = 0;
-	func_time.save = 0;
-	func_time.search = 0;
-	func_time.send = 0;
-	func_time.rxBandwidth = 0;
-	func_time.txBandwidth = 0;
-	func_time.streams = 0;
+	unsigned int i = 0, n = 0;
+	int rc;
 
 	/*------------------------------------------------------
 		 				prepare threads
 	 ------------------------------------------------------*/
-	void *status;
-	pthread_t thread[2];
-	pthread_attr_t attr;
-	int rc;
 
 	/* Initialize and set thread detached attribute */
 	pthread_attr_init(&attr);
 	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
 
-	/*------------------------------------------------------
-	 					allocating memory
-	 ------------------------------------------------------*/
-
-	send_buffer 	= (char*) malloc(BUF_SIZE * sizeof(char));
-	rec_buffer 		= (char*) malloc(BUF_SIZE * sizeof(char));
-	line 			= (char*) malloc(LABEL * sizeof(char));
-	readbestmatch	= (int8_t*) malloc(MAXUNITS_V6 * sizeof(int8_t));
-	readbestmismatch= (int8_t*) malloc(MAXUNITS_V6 * sizeof(int8_t));
-	readposcount	= (uint16_t*) malloc(MAXUNITS_V6 * sizeof(uint16_t));
-
-	for(j = 0; j < MAXUNITS_V6; j++){
-		readbestmatch[j] 	= 8;
-		readbestmismatch[j] = 8;
-		readposcount[j] 	= 0;
-	}
-
  	/*------------------------------------------------------
  						reading options
  	------------------------------------------------------*/
@@ -322,11 +515,17 @@ static char main_sopts[] = "q:d:b:tm:o:suip";
 		return -1;
 	}
 
+	/* both strands: a read takes contiguous units, its forward pieces and then
+	 * the pieces of its reverse complement (PIECE_REVERSE in unitpiece) */
+	if (global_opt.reverse == 1) {
+		strands = 2;
+	}
+
 	/*------------------------------------------------------
 						 transform db
 	------------------------------------------------------*/
 	if (global_opt.transform == 1) {
-		if(transformdb(global_opt.databasename, global_opt.bindbname, global_opt.infodbname) == -1){
+		if(transformdb(global_opt.databasename, global_opt.bindbname, global_opt.indexname) == -1){
 			return -1;
 		}
 	}
@@ -338,28 +537,65 @@ static char main_sopts[] = "q:d:b:tm:o:suip";
 	/*------------------------------------------------------
 				open connection and searching device
 	------------------------------------------------------*/
-	cout << "--- open connection ---" << endl;
+	if (global_opt.cpu == 1) {
+		cout << "--- CPU search ---" << endl;
+
+		if (cpuInit(global_opt.threads) == -1) {
+			return -1;
+		}
+		printf("%s search with up to %u threads\n", cpuKernel(), global_opt.threads ? global_opt.threads : (unsigned int) sysconf(_SC_NPROCESSORS_ONLN));
+
+		boardcount = 1;
+		if (initializingBoard(&boards[0], 0) == -1 || allocatingBoard(&boards[0], MAXUNITS_V6) == -1) {
+			return -1;
+		}
+	} else {
+		cout << "--- open connection ---" << endl;
 
-	initializeEthernetConnection(send_buffer);
-	sendControl(ctr_reset, send_buffer, id);
+		if ((global_opt.tracename != NULL) && (traceStart(TRACE_RECORDS) == -1)) {
+			return -1;
+		}
 
+		boardcount = readDeviceConfiguration(devices, MAXBOARDS);
 
-	time0 = gettime(0);
-	device_units = searchDevice(send_buffer, rec_buffer, id);
-	time1 = gettime(time0);
-	latency = (time1 / 2 ) * 1000000; /* µ seconds */
-	printf("Latency: %8.2f µ seconds\n\n", latency);
-	id++;
+		for (n = 0; n < boardcount; n++) {
+			struct board_t *b = &boards[n];
 
-	if (device_units == 0){
-		return -1;
-	} else {
-		maxunits = device_units;
-	}
+			if (initializingBoard(b, n) == -1) {
+				return -1;
+			}
+			b->dev = devices[n];
+			traceDevice(&b->dev, n);
+
+			initializeEthernetConnection(&b->dev, b->send_buffer);
+
+			b->dev.tx = global_opt.tx;
+			if ((b->dev.tx == TX_RING) && (initializeTxRing(&b->dev) == -1)) {
+				fprintf(stderr, "Warning: no TX ring on board %u, using sendmmsg\n", n);
+				b->dev.tx = TX_MMSG;
+			}
+			if ((initializeRxRing(&b->dev) == -1) && (b->dev.devsocket[0] == 0)) {
+				fprintf(stderr, "Warning: no RX ring on board %u, using recvfrom\n", n);
+			}
+			sendControl(&b->dev, ctr_reset, b->send_buffer, b->id);
+
+			printf("board %u (%s): ", n, b->dev.devsocket[0] ? b->dev.devsocket : b->dev.ifname);
 
-	results		= (char*) malloc(maxunits * 4000 * 4 * sizeof(char));	// 1,024 results max
-	readmap 	= (char*) malloc(maxunits * 32 * 32 * sizeof(char));
-	indexlabel	= (char*) malloc(maxunits * LABEL * sizeof(char));		// 200 character label per read
+			time0 = gettime(0);
+			device_units = searchDevice(&b->dev, b->send_buffer, b->rec_buffer, b->id);
+			time1 = gettime(time0);
+			latency = (time1 / 2 ) * 1000000; /* µ seconds */
+			printf("Latency: %8.2f µ seconds\n\n", latency);
+			b->id++;
+
+			if (device_units == 0){
+				return -1;
+			}
+			if (allocatingBoard(b, device_units) == -1) {
+				return -1;
+			}
+		}
+	}
 
 	/*------------------------------------------------------
 			opening files and reading information
@@ -367,17 +603,10 @@ static char main_sopts[] = "q:d:b:tm:o:suip";
 
 	cout << endl << "--- opening files and getting information ---" << endl;
 
-	infodb = fopen(global_opt.infodbname, "rb");
-	if (infodb == NULL) {
-		fprintf(stderr, "\nError: can not open File %s\n", global_opt.infodbname);
+	if (readingDBIndex() == -1) {
 		return -1;
 	}
 
-	/* reading from info-File and calculating number of Packets */
-	fgets(line, 20, infodb);
-	sscanf(line, "# %lf\n", &sequences);
-	printf("sequences: %.0f\n", sequences);
-
 	bindb = open64(global_opt.bindbname, O_RDONLY);
 	if (bindb == -1) {
 		fprintf(stderr, "\nError: can not open File %s\n", global_opt.bindbname);
@@ -389,452 +618,1741 @@ static char main_sopts[] = "q:d:b:tm:o:suip";
 		return -1;
 	}
 
-	dbmap = (char*) mmap(0, sb.st_size, PROT_READ, MAP_SHARED, bindb, 0);
-	if(dbmap == MAP_FAILED) {
-		fprintf(stderr, "\nError: mapping db\n");
+	if ((uint64_t) sb.st_size != dbindex->bytes) {
+		fprintf(stderr, "\nError: %s has %llu bytes, %s expects %llu; transform the database again\n",
+				global_opt.bindbname, (unsigned long long) sb.st_size,
+				global_opt.indexname, (unsigned long long) dbindex->bytes);
 		return -1;
 	}
 
-	close(bindb);
-
-	/* files for results */
-	resultfile = fopen(global_opt.output, "wb");
-	if (resultfile == NULL) {
-		fprintf(stderr, "\nError: can not create File %s\n", global_opt.output);
+	if (dbLoad(&dbcache, bindb, sb.st_size, global_opt.pin) == -1) {
 		return -1;
 	}
+	dbmap = dbcache.data;
+
+	close(bindb);
 
-	fprintf(resultfile, "@HD VN:1.3 SO:unsorted\n");
+	if (dbcache.pinned) {
+		printf("database in %s, %s\n", (dbcache.hugepages == 2) ? "2 MB pages" :
+				(dbcache.hugepages == 1) ? "transparent huge pages" : "base pages",
+				dbcache.locked ? "locked" : "not locked");
+	}
 
-	if(global_opt.map == 1){
-		mapfile = fopen(global_opt.mapoutput, "wb");
-		if (mapfile == NULL) {
-			fprintf(stderr, "\nError: can not create File %s\n", global_opt.mapoutput);
-			return -1;
-		}
+	/* a binary database of another transformation has the same size only by chance */
+	if ((dbindex->version != 0) && (dbChecksum(dbmap, sb.st_size) != dbindex->checksum)) {
+		fprintf(stderr, "\nError: checksum of %s does not match %s; transform the database again\n",
+				global_opt.bindbname, global_opt.indexname);
+		return -1;
+	}
 
-		unmapfile = fopen(global_opt.unmapoutput, "wb");
-		if (unmapfile == NULL) {
-			fprintf(stderr, "\nError: can not create File %s\n", global_opt.unmapoutput);
-			return -1;
+	/* the hits of SAM bypass stdio, the fields before the position depend only
+	 * on the sequence and the strand and are formatted once */
+	samheadstart = (uint64_t*) malloc((2 * sequences + 1) * sizeof(uint64_t));
+	samhead = NULL;
+	if (samheadstart != NULL) {
+		uint64_t  offset = 0;
+		for(i = 0; i < sequences; i++){
+			samheadstart[2 * i] = offset;
+			offset = offset + strlen(seqnames + seqtable[i].name) + 9;
+			samheadstart[2 * i + 1] = offset;
+			offset = offset + strlen(seqnames + seqtable[i].name) + 10;
 		}
+		samheadstart[2 * sequences] = offset;
+		samhead = (char*) malloc(offset + 1);
+	}
+	if (samhead == NULL) {
+		fprintf(stderr, "\nError: allocating the names of the sequences for SAM\n");
+		return -1;
+	}
+	for(i = 0; i < sequences; i++){
+		const char * const  name = seqnames + seqtable[i].name;
+		unsigned const  length = samheadstart[2 * i + 1] - samheadstart[2 * i] - 9;
+		char  *p = samhead + samheadstart[2 * i];
+
+		p = textCopy(p, "\t0 \t", 4);
+		p = textCopy(p, name, length);
+		p = textCopy(p, " \t0 \t", 5);
+		p = textCopy(p, "\t16 \t", 5);
+		p = textCopy(p, name, length);
+		textCopy(p, " \t0 \t", 5);
+	}
 
-		fprintf(mapfile, "# readname \t number of mapping positions \t minimal number of mismatches\n");
-		fprintf(unmapfile, "# readname \t necessary mismatches\n");
+	/* two batches per board, the next batch is ready when a board finishes */
+	for (n = 0; n < boardcount; n++) {
+		readqueue.size = readqueue.size + 2 * boards[n].readslots;
 	}
+	readqueue.readmap = (char*) malloc(readqueue.size * strands * MAX_PIECES * 132 * sizeof(char));
+	readqueue.indexlabel = (char*) malloc(readqueue.size * LABEL * sizeof(char));
+	readqueue.readlength = (uint16_t*) malloc(readqueue.size * sizeof(uint16_t));
+	readqueue.readmismatch = (uint8_t*) malloc(readqueue.size * sizeof(uint8_t));
+	readqueue.sequence = (char*) malloc(readqueue.size * SEQUENCE * sizeof(char));
+	readqueue.readhash = (uint64_t*) malloc(readqueue.size * sizeof(uint64_t));
+	readqueue.readout = (struct output_t**) malloc(readqueue.size * sizeof(struct output_t*));
+	if ((readqueue.readmap == NULL) || (readqueue.indexlabel == NULL) || (readqueue.readlength == NULL) ||
+		(readqueue.readmismatch == NULL) || (readqueue.sequence == NULL) || (readqueue.readhash == NULL) ||
+		(readqueue.readout == NULL)) {
+		fprintf(stderr, "\nError: allocating read queue\n");
+		return -1;
+	}
+	pthread_mutex_init(&readqueue.mutex, NULL);
+	pthread_cond_init(&readqueue.filled, NULL);
+	pthread_cond_init(&readqueue.emptied, NULL);
 
 	/*------------------------------------------------------
-					read transformation
+				search the reads of one or more jobs
 	------------------------------------------------------*/
 
-	readfile = fopen(global_opt.readname, "rb");
-	if (readfile == NULL) {
-		fprintf(stderr, "\nError: can not open File %s\n", global_opt.readname);
+	if ((global_opt.metricsaddress != NULL) && (metricsServe(global_opt.metricsaddress) == -1)) {
 		return -1;
 	}
 
-	reads = transformread();
-	maxreads = reads;
-
-	cout << endl << "--- transfer data ---" << endl << endl;
-
-	fgets(line, 20, infodb);
-	sscanf(line, "# %lf\n", &dbchars);
-	printf("characters: %.0f\n", dbchars);
-	fgets(line, 20, infodb);//empty
-
-
-	while(reads != 0) {
-
-		/*------------------------------------------------------
-									transfer reads
-		------------------------------------------------------*/
-		sendingReads(global_opt.mismatch, 0);
-
-		for(i = 0; i < sequences; i++){
-
-			fgets(line, 20, infodb);//position
-
-			fgets(line, LABEL, infodb);//name
-			ptr = strchr(line, '\n');
-			if (ptr != NULL) {
-				*ptr = ' ';
-			}
-
-			fscanf(infodb, "# %lf\n", &seqchars);//characters
-			fprintf(resultfile, "@SQ SN:%s LN:%.0f\n", line, seqchars*4);
-
-			packets = seqchars / REAL_DB_DATA;
-
-			/*------------------------------------------------------
-							transfer database
-			------------------------------------------------------*/
-			ctr = receive(CTR_BUF_SIZE, rec_buffer);
-			while(ctr != ctr_send_DB){
-				ctr = receive(CTR_BUF_SIZE, rec_buffer);
-			}
-
-			memcpy(&sendNext, rec_buffer+1, 2);//number of Bytes in FPGA-Text-FIFO
-
-
-			rc = pthread_create(&thread[0], &attr, rcvError, (void *) 0);
-			if (rc){
-				printf("ERROR; return code from pthread_create() is %d\n", rc);
-			}
-
-			rc = pthread_create(&thread[1], &attr, stream, (void *) 0);
-			if (rc){
-				printf("ERROR; return code from pthread_create() is %d\n", rc);
-			}
-
-
-			rc = pthread_join(thread[0], &status);
-			rc = pthread_join(thread[1], &status);
-
-			/*------------------------------------------------------
-							load results
-			------------------------------------------------------*/
-
-			if (saveResults() == -1){
-				fprintf(stderr, "\nError: saving results\n");
-				return -1;
-			}
-			//cout << "saved" << endl;
-
-			if (printResults() == -1){
-				fprintf(stderr, "\nError: printing results\n");
-				return -1;
-			}
-
-			//cout << "printed" << endl;
-
-			if (i != (sequences-1)) {
-				sendControl(ctr_next_segment, send_buffer, id);
-				id++;
-			}
+	if (global_opt.socketname != NULL) {
+		rc = serveJobs();
+	} else {
+		rc = runJob();
+	}
 
-			dbmapposition = dbmapposition + (unsigned int) seqchars;
-		}
+	if ((global_opt.metricsname != NULL) && (rc != -2) && (metricsJson(global_opt.metricsname) == -1)) {
+		rc = -1;
+	}
+	metricsStop();
 
-		dbmapposition = 0;
+	/* also after a failed search, the trace shows where it stopped */
+	if ((global_opt.tracename != NULL) && (traceWrite(global_opt.tracename) == -1)) {
+		rc = -1;
+	}
+	traceStop();
 
-		//calculating mapped reads and print list of mapped and unmapped
-		for(j = 0; j < reads; j++){
-			if (readbestmatch[j] < (int8_t) 8) {
-				mapped = mapped + 1;
-				if(global_opt.map == 1){
-					fprintf(mapfile, "%s", indexlabel + (j * LABEL));
-					fprintf(mapfile, " %u %u\n", readposcount[j], readbestmatch[j]);
-				}
-			} else {
-				if(global_opt.map == 1){
-					fprintf(unmapfile, "%s", indexlabel + (j * LABEL));
-					fprintf(unmapfile, " %u\n", readbestmismatch[j]);
-				}
-			}
-			readbestmatch[j] = 8;
-			readbestmismatch[j] = 8;
-			readposcount[j] = 0;
-		}
+	/*------------------------------------------------------
+						cleaning up
+	------------------------------------------------------*/
 
-		if (reads < maxunits) {
-			reads = 0;
-		} else {
-			reads = transformread();
+	free(samhead);
+	free(samheadstart);
+	for (n = 0; n < boardcount; n++) {
+		struct board_t *b = &boards[n];
+
+		free(b->send_buffer);
+		free(b->rec_buffer);
+		free(b->results);
+		free(b->readmap);
+		free(b->indexlabel);
+		free(b->readbestmatch);
+		free(b->readbestmismatch);
+		free(b->readposcount);
+		free(b->readlength);
+		free(b->readmismatch);
+		free(b->sequence);
+		free(b->readout);
+		free(b->labellength);
+		free(b->original);
+		free(b->nextcopy);
+		free(b->copytable);
+		free(b->cached);
+		free(b->hitlog);
+		free(b->unitread);
+		free(b->unitpiece);
+		free(b->threshold);
+	}
+	if (dbindex->version == 0) {
+		free((void*) dbindex);
+	} else {
+		munmap((void*) dbindex, indexsize);
+	}
+	free(readqueue.readmap);
+	free(readqueue.indexlabel);
+	free(readqueue.readlength);
+	free(readqueue.readmismatch);
+	free(readqueue.sequence);
+	free(readqueue.readhash);
+	free(readqueue.readout);
+	cacheFree();
+	dbFree(&dbcache);
+
+	if (global_opt.cpu == 1) {
+		cpuFree();
+	}
 
-		}
+	return (rc == 0) ? 0 : -1;
+}
 
-		maxreads = maxreads + reads;
+/******************************************************************************
+ * Searches the reads of the query file of the command line and writes its
+ * output files. Returns 0, -1 if a file fails and -2 if the search failed,
+ * the boards can not take another run then.
+ ******************************************************************************/
+int runJob() {
+	struct output_t *o;
+	unsigned int flags;
+	int rc;
 
-		sendControl(ctr_finished_iteration, send_buffer, id);
-		id = 1;
-		sleep(0.5);
+	flags = (global_opt.sam ? JOB_SAM : 0) | (global_opt.bam ? JOB_BAM : 0) |
+			(global_opt.quality ? JOB_QUALITY : 0) | (global_opt.map ? JOB_MAP : 0);
+	o = openOutput(global_opt.readname, global_opt.output, global_opt.mismatch, flags);
+	if (o == NULL) {
+		return -1;
 	}
 
-
-	/*------------------------------------------------------------------------------------------------------------*/
+	if (searchReads(o) == -1) {
+		return -2;
+	}
+	if (o->error) {
+		fprintf(stderr, "\nError: reading %s, the reads behind the error are missing\n", o->readname);
+		closeOutput(o);
+		freeOutput(o);
+		return -1;
+	}
 
 	cout << endl << "--- finished search ---" << endl;
 
-	cout << "created files: " << global_opt.output << ", " << global_opt.mapoutput << " and " << global_opt.unmapoutput << endl;
+	cout << "created files: " << o->name << ", " << o->mapname << " and " << o->unmapname << endl;
 
 	cout << "found " << positions << " positions in " << sequences << " sequences" << endl;
 	cout << "mapped " << mapped << " (" << (100 / maxreads) * mapped << " %) of " << maxreads << " reads" << endl;
+	cout << "duplicate reads: " << duplicates << " (hits of their first copy, not searched again)" << endl;
+	cout << "unit fill: " << (100 / batchunits) * loadedunits << " % in " << batches << " batches" << endl;
 	cout << "overflows: " << overflows << endl;
+	if (global_opt.cpu == 0) {
+		cout << "dropped frames: " << drops << endl;
+	}
 
 
 	if (global_opt.status == 1){
 		cout << endl << "--- statistics ---" << endl;
 
 		func_time.all = func_time.create + func_time.rcv + func_time.save + func_time.search + func_time.send;
-		cout << "creating reads: " 		<< "\t" 	<< (100 / func_time.all) * func_time.create << endl;
+		cout << "waiting for reads: " 	<< "\t" 	<< (100 / func_time.all) * func_time.create << endl;
 		cout << "receive: " 			<< "\t\t" 	<< (100 / func_time.all) * func_time.rcv << endl;
 		cout << "save results: " 		<< "\t\t" 	<< (100 / func_time.all) * func_time.save << endl;
 		cout << "searching: " 			<< "\t\t" 	<< (100 / func_time.all) * func_time.search << endl;
 		cout << "sending reads: " 		<< "\t\t" 	<< (100 / func_time.all) * func_time.send << endl;
 		cout << "time: " 				<< "\t\t\t" << func_time.all << endl;
+		cout << "encoding reads:" 		<< "\t\t" 	<< readqueue.encode << " s (overlapped)" << endl;
 
-		cout << "average TX bandwidth:" << "\t" 	<< func_time.txBandwidth / func_time.streams  << " MBit/s" << endl;
-		cout << "average RX bandwidth:" << "\t" 	<< func_time.rxBandwidth / func_time.streams  << " MBit/s" << endl;
+		if (global_opt.cpu == 1) {
+			cout << "average search rate:" << "\t" 	<< func_time.txBandwidth / func_time.streams  << " MBases/s" << endl;
+		} else {
+			cout << "average TX bandwidth:" << "\t" 	<< func_time.txBandwidth / func_time.streams  << " MBit/s" << endl;
+			cout << "average RX bandwidth:" << "\t" 	<< func_time.rxBandwidth / func_time.streams  << " MBit/s" << endl;
+			if (overflows > 0) {
+				cout << "overflow pause:" << "\t\t" 	<< 1000 * func_time.pause / overflows << " ms per overflow" << endl;
+			}
+			cout << "formatting results:" << "\t" 	<< func_time.save << " s (overlapped)" << endl;
+		}
+		printFaults();
 	}
 
-	/*------------------------------------------------------
-						cleaning up
-	------------------------------------------------------*/
+	rc = closeOutput(o);
+	freeOutput(o);
 
-	fclose(readfile);
-	fclose(resultfile);
-	fclose(infodb);
+	return rc;
+}
+
+/******************************************************************************
+ * Daemon - the boards, the index and the mapped database stay for all jobs of
+ * the job socket. The encoder takes the next job as soon as the reads of the
+ * last one are encoded, so the reads of several jobs share the batches; every
+ * job is answered when its last read is written.
+ ******************************************************************************/
+int serveJobs() {
+	int rc;
 
-	if(global_opt.map == 1){
-		fclose(mapfile);
-		fclose(unmapfile);
+	jobserver = jobListen(global_opt.socketname);
+	if (jobserver == NULL) {
+		return -1;
 	}
 
-	free(send_buffer);
-	free(rec_buffer);
-	free(results);
-	free(readmap);
-	free(readbestmatch);
-	free(readbestmismatch);
-	free(readposcount);
-	munmap(dbmap, sb.st_size);
+	cout << endl << "--- waiting for jobs on " << global_opt.socketname << " ---" << endl;
 
-	return 0;
+	rc = searchReads(NULL);
+
+	jobClose(jobserver);
+	jobserver = NULL;
+
+	cout << endl << "--- stopped daemon ---" << endl;
+	cout << "mapped " << mapped << " of " << maxreads << " reads" << endl;
+	cout << "unit fill: " << (100 / batchunits) * loadedunits << " % in " << batches << " batches" << endl;
+	cout << "overflows: " << overflows << endl;
+	if (global_opt.status == 1) {
+		printFaults();
+	}
+
+	return rc;
 }
 
 /******************************************************************************
- * Database streaming Thread
+ * Page faults and dTLB misses of the last search, with the mode of the
+ * database memory
  ******************************************************************************/
-void *stream(void *threadid) {
+void printFaults() {
+	cout << "page faults:" << "\t\t" << faults.minor << " minor, " << faults.major << " major" << endl;
+	if (faults.tlb >= 0) {
+		cout << "dTLB misses:" << "\t\t" << faults.tlb << endl;
+	} else {
+		cout << "dTLB misses:" << "\t\t" << "n/a" << endl;
+	}
+	cout << "database:" << "\t\t" << (dbcache.pinned ? "pinned" : "mapped, read ahead") << endl;
+}
 
-	double fullsend0, fullsend1, bandwidth;
-	unsigned int i, j, p, fpgaPackets, packetsize, nextBytes;
+/******************************************************************************
+ * Searches the reads of o, the daemon the reads of its jobs, on all boards.
+ * Returns -1 if the search failed; a damaged read file ends the reads of its
+ * output with the error flag.
+ ******************************************************************************/
+int searchReads(struct output_t *o) {
+	pthread_t encoder;
+	unsigned int n;
+	int rc;
 
-	p = 0;
-	i = 0;
-	fullsend0 = gettime(0);
-	send_next_stream = 1;
+	/* counters of this run */
+	positions = 0;
+	mapped = 0;
+	maxreads = 0;
+	duplicates = 0;
+	overflows = 0;
+	drops = 0;
+	batches = 0;
+	loadedunits = 0;
+	batchunits = 0;
+	memset(&func_time, 0, sizeof(struct function_time));
+	for (n = 0; n < boardcount; n++) {
+		memset(&boards[n].time, 0, sizeof(struct function_time));
+		boards[n].overflows = 0;
+		if (global_opt.cpu == 0) {
+			droppedFrames(&boards[n].dev);
+			boards[n].dev.drops = 0;
+		}
+	}
+	readqueue.head = 0;
+	readqueue.count = 0;
+	readqueue.finished = 0;
+	readqueue.drained = 0;
+	readqueue.encode = 0;
+	metricsReset();
+	faultStart(&faults);
+
+	rc = pthread_create(&encoder, &attr, encodeReads, (void *) o);
+	if (rc){
+		printf("ERROR; return code from pthread_create() is %d\n", rc);
+		return -1;
+	}
 
-	double time0 = gettime(0);
+	cout << endl << "--- transfer data ---" << endl << endl;
 
-	//cout << "begin stream" << endl;
+	printf("characters: %.0f\n", dbchars);
 
-	while(p <= packets){
+	/*------------------------------------------------------
+						search on all boards
+	------------------------------------------------------*/
 
-		pthread_mutex_lock(&next_mutex);
-		if(send_next_stream == 1){
+	if (global_opt.cpu == 0) {
+		for (n = 0; n < boardcount; n++) {
+			if (startingThreads(&boards[n]) == -1) {
+				return -1;
+			}
+		}
+	}
 
-			send_next_stream = 0;
-			pthread_mutex_unlock(&next_mutex);
+	if (global_opt.splitdb == 1) {
+		rc = searchingSplitDB();
+	} else {
+		rc = searchingSplitReads();
+	}
+	if (rc == -1) {
+		return -1;
+	}
 
+	if (global_opt.cpu == 0) {
+		for (n = 0; n < boardcount; n++) {
+			stoppingThreads(&boards[n]);
+		}
+	}
 
-			nextBytes = (unsigned int) sendNext;
-			fpgaPackets = (nextBytes / REAL_DB_DATA)-4;//FFFF -> 43 Pakete
-			if (fpgaPackets > 43) {
-				fpgaPackets = 2;
-			} else if (fpgaPackets == 0) {
-				fpgaPackets = 0;
-			}
+	pthread_join(encoder, NULL);
+	faultStop(&faults);
+
+	for (n = 0; n < boardcount; n++) {
+		struct function_time *t = &boards[n].time;
+
+		func_time.create = func_time.create + t->create;
+		func_time.rcv = func_time.rcv + t->rcv;
+		func_time.save = func_time.save + t->save;
+		func_time.search = func_time.search + t->search;
+		func_time.send = func_time.send + t->send;
+		func_time.rxBandwidth = func_time.rxBandwidth + t->rxBandwidth;
+		func_time.txBandwidth = func_time.txBandwidth + t->txBandwidth;
+		func_time.streams = func_time.streams + t->streams;
+		func_time.pause = func_time.pause + t->pause;
+		overflows = overflows + boards[n].overflows;
+		if (global_opt.cpu == 0) {
+			drops = drops + droppedFrames(&boards[n].dev);
+		}
+	}
 
-			if(stream_wait == 1){
-				overflow_response();
-			}
+	return 0;
+}
 
-			//cout << "send " << fpgaPackets << " packets" << endl;
+/******************************************************************************
+ * Opens the read file and creates the output files of a query. The base name
+ * gets the suffix of the format, the map and the unmap file.
+ ******************************************************************************/
+struct output_t *openOutput(const char *readname, const char *base, unsigned int mismatch, unsigned int flags) {
+	struct output_t *o;
+	size_t length = strlen(base);
+	unsigned int i, n;
+
+	o = (struct output_t*) calloc(1, sizeof(struct output_t));
+	if (o == NULL) {
+		fprintf(stderr, "\nError: allocating the output of %s\n", readname);
+		return NULL;
+	}
+	o->mismatch = mismatch;
+	o->sam = (flags & JOB_SAM) ? 1 : 0;
+	o->bam = (flags & JOB_BAM) ? 1 : 0;
+	o->quality = (flags & JOB_QUALITY) ? 1 : 0;
+	o->map = (flags & JOB_MAP) ? 1 : 0;
+
+	/* bases and qualities are only written into SAM and BAM */
+	if ((o->sam == 0) && (o->bam == 0)) {
+		o->quality = 0;
+	}
 
-			for (j = 0; (j < fpgaPackets) && (p <= packets); j++) {
+	o->readname = strdup(readname);
+	o->name = (char*) malloc(length + strlen(".bam") + 1);
+	o->mapname = (char*) malloc(length + strlen(".map") + 1);
+	o->unmapname = (char*) malloc(length + strlen(".unmap") + 1);
+	if ((o->readname == NULL) || (o->name == NULL) || (o->mapname == NULL) || (o->unmapname == NULL)) {
+		fprintf(stderr, "\nError: allocating the output of %s\n", readname);
+		freeOutput(o);
+		return NULL;
+	}
 
-				//stops at the end of a sequence
-				if(p == packets) {
-					packetsize = seqchars - (REAL_DB_DATA * p);
-				} else {
-					packetsize = DATA_SIZE;
-				}
+	strcpy(o->name, base);
+	if(o->bam == 1){
+		strcat(o->name, ".bam");
+	} else if(o->sam == 0){
+		strcat(o->name, ".pam");
+	} else {
+		strcat(o->name, ".sam");
+	}
 
-				memcpy(send_buffer+17, dbmap + dbmapposition + (REAL_DB_DATA * p), packetsize);
-				p++;
+	strcpy(o->mapname, base);
+	strcat(o->mapname, ".map");
 
-				if (j == 0 and i == 0) {
-					sendData(packetsize, ctr_first_data, send_buffer, id);
-					id++;
-				} else if (p == packets + 1) {
-					sendData(packetsize, ctr_data, send_buffer, id);
-					id++;
-					break;
-				} else {
-					sendData(packetsize, ctr_data, send_buffer, id);
-					id++;
-				}
-				if (stream_error == 1) {
-					pthread_exit((void*) 1);
-				}
+	strcpy(o->unmapname, base);
+	strcat(o->unmapname, ".unmap");
 
-				if(stream_wait == 1){
-					overflow_response();
-				}
-			}
-			if (stream_error == 1) {
-				pthread_exit((void*) 1);
-			}
-			i++;
+	/* no output files for a missing query */
+	o->readfile = openSeqFile(o->readname);
+	if (o->readfile == NULL) {
+		fprintf(stderr, "\nError: can not open File %s\n", o->readname);
+		freeOutput(o);
+		return NULL;
+	}
 
-			if(stream_wait == 1){
-				overflow_response();
-			}
+	/* files for results */
+	if (o->bam == 1) {
+		if (openBam(o) == -1) {
+			closeOutput(o);
+			freeOutput(o);
+			return NULL;
+		}
+	} else {
+		o->resultfile = fopen(o->name, "wb");
+		if (o->resultfile == NULL) {
+			fprintf(stderr, "\nError: can not create File %s\n", o->name);
+			closeOutput(o);
+			freeOutput(o);
+			return NULL;
+		}
 
-		} else {
-			sleeping = 1;
-			while(sleeping == 1){
-				pthread_cond_wait(&next_signal, &next_mutex);
-				if(sleeping == 1) {
-					overflow_response();
-				}
-			}
-			pthread_mutex_unlock(&next_mutex);
+		/* all sequences in the header, the boards write their results interleaved */
+		fprintf(o->resultfile, "@HD VN:1.3 SO:unsorted\n");
+		for(i = 0; i < sequences; i++){
+			fprintf(o->resultfile, "@SQ SN:%s LN:%llu\n", seqnames + seqtable[i].name,
+					(unsigned long long) seqtable[i].bases);
+		}
+		if (fflush(o->resultfile) != 0) {
+			fprintf(stderr, "\nError: writing %s\n", o->name);
+			closeOutput(o);
+			freeOutput(o);
+			return NULL;
+		}
 
+		/* the hits bypass stdio, each board writes its buffer as a whole */
+		for (n = 0; n < boardcount; n++) {
+			if (textBuffer(&o->text[n], fileno(o->resultfile)) == -1) {
+				fprintf(stderr, "\nError: allocating the output buffer of board %u\n", n);
+				closeOutput(o);
+				freeOutput(o);
+				return NULL;
+			}
 		}
 	}
 
-	func_time.search = func_time.search + gettime(time0);
+	if(o->map == 1){
+		o->mapfile = fopen(o->mapname, "wb");
+		o->unmapfile = fopen(o->unmapname, "wb");
+		if ((o->mapfile == NULL) || (o->unmapfile == NULL)) {
+			fprintf(stderr, "\nError: can not create File %s\n", (o->mapfile == NULL) ? o->mapname : o->unmapname);
+			closeOutput(o);
+			freeOutput(o);
+			return NULL;
+		}
 
-	sendControl(ctr_last_data, send_buffer, id);
-	id++;
+		fprintf(o->mapfile, "# readname \t number of mapping positions \t minimal number of mismatches \t allowed mismatches\n");
+		fprintf(o->unmapfile, "# readname \t necessary mismatches \t allowed mismatches\n");
+	}
 
-	fullsend1 = gettime(fullsend0);
+	return o;
+}
 
-	if(stream_wait == 1){
-		overflow_response();
-	}
+/******************************************************************************
+ * Closes the read file and the output files of a query, the flushed buffers
+ * of the boards are freed. Returns -1 if an output file could not be written.
+ ******************************************************************************/
+int closeOutput(struct output_t *o) {
+	unsigned int n;
+	int rc = 0;
 
-	if(stream_end != 1) {
-		pthread_cond_wait(&end_signal, &end_mutex);
+	if (o->readfile != NULL) {
+		closeSeqFile(o->readfile);
+		o->readfile = NULL;
 	}
-	stream_end = 0;
 
-	if(stream_wait == 1){
-		overflow_response();
+	if (o->bamfile != NULL) {
+		for (n = 0; n < boardcount; n++) {
+			if (o->records[n].data != NULL) {
+				rc = bamFlush(o->bamfile, &o->records[n]) || rc;
+			}
+		}
+		if ((bamClose(o->bamfile) == -1) || rc) {
+			fprintf(stderr, "\nError: writing %s\n", o->name);
+			rc = -1;
+		}
+		o->bamfile = NULL;
 	}
 
+	if (o->resultfile != NULL) {
+		for (n = 0; n < boardcount; n++) {
+			if (o->text[n].data != NULL) {
+				rc = textFlush(&o->text[n]) || rc;
+			}
+		}
+		if ((fclose(o->resultfile) != 0) || rc) {
+			fprintf(stderr, "\nError: writing %s\n", o->name);
+			rc = -1;
+		}
+		o->resultfile = NULL;
+	}
+
+	for (n = 0; n < boardcount; n++) {
+		free(o->records[n].data);
+		free(o->text[n].data);
+		o->records[n].data = NULL;
+		o->text[n].data = NULL;
+	}
+
+	if (o->mapfile != NULL) {
+		fclose(o->mapfile);
+		o->mapfile = NULL;
+	}
+	if (o->unmapfile != NULL) {
+		fclose(o->unmapfile);
+		o->unmapfile = NULL;
+	}
+
+	return rc;
+}
+
+void freeOutput(struct output_t *o) {
+	free(o->readname);
+	free(o->name);
+	free(o->mapname);
+	free(o->unmapname);
+	free(o);
+}
+
+/******************************************************************************
+ * Opens the output of the next job of the daemon. Returns NULL without a
+ * queued job, with wait at the end of the daemon. A job whose files can not
+ * be opened is answered at once.
+ ******************************************************************************/
+struct output_t *nextOutput(int wait) {
+	struct output_t *o;
+	struct job_t job;
+
+	while ((jobserver != NULL) && jobNext(jobserver, &job, wait)) {
+		printf("\n--- job %lu: %s ---\n", job.id, job.query);
+
+		o = openOutput(job.query, job.output, job.mismatch, job.flags);
+		if (o != NULL) {
+			o->job = job;
+			return o;
+		}
+		jobDone(jobserver, &job, -1, "");
+	}
+	return NULL;
+}
+
+/******************************************************************************
+ * Closes the output of a job of the daemon after its last read and answers
+ * the job with its counters
+ ******************************************************************************/
+void finishOutput(struct output_t *o) {
+	char summary[1024];
+	int rc;
+
+	rc = closeOutput(o);
+	if (o->error) {
+		fprintf(stderr, "\nError: reading %s, the reads behind the error are missing\n", o->readname);
+		rc = -1;
+	}
+
+	snprintf(summary, sizeof(summary),
+			"created files: %s, %s and %s\n"
+			"found %.0f positions in %u sequences\n"
+			"mapped %.0f of %.0f reads\n"
+			"duplicate reads: %.0f\n",
+			o->name, o->mapname, o->unmapname,
+			o->positions, sequences, o->mapped, o->reads, o->duplicates);
+	jobDone(jobserver, &o->job, rc, summary);
+
+	freeOutput(o);
+}
+
+/******************************************************************************
+ * Creates the BAM file of an output with the sequences of the index as
+ * references and a buffer for the records of every board
+ ******************************************************************************/
+int openBam(struct output_t *o) {
+	struct bambuffer_t header;
+	const char **names;
+	uint64_t *lengths;
+	unsigned int i;
+	int rc;
+
+	o->bamfile = bamOpen(o->name);
+	if (o->bamfile == NULL) {
+		fprintf(stderr, "\nError: can not create File %s\n", o->name);
+		return -1;
+	}
+
+	names = (const char**) malloc(sequences * sizeof(char*));
+	lengths = (uint64_t*) malloc(sequences * sizeof(uint64_t));
+	rc = ((names == NULL) || (lengths == NULL) || (bamBuffer(&header) == -1)) ? -1 : 0;
+	for (i = 0; (rc == 0) && (i < sequences); i++) {
+		names[i] = seqnames + seqtable[i].name;
+		lengths[i] = seqtable[i].bases;
+	}
+	if (rc == 0) {
+		rc = bamHeader(o->bamfile, &header, sequences, names, lengths) || bamFlush(o->bamfile, &header) ? -1 : 0;
+		free(header.data);
+	}
+	free(names);
+	free(lengths);
+
+	for (i = 0; (rc == 0) && (i < boardcount); i++) {
+		rc = bamBuffer(&o->records[i]);
+	}
+	if (rc == -1) {
+		fprintf(stderr, "\nError: writing the header of %s\n", o->name);
+	}
+	return rc;
+}
+
+/******************************************************************************
+ * Prepares the buffers for the connection and the synchronization of a board
+ ******************************************************************************/
+int initializingBoard(struct board_t *b, unsigned int number) {
+
+	memset(b, 0, sizeof(struct board_t));
+	b->number = number;
+	b->id = 1;
+
+	b->send_buffer 	= (char*) malloc(BUF_SIZE * sizeof(char));
+	b->rec_buffer 	= (char*) malloc(BUF_SIZE * sizeof(char));
+	if ((b->send_buffer == NULL) || (b->rec_buffer == NULL)) {
+		fprintf(stderr, "\nError: allocating buffers of board %u\n", number);
+		return -1;
+	}
+
+	pthread_mutex_init(&b->next_mutex, NULL);
+	pthread_cond_init(&b->next_signal, NULL);
+	pthread_cond_init(&b->wait_signal, NULL);
+	pthread_cond_init(&b->start_signal, NULL);
+	pthread_cond_init(&b->end_signal, NULL);
+	pthread_mutex_init(&b->result_mutex, NULL);
+	pthread_cond_init(&b->queued_signal, NULL);
+	pthread_cond_init(&b->decoded_signal, NULL);
+
+	return 0;
+}
+
+/******************************************************************************
+ * Allocates the read and result memory for the units of a board
+ ******************************************************************************/
+int allocatingBoard(struct board_t *b, uint16_t units) {
+	unsigned int j;
+
+	b->maxunits 		= units;
+	b->readslots		= READS_PER_UNIT * units;
+	for (b->copymask = 1; b->copymask < 2 * b->readslots; b->copymask = 2 * b->copymask);
+	b->results			= NULL;		// the FPGA results are decoded in the received frames
+	if (global_opt.cpu == 1) {
+		b->results		= (char*) malloc(units * 4000 * 4 * sizeof(char));	// 1,024 results max
+	}
+	b->readmap 			= (char*) malloc(units * 32 * 32 * sizeof(char));
+	b->indexlabel		= (char*) malloc(b->readslots * LABEL * sizeof(char));		// 200 character label per read
+	b->labellength		= (uint8_t*) malloc(b->readslots * sizeof(uint8_t));
+	b->readbestmatch	= (int8_t*) malloc(b->readslots * sizeof(int8_t));
+	b->readbestmismatch	= (int8_t*) malloc(b->readslots * sizeof(int8_t));
+	b->readposcount		= (uint32_t*) malloc(b->readslots * sizeof(uint32_t));
+	b->readlength		= (uint16_t*) malloc(b->readslots * sizeof(uint16_t));
+	b->readmismatch		= (uint8_t*) malloc(b->readslots * sizeof(uint8_t));
+	b->sequence			= (char*) malloc(b->readslots * SEQUENCE * sizeof(char));
+	b->original			= (uint16_t*) malloc(b->readslots * sizeof(uint16_t));
+	b->nextcopy			= (uint16_t*) malloc(b->readslots * sizeof(uint16_t));
+	b->readout			= (struct output_t**) malloc(b->readslots * sizeof(struct output_t*));
+	b->copytable		= (uint32_t*) malloc(b->copymask * sizeof(uint32_t));
+	b->cached			= (struct cachedread_t**) calloc(b->readslots, sizeof(struct cachedread_t*));
+	b->hitlog			= NULL;
+	b->hitcount			= 0;
+	b->hitsize			= 0;
+	b->unitread			= (uint16_t*) malloc(units * sizeof(uint16_t));
+	b->unitpiece		= (uint8_t*) malloc(units * sizeof(uint8_t));
+	b->threshold		= (uint8_t*) malloc(units * sizeof(uint8_t));
+
+	if (((b->results == NULL) && (global_opt.cpu == 1)) || (b->readmap == NULL) || (b->indexlabel == NULL) || (b->labellength == NULL) ||
+		(b->readbestmatch == NULL) || (b->readbestmismatch == NULL) || (b->readposcount == NULL) || (b->readlength == NULL) ||
+		(b->readmismatch == NULL) || (b->sequence == NULL) || (b->unitread == NULL) || (b->unitpiece == NULL) || (b->threshold == NULL) ||
+		(b->original == NULL) || (b->nextcopy == NULL) || (b->copytable == NULL) || (b->cached == NULL) || (b->readout == NULL)) {
+		fprintf(stderr, "\nError: allocating memory of board %u\n", b->number);
+		return -1;
+	}
+
+	b->copymask = b->copymask - 1;
+
+	for(j = 0; j < b->readslots; j++){
+		b->readbestmatch[j] 	= 8;
+		b->readbestmismatch[j] 	= 8;
+		b->readposcount[j] 		= 0;
+	}
+
+	return 0;
+}
+
+/******************************************************************************
+ * Maps the binary index with names, sizes and offsets of all sequences, falls
+ * back to the info file of older transformations
+ ******************************************************************************/
+int readingDBIndex() {
+	struct stat sb;
+
+	dbindex = mapDBIndex(global_opt.indexname, &indexsize);
+	if (dbindex == NULL) {
+		if (stat(global_opt.indexname, &sb) == 0) {
+			return -1;
+		}
+		if (stat(global_opt.infodbname, &sb) == -1) {
+			fprintf(stderr, "\nError: can not open File %s\n", global_opt.indexname);
+			return -1;
+		}
+		printf("Warning: no index %s, reading %s; transform the database again\n",
+				global_opt.indexname, global_opt.infodbname);
+		if (readingDBInfo() == -1) {
+			return -1;
+		}
+	}
+
+	seqtable = (const struct dbentry_t*) (dbindex + 1);
+	gaptable = (const struct dbgap_t*) (seqtable + dbindex->sequences);
+	seqnames = (const char*) dbindex + dbindex->names;
+	sequences = dbindex->sequences;
+	gapcount = dbindex->gaps;
+	dbchars = dbindex->bases;
+	printf("sequences: %u\n", sequences);
+	printf("runs of N: %llu with %llu bases\n", (unsigned long long) gapcount, (unsigned long long) dbindex->masked);
+
+	return 0;
+}
+
+/******************************************************************************
+ * Reads names, sizes and offsets of all sequences from the info file of an
+ * older transformation into an index without checksum
+ ******************************************************************************/
+int readingDBInfo() {
+	char line[LABEL], *ptr;
+	double count, value;
+	unsigned int i;
+	struct dbindex_t *index;
+	struct dbentry_t *entries;
+	char *names;
+	FILE *infodb;
+
+	infodb = fopen(global_opt.infodbname, "rb");
+	if (infodb == NULL) {
+		fprintf(stderr, "\nError: can not open File %s\n", global_opt.infodbname);
+		return -1;
+	}
+
+	/* reading from info-File */
+	fgets(line, 20, infodb);
+	sscanf(line, "# %lf\n", &count);
+
+	index = (struct dbindex_t*) calloc(1, sizeof(struct dbindex_t) +
+			(unsigned long) count * (sizeof(struct dbentry_t) + LABEL));
+	if (index == NULL) {
+		fprintf(stderr, "\nError: allocating sequence table\n");
+		return -1;
+	}
+	entries = (struct dbentry_t*) (index + 1);
+	names = (char*) (entries + (unsigned long) count);
+
+	memcpy(index->magic, DBINDEX_MAGIC, 8);
+	index->sequences = (uint32_t) count;
+	index->names = (char*) names - (char*) index;
+
+	fgets(line, 20, infodb);
+	sscanf(line, "# %lf\n", &value);
+	index->bases = (uint64_t) value;
+	fgets(line, 20, infodb);//empty
+
+	for(i = 0; i < index->sequences; i++){
+		fgets(line, 20, infodb);//position
+		sscanf(line, "# %lf\n", &value);
+		entries[i].start = (uint64_t) value;
+
+		entries[i].name = i * LABEL;
+		if (fgets(names + entries[i].name, LABEL, infodb) == NULL) {//name
+			fprintf(stderr, "\nError: %s ends after %u sequences\n", global_opt.infodbname, i);
+			return -1;
+		}
+		ptr = strchr(names + entries[i].name, '\n');
+		if (ptr != NULL) {
+			*ptr = 0;
+		}
+
+		fscanf(infodb, "# %lf\n", &value);//characters
+		entries[i].bytes = (uint64_t) value;
+		entries[i].offset = index->bytes;
+		index->bytes = index->bytes + entries[i].bytes;
+		if (i > 0) {
+			entries[i-1].bases = entries[i].start - entries[i-1].start;
+		}
+	}
+	if (i > 0) {
+		entries[i-1].bases = index->bases - entries[i-1].start;
+	}
+
+	fclose(infodb);
+	dbindex = index;
+
+	return 0;
+}
+
+/******************************************************************************
+ * Every board takes the next batch of reads and searches the whole database
+ * with it until all reads are processed
+ ******************************************************************************/
+int searchingSplitReads() {
+	void *status;
+	unsigned int n;
+	int rc, failed = 0;
+
+	for (n = 0; n < boardcount; n++) {
+		rc = pthread_create(&boards[n].thread, &attr, searchBoard, (void *) &boards[n]);
+		if (rc){
+			printf("ERROR; return code from pthread_create() is %d\n", rc);
+			return -1;
+		}
+	}
+
+	for (n = 0; n < boardcount; n++) {
+		pthread_join(boards[n].thread, &status);
+		if (status != (void*) 0) {
+			failed = 1;
+		}
+	}
+
+	return failed ? -1 : 0;
+}
+
+/******************************************************************************
+ * Thread of one board for split reads
+ ******************************************************************************/
+void *searchBoard(void *board) {
+	struct board_t *b = (struct board_t*) board;
+
+	b->first = 0;
+	b->last = sequences;
+
+	while (1) {
+		b->reads = takeReads(b);
+
+		if (b->reads == 0) {
+			break;
+		}
+
+		if (searchBatch(b) == -1) {
+			/* the copies of its reads on the other boards do not wait */
+			cacheBatch(b);
+			pthread_exit((void*) 1);
+		}
+
+		finishBatch(b);
+	}
+
+	pthread_exit((void*) 0);
+}
+
+/******************************************************************************
+ * All boards search the same batch of reads, each in its own range of
+ * sequences with about the same number of characters. The results for the
+ * reads are merged after every batch.
+ ******************************************************************************/
+int searchingSplitDB() {
+	struct board_t *first = &boards[0];
+	void *status;
+	unsigned int n, s = 0, j;
+	double share = 0, total = 0;
+	int rc, failed = 0;
+
+	/* all boards have to hold the batch */
+	for (n = 1; n < boardcount; n++) {
+		if (boards[n].maxunits < first->maxunits) {
+			first->maxunits = boards[n].maxunits;
+			first->readslots = boards[n].readslots;
+		}
+	}
+
+	for (s = 0; s < sequences; s++) {
+		total = total + seqtable[s].bytes;
+	}
+
+	s = 0;
+	for (n = 0; n < boardcount; n++) {
+		boards[n].first = s;
+		while ((s < sequences) && ((n == boardcount - 1) || (s == boards[n].first) ||
+				(share + seqtable[s].bytes / 2.0 <= total * (n + 1) / boardcount))) {
+			share = share + seqtable[s].bytes;
+			s++;
+		}
+		boards[n].last = s;
+		printf("board %u: sequences %u to %u\n", n, boards[n].first, boards[n].last);
+	}
+
+	while (1) {
+		first->reads = takeReads(first);
+		if (first->reads == 0) {
+			break;
+		}
+
+		for (n = 1; n < boardcount; n++) {
+			boards[n].reads = first->reads;
+			boards[n].readcount = first->readcount;
+			memcpy(boards[n].readmap, first->readmap, first->reads * 132);
+			memcpy(boards[n].unitread, first->unitread, first->reads * sizeof(uint16_t));
+			memcpy(boards[n].unitpiece, first->unitpiece, first->reads);
+			memcpy(boards[n].threshold, first->threshold, first->reads);
+			memcpy(boards[n].indexlabel, first->indexlabel, first->readcount * LABEL);
+			memcpy(boards[n].labellength, first->labellength, first->readcount);
+			memcpy(boards[n].original, first->original, first->readcount * sizeof(uint16_t));
+			memcpy(boards[n].nextcopy, first->nextcopy, first->readcount * sizeof(uint16_t));
+			memcpy(boards[n].cached, first->cached, first->readcount * sizeof(struct cachedread_t*));
+			memcpy(boards[n].readout, first->readout, first->readcount * sizeof(struct output_t*));
+			memcpy(boards[n].readlength, first->readlength, first->readcount * sizeof(uint16_t));
+			memcpy(boards[n].readmismatch, first->readmismatch, first->readcount);
+			memcpy(boards[n].sequence, first->sequence, first->readcount * SEQUENCE);
+		}
+
+		for (n = 0; n < boardcount; n++) {
+			if (boards[n].first == boards[n].last) {
+				continue;
+			}
+			rc = pthread_create(&boards[n].thread, &attr, searchRange, (void *) &boards[n]);
+			if (rc){
+				printf("ERROR; return code from pthread_create() is %d\n", rc);
+				return -1;
+			}
+		}
+
+		for (n = 0; n < boardcount; n++) {
+			if (boards[n].first == boards[n].last) {
+				continue;
+			}
+			pthread_join(boards[n].thread, &status);
+			if (status != (void*) 0) {
+				failed = 1;
+			}
+		}
+		if (failed == 1) {
+			return -1;
+		}
+
+		/* merging the results of the reads and the hits for the cache */
+		for (n = 1; n < boardcount; n++) {
+			struct board_t *b = &boards[n];
+
+			for (j = 0; j < b->hitcount; j++) {
+				logHit(first, b->hitlog[j].read, b->hitlog[j].sequence, b->hitlog[j].offset, b->hitlog[j].reverse);
+			}
+			b->hitcount = 0;
+			for(j = 0; j < first->readcount; j++){
+				first->readposcount[j] = first->readposcount[j] + b->readposcount[j];
+				if (b->readbestmatch[j] < first->readbestmatch[j]) {
+					first->readbestmatch[j] = b->readbestmatch[j];
+				}
+				if (b->readbestmismatch[j] < first->readbestmismatch[j]) {
+					first->readbestmismatch[j] = b->readbestmismatch[j];
+				}
+				b->readbestmatch[j] = 8;
+				b->readbestmismatch[j] = 8;
+				b->readposcount[j] = 0;
+			}
+		}
+
+		finishBatch(first);
+	}
+
+	return 0;
+}
+
+/******************************************************************************
+ * Thread of one board for split database
+ ******************************************************************************/
+void *searchRange(void *board) {
+	struct board_t *b = (struct board_t*) board;
+
+	if (searchBatch(b) == -1) {
+		pthread_exit((void*) 1);
+	}
+
+	pthread_exit((void*) 0);
+}
+
+/******************************************************************************
+ * Loads the current batch of reads and searches the sequences of the board,
+ * one segment per sequence or with --whole as many sequences as the 32 bit
+ * positions of the board can address. Runs of at least MINSKIP N end a
+ * segment and are not streamed.
+ ******************************************************************************/
+int searchBatch(struct board_t *b) {
+	unsigned int s, first, segments = 0;
+	uint64_t base = 0, from, to, g;
+
+	/*------------------------------------------------------
+								transfer reads
+	------------------------------------------------------*/
+	if (global_opt.cpu == 1) {
+		loadingReadsCPU(b);
+	} else {
+		sendingReads(b);
+	}
+
+	s = b->first;
+	while (s < b->last) {
+
+		/* from base of sequence s up to the next long run of N or the end */
+		first = s;
+		from = seqtable[s].offset + base / 4;
+		for (;;) {
+			g = nextGap(s, base);
+			if (g < gapcount) {
+				to = seqtable[s].offset + (gaptable[g].start - seqtable[s].start + 3) / 4;
+				base = gaptable[g].start + gaptable[g].bases - seqtable[s].start;
+				s++;
+				if (base < seqtable[s-1].bases) {
+					s--;
+				} else {
+					base = 0;
+				}
+				break;
+			}
+			to = seqtable[s].offset + seqtable[s].bytes;
+			s++;
+			base = 0;
+			if ((global_opt.whole == 0) || (s == b->last) || (to - from + seqtable[s].bytes > MAXSEGMENT)) {
+				break;
+			}
+		}
+		if (to == from) {
+			continue;
+		}
+
+		/* the start of the next segment is read while this one is streamed */
+		if (s < b->last) {
+			g = seqtable[s].offset + base / 4;
+			dbPrefetch(&dbcache, g, g + DB_PREFETCH);
+		}
+
+		if ((global_opt.cpu != 1) && (segments > 0)) {
+			sendControl(&b->dev, ctr_next_segment, b->send_buffer, b->id);
+			b->id++;
+		}
+		segments++;
+
+		if (searchSegment(b, first, (base == 0) ? s : s + 1, from, to) == -1) {
+			return -1;
+		}
+	}
+
+	if (global_opt.cpu != 1) {
+		sendControl(&b->dev, ctr_finished_iteration, b->send_buffer, b->id);
+
+		/* the reads of the batch are counted after their last results */
+		waitResults(b);
+	}
+	b->id = 1;
+
+	return 0;
+}
+
+/******************************************************************************
+ * First run of N in sequence s from base on that is long enough to be
+ * skipped, returns gapcount if there is none
+ ******************************************************************************/
+uint64_t nextGap(unsigned int s, uint64_t base) {
+	uint64_t lo = 0, hi = gapcount, mid;
+	uint64_t const end = seqtable[s].start + seqtable[s].bases;
+
+	base = base + seqtable[s].start;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (gaptable[mid].start < base)  lo = mid + 1;
+		else  hi = mid;
+	}
+	for (; (lo < gapcount) && (gaptable[lo].start < end); lo++) {
+		if (gaptable[lo].bases >= MINSKIP) {
+			return lo;
+		}
+	}
+	return gapcount;
+}
+
+/******************************************************************************
+ * Checks if a hit at start in bases of the whole database overlaps a run
+ * of N
+ ******************************************************************************/
+int maskedHit(uint64_t start, unsigned int length) {
+	uint64_t lo = 0, hi = gapcount, mid;
+
+	/* last run that starts before the end of the hit */
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (gaptable[mid].start < start + length)  lo = mid + 1;
+		else  hi = mid;
+	}
+	return (lo > 0) && (gaptable[lo-1].start + gaptable[lo-1].bases > start);
+}
+
+/******************************************************************************
+ * Streams the bytes from to to-1 of the database with the sequences first
+ * to last-1 as one text to the board and writes the results
+ ******************************************************************************/
+int searchSegment(struct board_t *b, unsigned int first, unsigned int last, uint64_t from, uint64_t to) {
+	char ctr;
+
+	b->seqfirst = first;
+	b->seqlast = last;
+	b->dbmapposition = from;
+	b->seqchars = to - from;
+	b->packets = b->seqchars / REAL_DB_DATA;
+
+	/* the stream thread keeps the read ahead going */
+	dbPrefetch(&dbcache, from, to);
+	b->prefetch = from + DB_PREFETCH;
+
+	if (global_opt.cpu == 1) {
+		if (searchingCPU(b) == -1) {
+			fprintf(stderr, "\nError: searching on CPU\n");
+			return -1;
+		}
+		return 0;
+	}
+
+	/*------------------------------------------------------
+					transfer database
+	------------------------------------------------------*/
+	ctr = receive(&b->dev, CTR_BUF_SIZE, b->rec_buffer);
+	while(ctr != ctr_send_DB){
+		ctr = receive(&b->dev, CTR_BUF_SIZE, b->rec_buffer);
+	}
+
+	/* starts the stream and the receiver thread and waits for both */
+	pthread_mutex_lock(&b->next_mutex);
+	memcpy(&b->sendNext, b->rec_buffer+1, 2);//number of Bytes in FPGA-Text-FIFO
+	b->send_next_stream = 1;
+	b->stream_wait = 0;
+	b->stream_end = 0;
+	b->stream_error = 0;
+	b->done = 0;
+	b->round++;
+	pthread_cond_broadcast(&b->start_signal);
+	while (b->done < 2) {
+		pthread_cond_wait(&b->end_signal, &b->next_mutex);
+	}
+	pthread_mutex_unlock(&b->next_mutex);
+
+	if (b->stream_error == 1) {
+		fprintf(stderr, "\nError: streaming the database to board %u\n", b->number);
+		return -1;
+	}
+
+	/*------------------------------------------------------
+					load results
+	------------------------------------------------------*/
+
+	if (saveResults(b) == -1){
+		fprintf(stderr, "\nError: saving results\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/******************************************************************************
+ * Starts the stream, the receiver and the result writer thread of a board,
+ * they serve the segments of all batches until stoppingThreads
+ ******************************************************************************/
+int startingThreads(struct board_t *b) {
+	unsigned int i;
+	int rc;
+
+	b->round = 0;
+	b->quit = 0;
+	b->resulthead = 0;
+	b->resulttail = 0;
+	b->resultquit = 0;
+
+	b->resultblocks = (struct resultblock_t*) calloc(RESULT_BLOCKS, sizeof(struct resultblock_t));
+	if (b->resultblocks == NULL) {
+		fprintf(stderr, "\nError: allocating result blocks of board %u\n", b->number);
+		return -1;
+	}
+	for (i = 0; i < RESULT_BLOCKS; i++) {
+		b->resultblocks[i].data = (char*) malloc(RESULT_BLOCK);
+		if (b->resultblocks[i].data == NULL) {
+			fprintf(stderr, "\nError: allocating result blocks of board %u\n", b->number);
+			return -1;
+		}
+	}
+
+	rc = pthread_create(&b->writer, &attr, writeResults, (void *) b);
+	if (rc){
+		printf("ERROR; return code from pthread_create() is %d\n", rc);
+		return -1;
+	}
+
+	rc = pthread_create(&b->receiver, &attr, rcvError, (void *) b);
+	if (rc){
+		printf("ERROR; return code from pthread_create() is %d\n", rc);
+		return -1;
+	}
+
+	rc = pthread_create(&b->streamer, &attr, stream, (void *) b);
+	if (rc){
+		printf("ERROR; return code from pthread_create() is %d\n", rc);
+		return -1;
+	}
+
+	return 0;
+}
+
+/******************************************************************************
+ * Ends the threads of a board after the last segment, the writer after the
+ * last queued block
+ ******************************************************************************/
+void stoppingThreads(struct board_t *b) {
+	unsigned int i;
+
+	pthread_mutex_lock(&b->next_mutex);
+	b->quit = 1;
+	pthread_cond_broadcast(&b->start_signal);
+	pthread_mutex_unlock(&b->next_mutex);
+
+	pthread_join(b->receiver, NULL);
+	pthread_join(b->streamer, NULL);
+
+	pthread_mutex_lock(&b->result_mutex);
+	b->resultquit = 1;
+	pthread_cond_signal(&b->queued_signal);
+	pthread_mutex_unlock(&b->result_mutex);
+
+	pthread_join(b->writer, NULL);
+
+	for (i = 0; i < RESULT_BLOCKS; i++) {
+		free(b->resultblocks[i].data);
+	}
+	free(b->resultblocks);
+}
+
+/******************************************************************************
+ * Waits in the stream or the receiver thread for the next segment, returns 0
+ * at the end of the run
+ ******************************************************************************/
+int nextSegment(struct board_t *b, unsigned int *round) {
+	int next;
+
+	pthread_mutex_lock(&b->next_mutex);
+	while ((b->round == *round) && (b->quit == 0)) {
+		pthread_cond_wait(&b->start_signal, &b->next_mutex);
+	}
+	*round = b->round;
+	next = (b->quit == 0);
+	pthread_mutex_unlock(&b->next_mutex);
+
+	return next;
+}
+
+/******************************************************************************
+ * Reports the end of the segment from the stream or the receiver thread
+ ******************************************************************************/
+void finishedSegment(struct board_t *b) {
+
+	pthread_mutex_lock(&b->next_mutex);
+	b->done++;
+	pthread_cond_signal(&b->end_signal);
+	pthread_mutex_unlock(&b->next_mutex);
+}
+
+/******************************************************************************
+ * Counts the positions and mapped reads of a batch and prints the list of
+ * mapped and unmapped reads
+ ******************************************************************************/
+void finishBatch(struct board_t *b) {
+	struct output_t *o, *complete = NULL;
+	struct cachedread_t *e;
+	unsigned int j, h;
+
+	/* duplicates get the results of the read that was searched */
+	for(j = 0; j < b->readcount; j++){
+		if ((b->original[j] != j) && (b->original[j] != CACHED)) {
+			b->readposcount[j] = b->readposcount[b->original[j]];
+			b->readbestmatch[j] = b->readbestmatch[b->original[j]];
+			b->readbestmismatch[j] = b->readbestmismatch[b->original[j]];
+		}
+	}
+
+	/* the reads searched now keep their hits for their copies, before this
+	 * board waits for the reads that another board searches */
+	cacheBatch(b);
+	for(j = 0; j < b->readcount; j++){
+		if (b->original[j] != CACHED) {
+			continue;
+		}
+		e = b->cached[j];
+		cacheWait(e);
+		for (h = 0; h < e->hits; h++) {
+			writeHit(b, j, e->hit[h].sequence, e->hit[h].offset, e->hit[h].reverse);
+		}
+		b->readposcount[j] = e->positions;
+		b->readbestmatch[j] = e->best;
+		b->readbestmismatch[j] = e->bestmismatch;
+	}
+
+	pthread_mutex_lock(&output_mutex);
+	for(j = 0; j < b->readcount; j++){
+		o = b->readout[j];
+		positions = positions + b->readposcount[j];
+		o->positions = o->positions + b->readposcount[j];
+		metricObserve(METRIC_READ_HITS, b->readposcount[j]);
+		if (b->readbestmatch[j] < (int8_t) 8) {
+			mapped = mapped + 1;
+			metricAdd(METRIC_MAPPED, 1);
+			o->mapped = o->mapped + 1;
+			if(o->map == 1){
+				fprintf(o->mapfile, "%s", b->indexlabel + (j * LABEL));
+				fprintf(o->mapfile, " %u %u %u\n", b->readposcount[j], b->readbestmatch[j], b->readmismatch[j]);
+			}
+		} else {
+			if(o->map == 1){
+				fprintf(o->unmapfile, "%s", b->indexlabel + (j * LABEL));
+				fprintf(o->unmapfile, " %u %u\n", b->readbestmismatch[j], b->readmismatch[j]);
+			}
+		}
+		b->readbestmatch[j] = 8;
+		b->readbestmismatch[j] = 8;
+		b->readposcount[j] = 0;
+		if (b->cached[j] != NULL) {
+			cacheRelease(b->cached[j]);
+			b->cached[j] = NULL;
+		}
+
+		/* a job of the daemon is answered after its last read */
+		metricAdd(METRIC_READS, 1);
+		o->written++;
+		if (o->complete && (o->written == o->encoded) && (o->job.id != 0)) {
+			o->next = complete;
+			complete = o;
+		}
+	}
+	pthread_mutex_unlock(&output_mutex);
+
+	while (complete != NULL) {
+		o = complete;
+		complete = o->next;
+		finishOutput(o);
+	}
+}
+
+/* by read, the hits of a read in the order of the stream */
+static int hitRead(const void *a, const void *b) {
+	const struct cachedhit_t *x = (const struct cachedhit_t*) a, *y = (const struct cachedhit_t*) b;
+
+	if (x->read != y->read) {
+		return (int) x->read - (int) y->read;
+	}
+	if (x->sequence != y->sequence) {
+		return (x->sequence < y->sequence) ? -1 : 1;
+	}
+	if (x->offset != y->offset) {
+		return (x->offset < y->offset) ? -1 : 1;
+	}
+	return (int) x->reverse - (int) y->reverse;
+}
+
+/******************************************************************************
+ * Hands the logged hits of the reads searched in the batch to their entries
+ * of the run-wide cache, which wakes the boards waiting for them
+ ******************************************************************************/
+void cacheBatch(struct board_t *b) {
+	struct cachedhit_t *hit;
+	unsigned int j, h = 0, n;
+
+	qsort(b->hitlog, b->hitcount, sizeof(struct cachedhit_t), hitRead);
+	for (j = 0; j < b->readcount; j++) {
+		for (n = h; (n < b->hitcount) && (b->hitlog[n].read == j); n++);
+		if ((b->original[j] == j) && (b->cached[j] != NULL)) {
+			hit = NULL;
+			if (n > h) {
+				hit = (struct cachedhit_t*) malloc((n - h) * sizeof(struct cachedhit_t));
+				if (hit == NULL) {
+					fprintf(stderr, "\nError: allocating the cached hits of a read, its copies get none\n");
+				} else {
+					memcpy(hit, b->hitlog + h, (n - h) * sizeof(struct cachedhit_t));
+				}
+			}
+			cacheDone(b->cached[j], hit, (hit != NULL) ? n - h : 0, b->readposcount[j], b->readbestmatch[j], b->readbestmismatch[j]);
+		}
+		h = n;
+	}
+	b->hitcount = 0;
+}
+
+/******************************************************************************
+ * Database streaming Thread
+ ******************************************************************************/
+void *stream(void *board) {
+	struct board_t *b = (struct board_t*) board;
+	unsigned int round = 0;
+
+	while (nextSegment(b, &round)) {
+		streamSegment(b);
+		finishedSegment(b);
+	}
+
+	pthread_exit((void*) 0);
+}
+
+/******************************************************************************
+ * Streams one segment of the database with the flow-control of the FPGA
+ ******************************************************************************/
+int streamSegment(struct board_t *b) {
+	double fullsend0, fullsend1, bandwidth;
+	unsigned int i, j, p, fpgaPackets, packetsize, nextBytes, burst = 0;
+	struct frame_t frames[TX_BURST];
+	char ctr;
+
+	p = 0;
+	i = 0;
+	fullsend0 = gettime(0);
+
+	double time0 = gettime(0);
+
+	while(p <= b->packets){
+
+		/* waits for the next credit of the FPGA or an overflow */
+		pthread_mutex_lock(&b->next_mutex);
+		while ((b->send_next_stream == 0) && (b->stream_wait == 0) && (b->stream_error == 0)) {
+			pthread_cond_wait(&b->next_signal, &b->next_mutex);
+		}
+		if (b->stream_error == 1) {
+			pthread_mutex_unlock(&b->next_mutex);
+			return -1;
+		}
+		if (b->send_next_stream == 0) {
+			pthread_mutex_unlock(&b->next_mutex);
+			overflow_response(b);
+			continue;
+		}
+		b->send_next_stream = 0;
+		nextBytes = (unsigned int) b->sendNext;
+		pthread_mutex_unlock(&b->next_mutex);
+		metricObserve(METRIC_CREDIT_BYTES, nextBytes);
+
+		fpgaPackets = (nextBytes / REAL_DB_DATA)-4;//FFFF -> 43 Pakete
+		if (fpgaPackets > 43) {
+			fpgaPackets = 2;
+		} else if (fpgaPackets == 0) {
+			fpgaPackets = 0;
+		}
+
+		if(b->stream_wait == 1){
+			overflow_response(b);
+		}
+
+		/* the next window of the segment before the stream reaches it */
+		if ((b->dbmapposition + (REAL_DB_DATA * p) + DB_PREFETCH / 2 >= b->prefetch) &&
+			(b->prefetch < b->dbmapposition + b->seqchars)) {
+			dbPrefetch(&dbcache, b->prefetch, b->dbmapposition + b->seqchars);
+			b->prefetch = b->prefetch + DB_PREFETCH;
+		}
+
+		for (j = 0; (j < fpgaPackets) && (p <= b->packets); j++) {
+
+			//stops at the end of a segment
+			if(p == b->packets) {
+				packetsize = b->seqchars - (REAL_DB_DATA * p);
+			} else {
+				packetsize = DATA_SIZE;
+			}
+
+			if (j == 0 and i == 0) {
+				ctr = ctr_first_data;
+			} else {
+				ctr = ctr_data;
+			}
+
+			if (b->dev.tx == TX_COPY) {
+				memcpy(b->send_buffer+17, dbmap + b->dbmapposition + (REAL_DB_DATA * p), packetsize);
+				sendData(&b->dev, packetsize, ctr, b->send_buffer, b->id);
+			} else {
+				/* sent in place from the database as one burst */
+				frames[burst].ctr = ctr;
+				frames[burst].id = b->id;
+				frames[burst].data = dbmap + b->dbmapposition + (REAL_DB_DATA * p);
+				frames[burst].length = packetsize;
+				burst++;
+			}
+			p++;
+			b->id++;
+
+			if (p == b->packets + 1) {
+				break;
+			}
+			if (b->stream_error == 1) {
+				return -1;
+			}
+
+			if((b->stream_wait == 1) || (burst == TX_BURST)){
+				burst = sendingFrames(b, frames, burst);
+			}
+			if(b->stream_wait == 1){
+				overflow_response(b);
+			}
+		}
+		burst = sendingFrames(b, frames, burst);
+
+		if (b->stream_error == 1) {
+			return -1;
+		}
+		i++;
+
+		if(b->stream_wait == 1){
+			overflow_response(b);
+		}
+	}
+
+	b->time.search = b->time.search + gettime(time0);
+
+	sendControl(&b->dev, ctr_last_data, b->send_buffer, b->id);
+	b->id++;
+
+	fullsend1 = gettime(fullsend0);
+
+	/* units can overflow until the FPGA finished the search */
+	pthread_mutex_lock(&b->next_mutex);
+	while ((b->stream_end == 0) && (b->stream_error == 0)) {
+		if (b->stream_wait == 1) {
+			pthread_mutex_unlock(&b->next_mutex);
+			overflow_response(b);
+			pthread_mutex_lock(&b->next_mutex);
+			continue;
+		}
+		pthread_cond_wait(&b->next_signal, &b->next_mutex);
+	}
+	pthread_mutex_unlock(&b->next_mutex);
+
 	/*------------------------------------------------------
 					calculating bandwidth
 	 ------------------------------------------------------*/
 
 	bandwidth = ((p * (REAL_DB_DATA * 8)) / fullsend1) / 1024 / 1024;
 
-	if (global_opt.status == 1){
-		printf("Bandwidth: %8.2f MBit/s \n", bandwidth);
-		printf("processed %.0f reads \n", maxreads);
+	metricObserve(METRIC_SEGMENT_SECONDS, fullsend1);
+	metricAdd(METRIC_STREAM_BYTES, b->seqchars);
+	metricAdd(METRIC_STREAM_PACKETS, p);
+
+	b->time.txBandwidth = b->time.txBandwidth + bandwidth;
+	b->time.streams++;
+
+	return 0;
+}
+
+/******************************************************************************
+ * Sends the collected frames of the database stream, returns the new burst size
+ ******************************************************************************/
+unsigned int sendingFrames(struct board_t *b, struct frame_t *frames, unsigned int burst) {
+
+	if (burst == 0) {
+		return 0;
 	}
 
-	func_time.txBandwidth = func_time.txBandwidth + bandwidth;
-	func_time.streams++;
+	if (sendFrames(&b->dev, b->send_buffer, frames, burst) == -1) {
+		pthread_mutex_lock(&b->next_mutex);
+		b->stream_error = 1;
+		pthread_mutex_unlock(&b->next_mutex);
+	}
 
-	pthread_exit((void*) 0);
+	return 0;
 }
 
 /******************************************************************************
  * Thread waiting for error
  ******************************************************************************/
-void *rcvError(void *threadid) {
+void *rcvError(void *board) {
+	struct board_t *b = (struct board_t*) board;
+	unsigned int round = 0;
+
+	while (nextSegment(b, &round)) {
+		receiveControls(b);
+		finishedSegment(b);
+	}
+
+	pthread_exit((void*) 0);
+}
+
+/******************************************************************************
+ * Reports the packet of the stream the FPGA lost, from its error frame
+ ******************************************************************************/
+void lostPacket(struct board_t *b, const char *frame) {
+	printf("\nError: message number %u lost on board %u\n", (unsigned int) (frame[1] & 255), b->number);
+}
+
+/******************************************************************************
+ * Receives the flow-control of one segment until the FPGA finished the
+ * search. On an overflow the stream thread downloads the results, in the
+ * meantime nothing else is received.
+ ******************************************************************************/
+int receiveControls(struct board_t *b) {
 	char ctr;
-	unsigned int lastPacket;
-	stream_error = 0;
+	int failed;
 
 	do {
-		ctr = receive(CTR_BUF_SIZE, rec_buffer);
+		ctr = receive(&b->dev, CTR_BUF_SIZE, b->rec_buffer);
 		if (ctr == error) {
-			lastPacket = rec_buffer[1] & 255;
-			printf("\nError: message number %u lost\n", lastPacket);
-			stream_error = 1;
-			pthread_exit((void*) 1);
+			lostPacket(b, b->rec_buffer);
+			break;
 
 		} else if(ctr == ctr_send_next) {
-			memcpy(&sendNext, rec_buffer+1, 2);
-			pthread_mutex_lock(&next_mutex);
-			send_next_stream = 1;
-			if (sleeping == 1){
-				sleeping = 0;
-				pthread_cond_signal(&next_signal);
-			}
-			pthread_mutex_unlock(&next_mutex);
+			pthread_mutex_lock(&b->next_mutex);
+			memcpy(&b->sendNext, b->rec_buffer+1, 2);
+			b->send_next_stream = 1;
+			pthread_cond_signal(&b->next_signal);
+			pthread_mutex_unlock(&b->next_mutex);
 
 		} else if (ctr == ctr_overflow) {
-			stream_wait = 1;
 			if (global_opt.status == 1){
-				printf("unit overflow\n");
+				printf("unit overflow on board %u\n", b->number);
 			}
 
-			pthread_mutex_lock(&next_mutex);
-			if (sleeping == 1){
-				pthread_mutex_unlock(&next_mutex);
-				pthread_cond_signal(&next_signal);
-			}else {
-				if(stream_end != 1) {
-					pthread_cond_signal(&end_signal);
-					stream_end = 1;
-				}
-				pthread_mutex_unlock(&next_mutex);
-
+			pthread_mutex_lock(&b->next_mutex);
+			b->stream_wait = 1;
+			pthread_cond_signal(&b->next_signal);
+			while ((b->stream_wait == 1) && (b->stream_error == 0)) {
+				pthread_cond_wait(&b->wait_signal, &b->next_mutex);
+			}
+			failed = b->stream_error;
+			pthread_mutex_unlock(&b->next_mutex);
+			if (failed == 1) {
+				return -1;
 			}
-			pthread_cond_wait(&wait_signal, &wait_mutex);
 
 		} else if (ctr == ctr_finished_search) {
-			if (stream_end != 1){
-				stream_end = 1;
-				pthread_cond_signal(&end_signal);
-				pthread_exit((void*) 0);
-			}
+			pthread_mutex_lock(&b->next_mutex);
+			b->stream_end = 1;
+			pthread_cond_signal(&b->next_signal);
+			pthread_mutex_unlock(&b->next_mutex);
+			return 0;
+
 		} else {
 			printf("\nError: Received invalid message\n");
-			pthread_exit((void*) 1);
+			break;
 		}
 	} while(1);
 
+	pthread_mutex_lock(&b->next_mutex);
+	b->stream_error = 1;
+	pthread_cond_signal(&b->next_signal);
+	pthread_mutex_unlock(&b->next_mutex);
+
+	return -1;
 }
 
-int overflow_response(){
+/******************************************************************************
+ * Downloads the results after an overflow and releases the search. The
+ * stream waits only for the download, the writer thread formats the results.
+ ******************************************************************************/
+int overflow_response(struct board_t *b){
+	double time0 = gettime(0);
+	int rc = 0;
 
-	sendControl(ctr_overflow_ready, send_buffer, id);
-	id++;
+	sendControl(&b->dev, ctr_overflow_ready, b->send_buffer, b->id);
+	b->id++;
 
-	overflows++;
+	b->overflows++;
 
-	if (saveResults() == -1){
+	if (saveResults(b) == -1){
 		fprintf(stderr, "\nError: saving results\n");
-		pthread_exit((void*) 1);
+		rc = -1;
 	}
-	if (printResults() == -1){
-		fprintf(stderr, "\nError: printing results\n");
-		pthread_exit((void*) 1);
+	sendControl(&b->dev, ctr_overflow_ready, b->send_buffer, b->id);
+	b->id++;
+
+	time0 = gettime(time0);
+	b->time.pause = b->time.pause + time0;
+	metricAdd(METRIC_OVERFLOWS, 1);
+	metricObserve(METRIC_PAUSE_SECONDS, time0);
+
+	pthread_mutex_lock(&b->next_mutex);
+	b->stream_wait = 0;
+	if (rc == -1) {
+		b->stream_error = 1;
 	}
-	sendControl(ctr_overflow_ready, send_buffer, id);
-	id++;
-	pthread_cond_signal(&wait_signal);
-	sleep(0.1);
-	stream_wait = 0;
+	pthread_cond_signal(&b->wait_signal);
+	pthread_mutex_unlock(&b->next_mutex);
 
-	return 0;
+	return rc;
 }
 
 /******************************************************************************
- * Sends the reads to the fpga
+ * Sends the reads to the fpga, each unit with its own threshold. The pieces
+ * of a longer read are loaded like reads of their own, the host joins them.
  ******************************************************************************/
-int sendingReads(int mismatch, int double_units){
+int sendingReads(struct board_t *b){
 	 unsigned int j, i;
+	 char *send_buffer = b->send_buffer;
 
-	 unsigned int units = reads - 1; /* The FPGA counts starting with "0" */
+	 unsigned int units = b->reads - 1; /* The FPGA counts starting with "0" */
 
 	 double time0 = gettime(0);
 
 	 /* unit information */
 	 memcpy(send_buffer+16, &units, 2);
 
-	 if (double_units == 1){
-		 send_buffer[19] = 0x10;		//double read length
-	 } else {
-		 send_buffer[19] = 0x00;
-	 }
+	 /* no double read length, the fabric does not use double_reads */
+	 send_buffer[19] = 0x00;
 
 	 if (global_opt.positions == 1){
 	 	send_buffer[18] = 0x10;			//send positions
@@ -845,10 +2363,10 @@ int sendingReads(int mismatch, int double_units){
 	 i = 0;
 	 j = 0;
 
-	 for(j = 0; j < reads; j++) {
+	 for(j = 0; j < b->reads; j++) {
 		 if(j < 10) {
 			 /* control information */
-			 send_buffer[20 + (i * 136)] = mismatch;	/* max mismatches */
+			 send_buffer[20 + (i * 136)] = b->threshold[j];	/* max mismatches */
 			 if (global_opt.positions == 1){
 				 send_buffer[21 + (i * 136)] = 0x00;
 			 } else {
@@ -857,10 +2375,10 @@ int sendingReads(int mismatch, int double_units){
 			 send_buffer[22 + (i * 136)] = 0x08;		/* searching for this unit is active */
 			 send_buffer[23 + (i * 136)] = 0x00;
 
-			 memcpy(send_buffer + 24 + (i * 136), readmap + (j * 132), 132);
+			 memcpy(send_buffer + 24 + (i * 136), b->readmap + (j * 132), 132);
 		 } else {
 			 /* control information */
-			 send_buffer[16 + (i * 136)] = mismatch;	/* max mismatches */
+			 send_buffer[16 + (i * 136)] = b->threshold[j];	/* max mismatches */
 			 if (global_opt.positions == 1){
 			 	send_buffer[21 + (i * 136)] = 0x00;
 			 } else {
@@ -869,208 +2387,818 @@ int sendingReads(int mismatch, int double_units){
 			 send_buffer[18 + (i * 136)] = 0x08;		/* searching for this unit is active */
 			 send_buffer[19 + (i * 136)] = 0x00;
 
-			 memcpy(send_buffer + 20 + (i * 136), readmap + (j * 132), 132);
+			 memcpy(send_buffer + 20 + (i * 136), b->readmap + (j * 132), 132);
 		 }
 
 		 i++;
-		 if ((j == 9) || ((j == (reads - 1)) && (reads <= 10))) {
-			 sendData((136 * i) + 4, ctr_first_data, send_buffer, id);//max 10 reads per packet
-			 id++;
+		 if ((j == 9) || ((j == (b->reads - 1)) && (b->reads <= 10))) {
+			 sendData(&b->dev, (136 * i) + 4, ctr_first_data, send_buffer, b->id);//max 10 reads per packet
+			 b->id++;
 			 i = 0;
-		 } else if((i == 10) || (j == (reads - 1))) {
-			 sendData((136 * i), ctr_data, send_buffer, id);
-			 id++;
+		 } else if((i == 10) || (j == (b->reads - 1))) {
+			 sendData(&b->dev, (136 * i), ctr_data, send_buffer, b->id);
+			 b->id++;
 			 i = 0;
 		 }
 	 }
 	 for(i = 16; i < 51; i++) {
 		 send_buffer[i] = 0x00;
 	 }
-	 sendData(35, ctr_data, send_buffer, id);
-	 id++;
+	 sendData(&b->dev, 35, ctr_data, send_buffer, b->id);
+	 b->id++;
 
-	 func_time.send = func_time.send + gettime(time0);
+	 b->time.send = b->time.send + gettime(time0);
 
 	 return 0;
  }
 
 /******************************************************************************
- * Save results of one run in memory
+ * Loads the reads into the search engine on the CPU
+ ******************************************************************************/
+int loadingReadsCPU(struct board_t *b){
+
+	double time0 = gettime(0);
+
+	cpuLoadReads(b->readmap, b->threshold, b->reads, global_opt.positions);
+
+	b->time.send = b->time.send + gettime(time0);
+
+	return 0;
+}
+
+/******************************************************************************
+ * Searches one segment of the database on the CPU and writes the results,
+ * in several parts if they exceed the result memory
+ ******************************************************************************/
+int searchingCPU(struct board_t *b){
+	double rate, time1, time0 = gettime(0);
+
+	cpuSearch(dbmap + b->dbmapposition, (unsigned long) b->seqchars);
+
+	time1 = gettime(time0);
+	b->time.search = b->time.search + time1;
+
+	while (cpuResults(b->results, b->maxunits * 4000 * 4 * sizeof(char))) {
+		if (printResults(b) == -1) {
+			return -1;
+		}
+	}
+
+	rate = (b->seqchars * 4 / time1) / 1000000;
+	metricObserve(METRIC_SEGMENT_SECONDS, time1);
+	metricAdd(METRIC_STREAM_BYTES, b->seqchars);
+	b->time.txBandwidth = b->time.txBandwidth + rate;
+	b->time.streams++;
+
+	return 0;
+}
+
+/******************************************************************************
+ * Receives the results of one run into the blocks of the result writer, the
+ * frames are copied out of the ring as they arrive
  ******************************************************************************/
-int saveResults() {
+int saveResults(struct board_t *b) {
 	char ctr;
-	unsigned int i = 0, p = 0;
+	const char *data;
+	int length, offset;
+	unsigned int packetcount = 0;
 	double bandwidth;
-	int packetcount = 0, maxpacket = (maxunits * 4000 * 4 * sizeof(char))/BUF_SIZE;
+	struct resultblock_t *block;
 
 	double rcvtime, time0 = gettime(0);
 
-	sendControl(ctr_get_data, send_buffer, id);
-	id++;
+	block = fillingBlock(b, 1);
+
+	sendControl(&b->dev, ctr_get_data, b->send_buffer, b->id);
+	b->id++;
 
+	/* credits of the stream can precede the results, a lost packet can not */
 	do {
-		ctr = receive(BUF_SIZE, rec_buffer);
-	} while(ctr != ctr_data);
+		ctr = receiveFrame(&b->dev, &data, &length);
+		if (ctr == error) {
+			lostPacket(b, data);
+		}
+		if ((ctr != ctr_data) && (length != -1)) {
+			releaseFrame(&b->dev);
+		}
+	} while((ctr != ctr_data) && (ctr != error) && (length != -1));
 
-	if (ctr == ctr_data) {
-		p++;
-		memcpy(results, rec_buffer + 2, DATA_SIZE);
-		packetcount++;
-	} else {
+	if (ctr == error) {
+		return -1;
+	}
+	if (length == -1) {
 		cout << "Error: no results" << endl;
 		return -1;
 	}
 
-	ctr = receive(BUF_SIZE, rec_buffer);
-
+	/* the first frame carries a padding byte after the control code */
+	offset = 2;
 	while (ctr == ctr_data) {
-		memcpy(results + DATA_SIZE + (i * (DATA_SIZE+1)), rec_buffer + 1, DATA_SIZE+1);
+		if (length > offset) {
+			appendResults(b, &block, data + offset, (unsigned int) (length - offset));
+		}
+		releaseFrame(&b->dev);
 		packetcount++;
-		i++;
+		offset = 1;
 
-		ctr = receive(BUF_SIZE, rec_buffer);
-
-		if(packetcount == maxpacket){
-			return 0;
-		}
+		ctr = receiveFrame(&b->dev, &data, &length);
+	}
+	if (ctr == error) {
+		lostPacket(b, data);
+	}
+	if (length != -1) {
+		releaseFrame(&b->dev);
+	}
+	if (block->length > 0) {
+		queueBlock(b);
 	}
 
+	if (ctr == error) {
+		return -1;
+	}
 	if (ctr != ctr_finished_sending) {
 		cout << "error, finishing iteration" << endl;
 		return -1;
 	}
 
 	rcvtime = gettime(time0);
-	bandwidth = ((p * (REAL_DB_DATA * 8)) / rcvtime) / 1024 / 1024;
-	func_time.rxBandwidth = func_time.rxBandwidth + bandwidth;
+	bandwidth = ((packetcount * (REAL_DB_DATA * 8)) / rcvtime) / 1024 / 1024;
+	b->time.rxBandwidth = b->time.rxBandwidth + bandwidth;
+
+	b->time.rcv = b->time.rcv + rcvtime;
+	metricObserve(METRIC_DOWNLOAD_SECONDS, rcvtime);
+
+	return 0;
+}
+
+/******************************************************************************
+ * Writes results of one run from the result memory to the output file
+ ******************************************************************************/
+int printResults(struct board_t *b){
+	struct resultblock_t block;
+
+	block.data = b->results;
+	block.length = b->maxunits * 4000 * 4 * sizeof(char);
+	block.first = 1;
+	block.seqfirst = b->seqfirst;
+	block.seqlast = b->seqlast;
+	block.dbmapposition = b->dbmapposition;
 
-	func_time.rcv = func_time.rcv + rcvtime;
+	decodeBlock(b, &block);
 
 	return 0;
 }
 
 /******************************************************************************
- * Writes results of one run to output file
+ * Waits for a free block of the result writer and assigns it to the current
+ * segment; the block is handed over with queueBlock
+ ******************************************************************************/
+struct resultblock_t *fillingBlock(struct board_t *b, int first) {
+	struct resultblock_t *block;
+
+	pthread_mutex_lock(&b->result_mutex);
+	while (b->resulttail - b->resulthead == RESULT_BLOCKS) {
+		pthread_cond_wait(&b->decoded_signal, &b->result_mutex);
+	}
+	block = &b->resultblocks[b->resulttail % RESULT_BLOCKS];
+	pthread_mutex_unlock(&b->result_mutex);
+
+	block->length = 0;
+	block->first = first;
+	block->seqfirst = b->seqfirst;
+	block->seqlast = b->seqlast;
+	block->dbmapposition = b->dbmapposition;
+	return block;
+}
+
+void queueBlock(struct board_t *b) {
+
+	pthread_mutex_lock(&b->result_mutex);
+	b->resulttail++;
+	pthread_cond_signal(&b->queued_signal);
+	pthread_mutex_unlock(&b->result_mutex);
+}
+
+/******************************************************************************
+ * Copies the results of a frame into the block, a full block is queued and
+ * the rest goes into the next one
+ ******************************************************************************/
+void appendResults(struct board_t *b, struct resultblock_t **block, const char *data, unsigned int length) {
+	unsigned int n;
+
+	while (length > 0) {
+		n = RESULT_BLOCK - (*block)->length;
+		if (n > length) {
+			n = length;
+		}
+		memcpy((*block)->data + (*block)->length, data, n);
+		(*block)->length = (*block)->length + n;
+		data = data + n;
+		length = length - n;
+
+		if ((*block)->length == RESULT_BLOCK) {
+			queueBlock(b);
+			*block = fillingBlock(b, 0);
+		}
+	}
+}
+
+/******************************************************************************
+ * Waits until the writer decoded all queued blocks
+ ******************************************************************************/
+void waitResults(struct board_t *b) {
+
+	pthread_mutex_lock(&b->result_mutex);
+	while (b->resulthead != b->resulttail) {
+		pthread_cond_wait(&b->decoded_signal, &b->result_mutex);
+	}
+	pthread_mutex_unlock(&b->result_mutex);
+}
+
+/******************************************************************************
+ * Result writer thread, decodes the queued blocks in their order
+ ******************************************************************************/
+void *writeResults(void *board) {
+	struct board_t *b = (struct board_t*) board;
+	struct resultblock_t *block;
+
+	pthread_mutex_lock(&b->result_mutex);
+	while (1) {
+		if (b->resulthead == b->resulttail) {
+			if (b->resultquit) {
+				break;
+			}
+			pthread_cond_wait(&b->queued_signal, &b->result_mutex);
+			continue;
+		}
+		block = &b->resultblocks[b->resulthead % RESULT_BLOCKS];
+		pthread_mutex_unlock(&b->result_mutex);
+
+		decodeBlock(b, block);
+
+		pthread_mutex_lock(&b->result_mutex);
+		b->resulthead++;
+		pthread_cond_broadcast(&b->decoded_signal);
+	}
+	pthread_mutex_unlock(&b->result_mutex);
+
+	pthread_exit((void*) 0);
+}
+
+/******************************************************************************
+ * Decodes a block of results of its segment, the first block of a run starts
+ * with the first unit
  ******************************************************************************/
-int printResults(){
-  struct result_t {
-    uint16_t  location_cnt;
-    uint8_t   mismatches_min;
-    uint8_t   padding;
-    uint32_t  positions[0];
-  };
+void decodeBlock(struct board_t *b, const struct resultblock_t *block) {
+
+	if (block->first) {
+		b->unit = 0;
+		b->pending = 0;
+		b->partial = 0;
+	}
+	b->decoding = block;
+	decodeResults(b, block->data, block->length);
+}
 
+/******************************************************************************
+ * Decodes a part of the result memory. Each unit has a word with the number
+ * of positions and the least mismatches, followed by one word per position.
+ ******************************************************************************/
+void decodeResults(struct board_t *b, const char *data, unsigned int length){
   double time0 = gettime(0);
 
-  unsigned  k = 0;
-
-  for(unsigned  i = 0; i < reads; i++) {
-
-	  struct result_t const *const  res = (struct result_t*)(results + k*4);
-	  k++;
-
-	  if(res->location_cnt != 0) {
-		  readposcount[i] = readposcount[i] + res->location_cnt;
-		  if(global_opt.positions == 1) {
-			  for(unsigned  j = 0; j < res->location_cnt; j++) {
-				  fprintf(resultfile, "%s", indexlabel + (i * LABEL));
-				  if(global_opt.sam == 0){
-					  fprintf(resultfile, "\t%u \n", res->positions[j]-1);
-				  } else {
-					  fprintf(resultfile, "\t0 \t%s \t0 \t%u \t* \t* \t* \t* \t* \t* \t*\n", line, res->positions[j]-1);
-				  }
-			  }
-			  k += res->location_cnt;
-		  }
-		  positions = positions + res->location_cnt;
-		  if(res->mismatches_min < readbestmatch[i]){
-			  readbestmatch[i] = (int8_t) res->mismatches_min;
-		  }
-	  } else {
-		  if(readbestmismatch[i] > res->mismatches_min){
-			  readbestmismatch[i] = (int8_t) res->mismatches_min;
-		  }
+  // only state of the board, the boards decode at the same time
+  while((length > 0) && (b->unit < b->reads)) {
+	  unsigned  n = 4 - b->partial;
+	  if(n > length)  n = length;
+	  memcpy(b->word + b->partial, data, n);
+	  b->partial += n;
+	  data += n;
+	  length -= n;
+	  if(b->partial < 4)  break;
+	  b->partial = 0;
+
+	  if(b->pending > 0) {
+		  uint32_t  position;
+		  memcpy(&position, b->word, 4);
+		  if(writePosition(b, position))  b->kept++;
+		  if(--b->pending == 0)  finishEntry(b);
+		  continue;
+	  }
+
+	  memcpy(&b->count, b->word, 2);
+	  b->min = b->word[2];
+	  b->best = 8;
+	  b->kept = b->count;
+	  if((b->count != 0) && (global_opt.positions == 1)) {
+		  b->kept = 0;
+		  b->pending = b->count;
+		  continue;
 	  }
+	  finishEntry(b);
+  }
+
+  time0 = gettime(time0);
+  b->time.save = b->time.save + time0;
+  metricObserve(METRIC_FORMAT_SECONDS, time0);
+}
+
+/******************************************************************************
+ * Writes one position of the current unit. The position is mapped back to
+ * its sequence; hits across the end of the sequence or on a run of N are
+ * dropped, returns 0 for those. The piece of a longer read gives the start of
+ * the read, which is verified on the host. The hit is written for the read
+ * and all its duplicates and logged for the copies of later batches.
+ ******************************************************************************/
+int writePosition(struct board_t *b, uint32_t position){
+  // the units of one read are merged under its label
+  unsigned const  r = b->unitread[b->unit];
+  unsigned const  piece = b->unitpiece[b->unit] & ~PIECE_REVERSE;
+  unsigned const  reverse = (b->unitpiece[b->unit] & PIECE_REVERSE) != 0;
+  unsigned const  start = piece * b->readlength[r] / PIECES(b->readlength[r]);
+  unsigned long  offset = position - 1;
+  unsigned long const  segment = b->decoding->dbmapposition;
+  unsigned  lo = b->decoding->seqfirst, hi = b->decoding->seqlast;
+
+  if(offset < start)  return 0;
+  offset -= start;
+  unsigned long const  byte = segment + offset / 4;
+
+  while(hi - lo > 1) {
+	  unsigned const  mid = (lo + hi) / 2;
+	  if(seqtable[mid].offset <= byte)  lo = mid;
+	  else  hi = mid;
+  }
+  offset += 4 * (segment - seqtable[lo].offset);
+  if(offset + b->readlength[r] > seqtable[lo].bases)  return 0;
+  if(maskedHit(seqtable[lo].start + offset, b->readlength[r]))  return 0;
+  if(b->readlength[r] > UNIT_NUCS) {
+	  int const  mis = verifyHit(b, r, piece, reverse, offset, lo);
+	  if(mis < 0)  return 0;
+	  if(mis < b->best)  b->best = (uint8_t) mis;
   }
 
-  func_time.save = func_time.save + gettime(time0);
+  // the read, its duplicates and, from the cache, its copies in later batches
+  if(b->cached[r] != NULL)  logHit(b, r, lo, offset, reverse);
+  for(unsigned  c = r; c != NO_COPY; c = b->nextcopy[c]) {
+	  if(writeHit(b, c, lo, offset, reverse) == -1)  return 0;
+  }
+  return 1;
+}
+
+/******************************************************************************
+ * Writes the hit of read r at offset of sequence s. Returns -1 if the line
+ * could not be buffered.
+ ******************************************************************************/
+int writeHit(struct board_t *b, unsigned int r, unsigned int s, unsigned long offset, int reverse){
+  struct output_t * const  o = b->readout[r];
+
+  // reverse hits get the bases and qualities of the reverse strand
+  const char  *bases = b->sequence + (r * SEQUENCE);
+  const char  *quality = bases + MAX_NUCS + 1;
+  char  rev[SEQUENCE];
+  if(o->quality == 1 && reverse) {
+	  unsigned const  len = b->readlength[r];
+	  reverseComplement(bases, len, rev);
+	  rev[len] = 0;
+	  unsigned const  q = (quality[0] == 0)? 0 : len;
+	  for(unsigned  p = 0; p < q; p++)  rev[MAX_NUCS + 1 + p] = quality[q-1-p];
+	  rev[MAX_NUCS + 1 + q] = 0;
+	  bases = rev;
+	  quality = rev + MAX_NUCS + 1;
+  }
+
+  if(o->bam == 1){
+	  struct bamrecord_t  record;
+	  record.name = b->indexlabel + (r * LABEL);
+	  record.reference = s;
+	  record.position = offset;
+	  record.flag = reverse ? 16 : 0;
+	  record.length = b->readlength[r];
+	  record.bases = (o->quality == 1)? bases : NULL;
+	  record.quality = (o->quality == 1 && quality[0] != 0)? quality : NULL;
+	  return bamRecord(o->bamfile, &o->records[b->number], &record);
+  }
+
+  // same bytes as "%s\t%lu \t%c\n" or the SAM line, formatted in place
+  unsigned const  len = b->readlength[r];
+  unsigned const  head = 2 * s + (reverse != 0);
+  unsigned const  headlength = samheadstart[head + 1] - samheadstart[head];
+  struct textbuffer_t * const  text = &o->text[b->number];
+  char  *p = textReserve(text, b->labellength[r] + headlength + 2 * len + 64);
+  if(p == NULL)  return -1;
+  p = textCopySlot(p, b->indexlabel + (r * LABEL), b->labellength[r]);
+  if(o->sam == 0){
+	  *p++ = '\t';
+	  p = textDecimal(p, offset);
+	  if(strands == 1){
+		  p = textCopy(p, " \n", 2);
+	  } else {
+		  p = textCopy(p, reverse ? " \t-\n" : " \t+\n", 4);
+	  }
+  } else {
+	  p = textCopy(p, samhead + samheadstart[head], headlength);
+	  p = textDecimal(p, offset);
+	  if(o->quality == 0){
+		  p = textCopy(p, " \t* \t* \t* \t* \t* \t* \t*\n", 22);
+	  } else {
+		  p = textCopy(p, " \t* \t* \t* \t* \t* \t", 17);
+		  p = textCopy(p, bases, len);
+		  p = textCopy(p, " \t", 2);
+		  if(quality[0] == 0)  p = textCopy(p, "*", 1);
+		  else  p = textCopy(p, quality, len);
+		  *p++ = '\n';
+	  }
+  }
+  textCommit(text, p);
   return 0;
 }
 
 /******************************************************************************
- * Transforms read for the LUT-RAM
+ * Logs a hit of read r of the run-wide cache until the batch is finished
  ******************************************************************************/
-int transformread() {
-  unsigned const  MAX_NUCS = 64;
-  char* ptr;
-  double time0 = gettime(0);
+void logHit(struct board_t *b, unsigned int r, unsigned int s, uint64_t offset, int reverse){
+  if(b->hitcount == b->hitsize) {
+	  unsigned const  size = (b->hitsize == 0)? 4096 : 2 * b->hitsize;
+	  struct cachedhit_t * const  grown = (struct cachedhit_t*) realloc(b->hitlog, size * sizeof(struct cachedhit_t));
+	  if(grown == NULL) {
+		  fprintf(stderr, "\nError: allocating the hit log of board %u, copies of its reads lack hits\n", b->number);
+		  return;
+	  }
+	  b->hitlog = grown;
+	  b->hitsize = size;
+  }
+  struct cachedhit_t * const  h = &b->hitlog[b->hitcount++];
+  h->offset = offset;
+  h->sequence = s;
+  h->reverse = (uint16_t) reverse;
+  h->read = (uint16_t) r;
+}
+
+/******************************************************************************
+ * Verifies the hit of a piece of a longer read at offset of sequence s.
+ * Returns the mismatches of the whole read or -1 if they are too many or an
+ * earlier piece of the read reports the same hit.
+ ******************************************************************************/
+int verifyHit(struct board_t *b, unsigned int r, unsigned int piece, int reverse, uint64_t offset, unsigned int s){
+  unsigned const  len = b->readlength[r];
+  unsigned const  k = PIECES(len);
+  const char  *seq = b->sequence + (r * SEQUENCE);
+  const uint8_t  *text = (const uint8_t*) dbmap + seqtable[s].offset;
+  char  rev[MAX_NUCS];
+  unsigned  mis = 0, first = k;
+
+  if(reverse) {
+	  reverseComplement(seq, len, rev);
+	  seq = rev;
+  }
+
+  for(unsigned  j = 0; j < k; j++) {
+	  unsigned  m = 0;
+	  for(unsigned  p = j * len / k; p < (j+1) * len / k; p++) {
+		  uint64_t const  i = offset + p;
+		  unsigned const  base = (text[i / 4] >> (2 * (3 - (i & 3)))) & 3;
+		  if(!(seq[p] & 8) && (PACK_BASE(seq[p]) != base))  m++;
+	  }
+	  if((first == k) && (m <= b->threshold[b->unit]))  first = j;
+	  mis += m;
+  }
+
+  if((mis > b->readmismatch[r]) || (first != piece))  return -1;
+  return (int) mis;
+}
+
+/******************************************************************************
+ * Adds the current entry to the statistics of its read and moves to the next
+ * unit. The hits of a longer read count with the mismatches of the whole read.
+ ******************************************************************************/
+void finishEntry(struct board_t *b){
+  unsigned const  r = b->unitread[b->unit];
+  uint8_t const  best = (b->readlength[r] > UNIT_NUCS)? b->best : b->min;
+
+  if(b->kept != 0) {
+	  b->readposcount[r] = b->readposcount[r] + b->kept;
+	  if(best < b->readbestmatch[r]){
+		  b->readbestmatch[r] = (int8_t) best;
+	  }
+  } else {
+	  // only hits across sequences or on N, the read needs more mismatches elsewhere
+	  uint8_t  min = b->min;
+	  if((b->count != 0) && (min <= b->readmismatch[r]))  min = b->readmismatch[r] + 1;
+	  // the pieces of a longer read only give a bound for the whole read
+	  if(b->readlength[r] > UNIT_NUCS)  min = b->readmismatch[r] + 1;
+	  if(b->readbestmismatch[r] > min){
+		  b->readbestmismatch[r] = (int8_t) min;
+	  }
+  }
+  b->unit++;
+}
 
+/******************************************************************************
+ * Encodes a read of up to 64 bases in the bit-parallel layout of the LUT-RAM
+ ******************************************************************************/
+void encodeRead(const char *seq, unsigned int len, char *block) {
   // Generating table with LUT-information in order
-  unsigned  reads = 0;
-  while(reads < maxunits) {
-    switch(getc(readfile)) {
-    case EOF:
-      return  reads;
-    case '>': {
-      // Save Read Label and remove \n
-      fgets(indexlabel + (reads * LABEL), LABEL, readfile);
-      ptr = strchr((indexlabel + (reads * LABEL)), '\n');
-      *ptr = ' ';
-      // Scan Sequence
-      uint32_t  table[MAX_NUCS/2];
-      unsigned  len = 0;
-      unsigned  mis = 'A';
-      while(len < MAX_NUCS/2) {
-	int  c1 = getc(readfile);
-        if(c1 < 'A') {
-          table[len++] = 0;
-	  mis = c1;
-          break;
-        }
-	c1 = (c1 & 8)? 4 : PACK_BASE(c1);
-
-        int  c2 = getc(readfile);
-        if(c2 < 'A') {
-          table[len++] = LUT5_CFG[c1][4];
-	  mis = c2;
-          break;
-        }
-	c2 = (c2 & 8)? 4 : PACK_BASE(c2);
-        table[len++] = LUT5_CFG[c1][c2];
-      }
-      while(mis >= 'A')  mis = getc(readfile); // Consume extra bases
-      // check for read-specific mismatch count
-      if((mis != '/') || (fscanf(readfile, "%u", &mis) != 1))  mis = global_opt.mismatch;
-
-      // TODO:
-      //   Encode read-specific mismatch count -> currently ignored.
-      //   This value should probably be stated in the results for this read.
-
-      // Generating table with parallel Bits
-      // table_block[0..32], table_block[32] = 0
-      uint32_t *const  table_block = (uint32_t*)(readmap + (reads * 132));
-
-      uint32_t  msk = 1;
-      table_block[32] = 0;
-      for(signed  i = 32; --i >= 0;) {
-	uint32_t  entry = 0;
-	for(signed  k = len; --k >= 0;) {
-	  uint32_t const  b = table[k] & msk;
-	  entry |= (k-i > 0)? b >> (k-i) : b << (i-k);
-	}
-	table_block[i] = entry;   // TODO: htonl()
-	msk <<= 1;
-      }
-
-      reads++;
+  uint32_t  table[UNIT_NUCS/2];
+  unsigned  n = 0;
+  for(unsigned  p = 0; p < len; p += 2) {
+    int  c1 = (seq[p] & 8)? 4 : PACK_BASE(seq[p]);
+    int  c2 = 4;
+    if(p+1 < len)  c2 = (seq[p+1] & 8)? 4 : PACK_BASE(seq[p+1]);
+    table[n++] = LUT5_CFG[c1][c2];
+  }
+
+  // Generating table with parallel Bits
+  // table_block[0..32], table_block[32] = 0
+  uint32_t *const  table_block = (uint32_t*) block;
+
+  uint32_t  msk = 1;
+  table_block[32] = 0;
+  for(signed  i = 32; --i >= 0;) {
+    uint32_t  entry = 0;
+    for(signed  k = n; --k >= 0;) {
+      uint32_t const  b = table[k] & msk;
+      entry |= (k-i > 0)? b >> (k-i) : b << (i-k);
+    }
+    table_block[i] = entry;   // TODO: htonl()
+    msk <<= 1;
+  }
+}
+
+/******************************************************************************
+ * Reverse complement of a read, 'N' stays a wildcard
+ ******************************************************************************/
+void reverseComplement(const char *seq, unsigned int len, char *rev) {
+  for(unsigned  p = 0; p < len; p++) {
+    switch(seq[len-1-p] | 0x20) {
+    case 'a':  rev[p] = 'T';  break;
+    case 'c':  rev[p] = 'G';  break;
+    case 'g':  rev[p] = 'C';  break;
+    case 't':
+    case 'u':  rev[p] = 'A';  break;
+    default:   rev[p] = seq[len-1-p];
     }
-    default:
-      break;
+  }
+}
+
+/******************************************************************************
+ * Transforms the next read of the read file for the LUT-RAM, the forward read
+ * and with both strands the reverse complement. A read of more than 64 bases
+ * is split into pieces of about the same length, one unit each. Returns the
+ * number of units, 0 at the end of the file or -1 on errors, length gets the
+ * bases of the read, mismatch its threshold, sequence its bases and
+ * qualities and hash a hash of the units and the threshold.
+ ******************************************************************************/
+int transformread(struct output_t *o, char *label, char *map, uint16_t *length, uint8_t *mismatch, char *sequence, uint64_t *hash) {
+  struct seqrecord_t  record;
+
+  int const  rc = nextRecord(o->readfile, &record);
+  if(rc <= 0)  return  rc;
+
+  // Label is the header line with a blank instead of the line end
+  unsigned const  n = (record.namelength < LABEL - 2)? record.namelength : LABEL - 2;
+  memcpy(label, record.name, n);
+  label[n]   = ' ';
+  label[n+1] = 0;
+
+  // Extra bases are cut
+  unsigned const  len = (record.length < MAX_NUCS)? record.length : MAX_NUCS;
+
+  // A "/n" behind the bases replaces --mismatch for this read
+  *mismatch = (record.mismatch < 0)? o->mismatch : record.mismatch;
+  if(*mismatch > MAX_THRESHOLD)  *mismatch = MAX_THRESHOLD;
+
+  unsigned const  k = PIECES(len);
+  for(unsigned  j = 0; j < k; j++) {
+    encodeRead(record.bases + j * len / k, (j+1) * len / k - j * len / k, map + j * 132);
+  }
+  *length = (uint16_t) len;
+
+  memcpy(sequence, record.bases, len);
+  sequence[len] = 0;
+  if(record.quality != NULL) {
+    memcpy(sequence + MAX_NUCS + 1, record.quality, len);
+    sequence[MAX_NUCS + 1 + len] = 0;
+  } else {
+    sequence[MAX_NUCS + 1] = 0;
+  }
+
+  // Reverse complement in the following units
+  if(strands == 2) {
+    char  rev[MAX_NUCS];
+    reverseComplement(record.bases, len, rev);
+    for(unsigned  j = 0; j < k; j++) {
+      encodeRead(rev + j * len / k, (j+1) * len / k - j * len / k, map + (k + j) * 132);
     }
   }
-  func_time.create = func_time.create + gettime(time0);
 
-  return  reads;
+  // Reads with the same units, length and threshold have the same hits
+  uint64_t  h = len | (uint64_t) *mismatch << 16;
+  for(unsigned  i = 0; i < k * 132; i += 4) {
+    uint32_t  word;
+    memcpy(&word, map + i, 4);
+    h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+    h = h ^ (h >> 29);
+  }
+  *hash = h;
+
+  return  k * strands;
+}
+
+/******************************************************************************
+ * Thread encoding the reads ahead into the read queue while the boards search.
+ * At the end of a read file the daemon goes on with the reads of the next
+ * queued job in the same batches; without one the boards take the reads left
+ * in partly filled batches.
+ ******************************************************************************/
+void *encodeReads(void *arg) {
+	struct output_t *o = (struct output_t*) arg;
+	unsigned long encoded = 0;
+	unsigned int slot;
+	int units, finished;
+
+	double time0 = gettime(0);
+
+	if (o == NULL) {
+		o = nextOutput(1);
+	}
+
+	while (o != NULL) {
+		pthread_mutex_lock(&readqueue.mutex);
+		while (readqueue.count == readqueue.size) {
+			pthread_cond_wait(&readqueue.emptied, &readqueue.mutex);
+		}
+		slot = (readqueue.head + readqueue.count) % readqueue.size;
+		pthread_mutex_unlock(&readqueue.mutex);
+
+		/* the slot is only visible to the boards after count is raised */
+		units = transformread(o, readqueue.indexlabel + (slot * LABEL), readqueue.readmap + (slot * strands * MAX_PIECES * 132),
+				readqueue.readlength + slot, readqueue.readmismatch + slot, readqueue.sequence + (slot * SEQUENCE),
+				readqueue.readhash + slot);
+
+		if (units > 0) {
+			readqueue.readout[slot] = o;
+			encoded++;
+
+			pthread_mutex_lock(&readqueue.mutex);
+			readqueue.count++;
+			pthread_cond_broadcast(&readqueue.filled);
+			pthread_mutex_unlock(&readqueue.mutex);
+			continue;
+		}
+
+		/* a damaged file ends the reads early, the last read may already be written */
+		pthread_mutex_lock(&output_mutex);
+		o->encoded = encoded;
+		o->error = (units < 0);
+		o->complete = 1;
+		finished = (o->written == o->encoded) && (o->job.id != 0);
+		pthread_mutex_unlock(&output_mutex);
+		if (finished) {
+			finishOutput(o);
+		}
+		encoded = 0;
+
+		o = nextOutput(0);
+		if (o == NULL) {
+			pthread_mutex_lock(&readqueue.mutex);
+			readqueue.drained = 1;
+			pthread_cond_broadcast(&readqueue.filled);
+			pthread_mutex_unlock(&readqueue.mutex);
+
+			o = nextOutput(1);
+			if (o != NULL) {
+				pthread_mutex_lock(&readqueue.mutex);
+				readqueue.drained = 0;
+				pthread_mutex_unlock(&readqueue.mutex);
+			}
+		}
+	}
+
+	pthread_mutex_lock(&readqueue.mutex);
+	readqueue.finished = 1;
+	pthread_cond_broadcast(&readqueue.filled);
+	pthread_mutex_unlock(&readqueue.mutex);
+
+	readqueue.encode = gettime(time0);
+
+	pthread_exit((void*) 0);
+}
+
+/******************************************************************************
+ * Takes the next batch of reads for the units of a board, returns the number
+ * of units, 0 at the end. A batch of copies of reads searched before needs no
+ * units and is finished at once.
+ ******************************************************************************/
+int takeReads(struct board_t *b) {
+	int units;
+
+	while (((units = fillBatch(b)) == 0) && (b->readcount > 0)) {
+		finishBatch(b);
+	}
+	return units;
+}
+
+/******************************************************************************
+ * Fills the batch of a board from the read queue. Waits until the batch is
+ * full or no reads follow for now and returns the number of units. A read
+ * with the same units as a read of the batch is taken without units and gets
+ * the hits of that read, a copy of a read of an earlier batch gets the hits
+ * from the run-wide cache.
+ ******************************************************************************/
+int fillBatch(struct board_t *b) {
+	unsigned int n, j, i, slot, o, units = 0, pieces;
+	struct cachedread_t *e;
+	uint64_t hash;
+	int found;
+
+	double time0 = gettime(0);
+
+	pthread_mutex_lock(&readqueue.mutex);
+	while (((readqueue.count == 0) || ((readqueue.count < b->readslots) && (readqueue.count < readqueue.size) &&
+			(readqueue.drained == 0))) && (readqueue.finished == 0)) {
+		pthread_cond_wait(&readqueue.filled, &readqueue.mutex);
+	}
+
+	/* the table holds read + 1 of the loaded reads and their last duplicate << 16, 0 is empty */
+	memset(b->copytable, 0, (b->copymask + 1) * sizeof(uint32_t));
+
+	for (n = 0; (n < readqueue.count) && (n < b->readslots); n++) {
+		slot = (readqueue.head + n) % readqueue.size;
+		pieces = strands * PIECES(readqueue.readlength[slot]);
+
+		/* a duplicate of a loaded read needs no units, the slots of the batch stay in the queue */
+		hash = readqueue.readhash[slot];
+		for (i = hash & b->copymask; b->copytable[i] != 0; i = (i + 1) & b->copymask) {
+			o = (readqueue.head + (b->copytable[i] & 0xFFFF) - 1) % readqueue.size;
+			if ((readqueue.readhash[o] == hash) && (readqueue.readlength[o] == readqueue.readlength[slot]) &&
+				(readqueue.readmismatch[o] == readqueue.readmismatch[slot]) &&
+				(memcmp(readqueue.readmap + (o * strands * MAX_PIECES * 132),
+						readqueue.readmap + (slot * strands * MAX_PIECES * 132), pieces * 132) == 0)) {
+				break;
+			}
+		}
+		e = NULL;
+		found = 0;
+		if (b->copytable[i] == 0) {
+			e = cacheTake(hash, readqueue.readlength[slot], readqueue.readmismatch[slot],
+						  readqueue.sequence + (slot * SEQUENCE), units + pieces <= b->maxunits, &found);
+		}
+		if (found) {
+			b->original[n] = CACHED;
+		} else if (b->copytable[i] == 0) {
+			if (units + pieces > b->maxunits) {
+				break;
+			}
+			b->copytable[i] = (n << 16) | (n + 1);
+			b->original[n] = n;
+		} else {
+			/* appended to the list of the original */
+			b->original[n] = (b->copytable[i] & 0xFFFF) - 1;
+			b->nextcopy[b->copytable[i] >> 16] = n;
+			b->copytable[i] = (n << 16) | (b->copytable[i] & 0xFFFF);
+		}
+		b->nextcopy[n] = NO_COPY;
+		b->cached[n] = e;
+
+		memcpy(b->indexlabel + (n * LABEL), readqueue.indexlabel + (slot * LABEL), LABEL);
+		b->labellength[n] = strlen(b->indexlabel + (n * LABEL));
+		memcpy(b->sequence + (n * SEQUENCE), readqueue.sequence + (slot * SEQUENCE), SEQUENCE);
+		b->readlength[n] = readqueue.readlength[slot];
+		b->readmismatch[n] = readqueue.readmismatch[slot];
+		b->readout[n] = readqueue.readout[slot];
+		b->readout[n]->reads++;
+		if (b->original[n] != n) {
+			duplicates++;
+			b->readout[n]->duplicates++;
+			continue;
+		}
+
+		/* forward pieces, then the pieces of the reverse complement */
+		memcpy(b->readmap + (units * 132), readqueue.readmap + (slot * strands * MAX_PIECES * 132), pieces * 132);
+		for (j = 0; j < pieces; j++) {
+			b->unitread[units + j] = n;
+			b->unitpiece[units + j] = (j < pieces / strands) ? j : (j - pieces / strands) | PIECE_REVERSE;
+			b->threshold[units + j] = b->readmismatch[n] / (pieces / strands);
+		}
+		units = units + pieces;
+	}
+	readqueue.head = (readqueue.head + n) % readqueue.size;
+	readqueue.count = readqueue.count - n;
+	maxreads = maxreads + n;
+	if (units > 0) {
+		batches++;
+		loadedunits = loadedunits + units;
+		batchunits = batchunits + b->maxunits;
+	}
+
+	pthread_cond_signal(&readqueue.emptied);
+	pthread_mutex_unlock(&readqueue.mutex);
+
+	b->readcount = n;
+	b->time.create = b->time.create + gettime(time0);
+
+	return units;
 }
 
 /******************************************************************************
@@ -1080,7 +3208,7 @@ int transformread() {
 int readingOptions(int argc, char** argv) {
 
 	int opt;
-	char *output;
+	char *output = NULL;
 
 	/* Initialize global options */
 	global_opt.databasename = NULL;
@@ -1090,12 +3218,19 @@ int readingOptions(int argc, char** argv) {
 	global_opt.transform_only = 0;
 	global_opt.transform = 0;
 	global_opt.output = NULL;
-	global_opt.unmapoutput = NULL;
-	global_opt.mapoutput = NULL;
 	global_opt.sam = 0;
 	global_opt.map = 0;
 	global_opt.status = 0;
 	global_opt.positions = 1;
+	global_opt.cpu = 0;
+	global_opt.threads = 0;
+	global_opt.reverse = 0;
+	global_opt.splitdb = 0;
+	global_opt.tx = TX_MMSG;
+	global_opt.whole = 0;
+	global_opt.quality = 0;
+	global_opt.bam = 0;
+	global_opt.socketname = NULL;
 
 	while ((opt=getopt_long(argc, argv, main_sopts, main_lopts, NULL)) != -1) {
 		switch(opt) {
@@ -1140,12 +3275,76 @@ int readingOptions(int argc, char** argv) {
 	 			global_opt.positions = 1;
 	 			break;
 
+	 		case 'c':
+	 			global_opt.cpu = 1;
+	 			global_opt.threads = atoi(optarg);
+	 			break;
+
+	 		case 'r':
+	 			global_opt.reverse = 1;
+	 			break;
+
+	 		case 'x':
+	 			global_opt.splitdb = 1;
+	 			break;
+
+	 		case 'T':
+	 			if (strcmp(optarg, "copy") == 0) {
+	 				global_opt.tx = TX_COPY;
+	 			} else if (strcmp(optarg, "mmsg") == 0) {
+	 				global_opt.tx = TX_MMSG;
+	 			} else if (strcmp(optarg, "ring") == 0) {
+	 				global_opt.tx = TX_RING;
+	 			} else {
+	 				fprintf(stderr, "\nError: unknown transmit path %s\n", optarg);
+	 				print_help();
+	 				return -1;
+	 			}
+	 			break;
+
+	 		case 'w':
+	 			global_opt.whole = 1;
+	 			break;
+
+	 		case 'Q':
+	 			global_opt.quality = 1;
+	 			break;
+
+	 		case 'B':
+	 			global_opt.bam = 1;
+	 			break;
+
+	 		case 'D':
+	 			global_opt.socketname = optarg;
+	 			break;
+
+	 		case 'P':
+	 			global_opt.pin = 1;
+	 			break;
+
+	 		case 'M':
+	 			global_opt.metricsname = optarg;
+	 			break;
+
+	 		case 'L':
+	 			global_opt.metricsaddress = optarg;
+	 			break;
+
+	 		case 'R':
+	 			global_opt.tracename = optarg;
+	 			break;
+
 			default:
 	 			print_help();
 	 			return -1;
 	 	}
 	}
 
+	/* bases and qualities are only written into SAM and BAM */
+	if ((global_opt.sam == 0) && (global_opt.bam == 0)) {
+		global_opt.quality = 0;
+	}
+
 	if((global_opt.databasename == NULL) and (global_opt.bindbname == NULL)){
 		printf("No input files specified\n");
 	 	print_help();
@@ -1157,26 +3356,31 @@ int readingOptions(int argc, char** argv) {
 	/* sets the name for the binary database if database name is given*/
 	if (global_opt.transform == 1) {
 		global_opt.bindbname = (char*) malloc(strlen(global_opt.databasename)+8);
-		memcpy(global_opt.bindbname, global_opt.databasename, strlen(global_opt.databasename));
+		strcpy(global_opt.bindbname, global_opt.databasename);
 		suffix = strchr(global_opt.bindbname, '.');
 		if (suffix == NULL) {
-			strcpy(suffix, ".bindb");
+			strcat(global_opt.bindbname, ".bindb");
 		} else {
 			while (suffix != NULL){
 				oldsuffix = suffix;
 				suffix = strchr(suffix+1, '.');
 			}
+			/* db.fa.gz gets the names of db.fa */
+			if ((strcmp(oldsuffix, ".gz") == 0) && (oldsuffix != strchr(global_opt.bindbname, '.'))) {
+				*oldsuffix = 0;
+				oldsuffix = strrchr(global_opt.bindbname, '.');
+			}
 			strcpy(oldsuffix, ".bindb");
 		}
 	}
 
 
 	global_opt.infodbname= (char*) malloc(strlen(global_opt.bindbname)+8);
-	memcpy(global_opt.infodbname, global_opt.bindbname, strlen(global_opt.bindbname));
+	strcpy(global_opt.infodbname, global_opt.bindbname);
 
 	suffix = strchr(global_opt.infodbname, '.');
 	if (suffix == NULL) {
-		strcpy(suffix, ".bindb");
+		strcat(global_opt.infodbname, ".dbinfo");
 	} else {
 		while (suffix != NULL){
 			oldsuffix = suffix;
@@ -1185,6 +3389,10 @@ int readingOptions(int argc, char** argv) {
 		strcpy(oldsuffix, ".dbinfo");
 	}
 
+	global_opt.indexname = (char*) malloc(strlen(global_opt.infodbname)+1);
+	strcpy(global_opt.indexname, global_opt.infodbname);
+	strcpy(global_opt.indexname + strlen(global_opt.indexname) - strlen(".dbinfo"), ".dbidx");
+
 
 	if((global_opt.transform_only == 1) and (global_opt.transform == 0)){
 		printf("FASTA Database required\n");
@@ -1192,29 +3400,14 @@ int readingOptions(int argc, char** argv) {
 		return -1;
 	}
 
-	if (global_opt.transform_only != 1) {
+	/* the jobs of the daemon bring their own output */
+	if ((global_opt.transform_only != 1) && (global_opt.socketname == NULL)) {
 		if(output == NULL){
 			printf("No output file specified\n");
 			print_help();
 			return -1;
-		} else {
-			global_opt.output = (char*) malloc(strlen(output)+4);
-			memcpy(global_opt.output, output, strlen(output));
-
-			if(global_opt.sam == 0){
-				strcat(global_opt.output, ".pam");
-			} else {
-				strcat(global_opt.output, ".sam");
-			}
-
-			global_opt.mapoutput = (char*) malloc(strlen(output)+4);
-			memcpy(global_opt.mapoutput, output, strlen(output));
-			strcat(global_opt.mapoutput, ".map");
-
-			global_opt.unmapoutput = (char*) malloc(strlen(output)+6);
-			memcpy(global_opt.unmapoutput, output, strlen(output));
-			strcat(global_opt.unmapoutput, ".unmap");
 		}
+		global_opt.output = output;
 	}
 
 	return 0;
@@ -1238,5 +3431,17 @@ void print_help(){
  	printf("\t--sam \t\t-s \t \tsave output in SAM-format (default: no)\n");
  	printf("\t--unmap \t-u \t \tcreate map and unmap files (default: no)\n");
  	printf("\t--status \t-i	\tprint performance info (default: no)\n");
+ 	printf("\t--cpu \t\t-c [int] search on the host CPU with n threads (0: all cores)\n");
+ 	printf("\t--reverse \t-r \t\tsearch both strands of the database (default: no)\n");
+ 	printf("\t--splitdb \t-x \t\tsplit the database between the boards (default: split reads)\n");
+ 	printf("\t--tx \t\t-T <path> \ttransmit path of the database: copy, mmsg, ring (default: mmsg)\n");
+ 	printf("\t--whole \t-w \t\tstream all sequences as one text (default: one per segment)\n");
+ 	printf("\t--quality \t-Q \t\twrite bases and qualities of the reads into SAM or BAM (default: no)\n");
+ 	printf("\t--bam \t\t-B \t\tsave output in BAM-format (default: no)\n");
+ 	printf("\t--daemon \t-D <socket> \ttake the jobs of fpga-client on a UNIX socket\n");
+ 	printf("\t--pin \t\t-P \t\tcopy the database into locked 2 MB pages (default: map the file)\n");
+ 	printf("\t--metrics \t-M <filename> \twrite the metrics of the run as JSON\n");
+ 	printf("\t--metrics-listen -L <address> \tserve the metrics in Prometheus format on [host:]port or a socket path\n");
+ 	printf("\t--trace \t-R <filename> \trecord the frames of the boards as pcapng\n");
  	printf("\t--help \t\t-h \t\tprint this usage message\n");
  }
@@ -0,0 +1,322 @@
+/*
+    metrics.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Metrics of the search. The boards add to counters and histograms with
+    fixed buckets under one mutex; metricsJson() writes them at the end of
+    a run and the thread of metricsServe() answers every HTTP request on its
+    socket with the current values in the Prometheus text format, so a long
+    run or the daemon can be scraped by a dashboard.
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "header/metrics.h"
+#include "header/sockserver.h"
+
+#define BUCKETS		12
+#define PREFIX		"fpga_align_"
+
+struct counter_t {
+	const char *name;
+	const char *help;
+};
+
+struct histogram_t {
+	const char *name;
+	const char *help;
+	double bounds[BUCKETS];		/* upper bounds, the last is +Inf */
+};
+
+static const struct counter_t counters[METRIC_COUNTERS] = {
+	{ "stream_bytes_total", "Database bytes searched" },
+	{ "stream_packets_total", "Database packets sent to the boards" },
+	{ "overflows_total", "Overflows of the result memory" },
+	{ "reads_total", "Reads with their results written" },
+	{ "mapped_reads_total", "Reads with at least one hit" },
+};
+
+/* bounds behind the last one of a histogram are 0 */
+static const struct histogram_t histograms[METRIC_HISTOGRAMS] = {
+	{ "segment_seconds", "Stream or CPU search of one segment",
+		{ 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10, 50, 100 } },
+	{ "credit_bytes", "Free bytes of the text FIFO announced by the board",
+		{ 1024, 2048, 4096, 8192, 16384, 32768, 49152, 65535 } },
+	{ "pause_seconds", "Stream paused to download the results after an overflow",
+		{ 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1 } },
+	{ "download_seconds", "Download of the results of a run",
+		{ 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1 } },
+	{ "read_hits", "Positions found for one read",
+		{ 0, 1, 2, 5, 10, 50, 100, 1000, 10000, 65535 } },
+	{ "format_seconds", "Decoding and writing of one block of results",
+		{ 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1 } },
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	double counter[METRIC_COUNTERS];
+	double sum[METRIC_HISTOGRAMS];
+	unsigned long count[METRIC_HISTOGRAMS][BUCKETS];
+
+	struct sockserver_t sock;
+	char path[sizeof(((struct sockaddr_un*) 0)->sun_path)];
+	pthread_t server;
+	int serving;
+} metrics = { PTHREAD_MUTEX_INITIALIZER, { 0 }, { 0 }, { { 0 } }, { -1 }, "", 0, 0 };
+
+/* buckets of a histogram, up to the first bound that is not larger */
+static unsigned int buckets(const struct histogram_t *h) {
+	unsigned int i;
+
+	for (i = 1; (i < BUCKETS - 1) && (h->bounds[i] > h->bounds[i-1]); i++);
+	return i + 1;
+}
+
+void metricAdd(unsigned int counter, double value) {
+	pthread_mutex_lock(&metrics.mutex);
+	metrics.counter[counter] = metrics.counter[counter] + value;
+	pthread_mutex_unlock(&metrics.mutex);
+}
+
+void metricObserve(unsigned int histogram, double value) {
+	const struct histogram_t *h = &histograms[histogram];
+	unsigned int i, n = buckets(h);
+
+	for (i = 0; (i < n - 1) && (value > h->bounds[i]); i++);
+
+	pthread_mutex_lock(&metrics.mutex);
+	metrics.sum[histogram] = metrics.sum[histogram] + value;
+	metrics.count[histogram][i]++;
+	pthread_mutex_unlock(&metrics.mutex);
+}
+
+void metricsReset() {
+	pthread_mutex_lock(&metrics.mutex);
+	memset(metrics.counter, 0, sizeof(metrics.counter));
+	memset(metrics.sum, 0, sizeof(metrics.sum));
+	memset(metrics.count, 0, sizeof(metrics.count));
+	pthread_mutex_unlock(&metrics.mutex);
+}
+
+/* all metrics in the Prometheus text format, the buckets are cumulative */
+static void writePrometheus(FILE *f) {
+	unsigned int m, i, n;
+	unsigned long total;
+
+	pthread_mutex_lock(&metrics.mutex);
+	for (m = 0; m < METRIC_COUNTERS; m++) {
+		fprintf(f, "# HELP " PREFIX "%s %s\n", counters[m].name, counters[m].help);
+		fprintf(f, "# TYPE " PREFIX "%s counter\n", counters[m].name);
+		fprintf(f, PREFIX "%s %.0f\n", counters[m].name, metrics.counter[m]);
+	}
+	for (m = 0; m < METRIC_HISTOGRAMS; m++) {
+		n = buckets(&histograms[m]);
+		fprintf(f, "# HELP " PREFIX "%s %s\n", histograms[m].name, histograms[m].help);
+		fprintf(f, "# TYPE " PREFIX "%s histogram\n", histograms[m].name);
+		total = 0;
+		for (i = 0; i < n; i++) {
+			total = total + metrics.count[m][i];
+			if (i < n - 1) {
+				fprintf(f, PREFIX "%s_bucket{le=\"%g\"} %lu\n", histograms[m].name, histograms[m].bounds[i], total);
+			} else {
+				fprintf(f, PREFIX "%s_bucket{le=\"+Inf\"} %lu\n", histograms[m].name, total);
+			}
+		}
+		fprintf(f, PREFIX "%s_sum %g\n", histograms[m].name, metrics.sum[m]);
+		fprintf(f, PREFIX "%s_count %lu\n", histograms[m].name, total);
+	}
+	pthread_mutex_unlock(&metrics.mutex);
+}
+
+/******************************************************************************
+ * Writes the metrics of the run as JSON to filename, the buckets of the
+ * histograms with their own counts and "le" null for the last one
+ ******************************************************************************/
+int metricsJson(const char *filename) {
+	unsigned int m, i, n;
+	unsigned long total;
+	FILE *f;
+
+	f = fopen(filename, "w");
+	if (f == NULL) {
+		fprintf(stderr, "\nError: can not create the metrics file %s\n", filename);
+		return -1;
+	}
+
+	pthread_mutex_lock(&metrics.mutex);
+	fprintf(f, "{\n  \"counters\": {\n");
+	for (m = 0; m < METRIC_COUNTERS; m++) {
+		fprintf(f, "    \"%s\": %.0f%s\n", counters[m].name, metrics.counter[m], (m < METRIC_COUNTERS - 1) ? "," : "");
+	}
+	fprintf(f, "  },\n  \"histograms\": {\n");
+	for (m = 0; m < METRIC_HISTOGRAMS; m++) {
+		n = buckets(&histograms[m]);
+		total = 0;
+		fprintf(f, "    \"%s\": {\n      \"buckets\": [", histograms[m].name);
+		for (i = 0; i < n; i++) {
+			total = total + metrics.count[m][i];
+			if (i < n - 1) {
+				fprintf(f, "{\"le\": %g, \"count\": %lu}, ", histograms[m].bounds[i], metrics.count[m][i]);
+			} else {
+				fprintf(f, "{\"le\": null, \"count\": %lu}", metrics.count[m][i]);
+			}
+		}
+		fprintf(f, "],\n      \"count\": %lu,\n      \"sum\": %g\n    }%s\n", total, metrics.sum[m],
+				(m < METRIC_HISTOGRAMS - 1) ? "," : "");
+	}
+	fprintf(f, "  }\n}\n");
+	pthread_mutex_unlock(&metrics.mutex);
+
+	if (fclose(f) != 0) {
+		fprintf(stderr, "\nError: writing the metrics file %s\n", filename);
+		return -1;
+	}
+	return 0;
+}
+
+/* the request of a scrape ends with an empty line */
+static int completeHeader(char *data, size_t length) {
+	return (strstr(data, "\r\n\r\n") != NULL) || (strstr(data, "\n\n") != NULL);
+}
+
+/* every request is answered with the metrics whatever path it asks for */
+static void answerScrape(void *unused, int fd, char *request) {
+	char header[128], *body = NULL;
+	size_t size = 0;
+	FILE *f;
+
+	f = open_memstream(&body, &size);
+	if (f != NULL) {
+		writePrometheus(f);
+		fclose(f);
+		snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+				 "Content-Length: %lu\r\n\r\n", (unsigned long) size);
+		sockReply(fd, header, strlen(header));
+		sockReply(fd, body, size);
+		free(body);
+	}
+	close(fd);
+}
+
+/******************************************************************************
+ * Thread answering the scrapes, a request has to arrive within SOCK_TIMEOUT
+ * seconds
+ ******************************************************************************/
+static void *serveMetrics(void *unused) {
+	sockServe(&metrics.sock);
+	return NULL;
+}
+
+/******************************************************************************
+ * Serves the metrics on address until metricsStop: a path with a '/' is a
+ * UNIX domain socket, otherwise [host:]port a TCP port of host, by default
+ * of 127.0.0.1
+ ******************************************************************************/
+int metricsServe(const char *address) {
+	struct sockaddr_in inet;
+	char host[64] = "127.0.0.1";
+	const char *port;
+	int on = 1;
+
+	if (strchr(address, '/') != NULL) {
+		metrics.sock.listen = sockUnix(address, 0, 16);
+		if (metrics.sock.listen < 0) {
+			return -1;
+		}
+		strcpy(metrics.path, address);
+	} else {
+		port = strrchr(address, ':');
+		if (port != NULL) {
+			if ((port > address) && (port - address < (long) sizeof(host))) {
+				memcpy(host, address, port - address);
+				host[port - address] = 0;
+			}
+			port++;
+		} else {
+			port = address;
+		}
+		memset(&inet, 0, sizeof(inet));
+		inet.sin_family = AF_INET;
+		inet.sin_port = htons((uint16_t) atoi(port));
+		if ((atoi(port) <= 0) || (atoi(port) > 65535) || (inet_pton(AF_INET, host, &inet.sin_addr) != 1)) {
+			fprintf(stderr, "\nError: invalid metrics address %s\n", address);
+			return -1;
+		}
+
+		metrics.sock.listen = socket(AF_INET, SOCK_STREAM, 0);
+		if (metrics.sock.listen >= 0) {
+			setsockopt(metrics.sock.listen, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+			if ((bind(metrics.sock.listen, (struct sockaddr*) &inet, sizeof(inet)) == -1) ||
+				(listen(metrics.sock.listen, 16) == -1)) {
+				close(metrics.sock.listen);
+				metrics.sock.listen = -1;
+			}
+		}
+		if (metrics.sock.listen < 0) {
+			fprintf(stderr, "\nError: can not serve the metrics on %s\n", address);
+			return -1;
+		}
+	}
+
+	metrics.sock.complete = completeHeader;
+	metrics.sock.take = answerScrape;
+	if (pthread_create(&metrics.server, NULL, serveMetrics, NULL) != 0) {
+		fprintf(stderr, "\nError: starting the metrics server on %s\n", address);
+		metricsStop();
+		return -1;
+	}
+	metrics.serving = 1;
+	return 0;
+}
+
+void metricsStop() {
+	if (metrics.sock.listen < 0) {
+		return;
+	}
+
+	shutdown(metrics.sock.listen, SHUT_RDWR);
+	if (metrics.serving) {
+		pthread_join(metrics.server, NULL);
+		metrics.serving = 0;
+	}
+	close(metrics.sock.listen);
+	metrics.sock.listen = -1;
+	if (metrics.path[0] != 0) {
+		unlink(metrics.path);
+	}
+	metrics.path[0] = 0;
+}
@@ -0,0 +1,207 @@
+/*
+    readcache.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Run-wide table of the searched reads and their hits. The first copy of
+    a read gets an entry when its batch is taken and the hits when its
+    batch is finished; every later copy finds the entry by the hash of the
+    read, its length, threshold and bases and is written from the hits
+    without units of its own. The entries and their hits are limited to
+    CACHE_MEMORY bytes: when they are full, finished entries that no taken
+    batch refers to are dropped, and without such entries no new reads are
+    added until the batches are finished.
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "header/readcache.h"
+
+static struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t done_signal;
+	struct cachedread_t **table;	/* open addressing, NULL is empty */
+	unsigned int mask, count;
+	unsigned int idle;				/* finished entries without users */
+	size_t bytes;
+} cache = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, 0, 0, 0, 0 };
+
+static void place(struct cachedread_t **table, unsigned int mask, struct cachedread_t *e) {
+	unsigned int i;
+
+	for (i = (unsigned int) e->hash & mask; table[i] != NULL; i = (i + 1) & mask);
+	table[i] = e;
+}
+
+/* rebuilds the table with size slots and without the dropped entries */
+static int rebuild(unsigned int size, int drop) {
+	struct cachedread_t **table, *e;
+	unsigned int i;
+
+	table = (struct cachedread_t**) calloc(size, sizeof(struct cachedread_t*));
+	if (table == NULL) {
+		return -1;
+	}
+	cache.count = 0;
+	for (i = 0; (cache.table != NULL) && (i <= cache.mask); i++) {
+		e = cache.table[i];
+		if (e == NULL) {
+			continue;
+		}
+		if (drop && e->done && (e->users == 0)) {
+			cache.bytes = cache.bytes - sizeof(struct cachedread_t) - e->length - e->hits * sizeof(struct cachedhit_t);
+			free(e->hit);
+			free(e);
+			cache.idle--;
+			continue;
+		}
+		place(table, size - 1, e);
+		cache.count++;
+	}
+	free(cache.table);
+	cache.table = table;
+	cache.mask = size - 1;
+	return 0;
+}
+
+/******************************************************************************
+ * Finds the entry of a read, found is 1, or with add adds one for the read
+ * that is searched now, found is 0. Both count as a user of the entry until
+ * cacheRelease. Returns NULL if the read is not cached and is not added.
+ ******************************************************************************/
+struct cachedread_t *cacheTake(uint64_t hash, unsigned int length, unsigned int mismatch, const char *bases, int add, int *found) {
+	struct cachedread_t *e;
+	unsigned int i;
+
+	pthread_mutex_lock(&cache.mutex);
+	*found = 0;
+	for (i = (unsigned int) hash & cache.mask; (cache.table != NULL) && (cache.table[i] != NULL); i = (i + 1) & cache.mask) {
+		e = cache.table[i];
+		if ((e->hash == hash) && (e->length == length) && (e->mismatch == mismatch) && (memcmp(e->bases, bases, length) == 0)) {
+			if (e->done && (e->users == 0)) {
+				cache.idle--;
+			}
+			e->users++;
+			*found = 1;
+			pthread_mutex_unlock(&cache.mutex);
+			return e;
+		}
+	}
+
+	if (add == 0) {
+		pthread_mutex_unlock(&cache.mutex);
+		return NULL;
+	}
+	if ((cache.bytes >= CACHE_MEMORY) && (cache.idle > 0) && (rebuild(cache.mask + 1, 1) == -1)) {
+		pthread_mutex_unlock(&cache.mutex);
+		return NULL;
+	}
+	if ((cache.table == NULL) || (2 * (cache.count + 1) > cache.mask + 1)) {
+		if (rebuild((cache.table == NULL) ? 4096 : 2 * (cache.mask + 1), 0) == -1) {
+			pthread_mutex_unlock(&cache.mutex);
+			return NULL;
+		}
+	}
+	e = NULL;
+	if (cache.bytes < CACHE_MEMORY) {
+		e = (struct cachedread_t*) malloc(sizeof(struct cachedread_t) + length);
+	}
+	if (e != NULL) {
+		memcpy((char*) (e + 1), bases, length);
+		e->hash = hash;
+		e->length = length;
+		e->mismatch = mismatch;
+		e->bases = (const char*) (e + 1);
+		e->done = 0;
+		e->users = 1;
+		e->hit = NULL;
+		e->hits = 0;
+		place(cache.table, cache.mask, e);
+		cache.count++;
+		cache.bytes = cache.bytes + sizeof(struct cachedread_t) + length;
+	}
+	pthread_mutex_unlock(&cache.mutex);
+	return e;
+}
+
+/******************************************************************************
+ * Stores the hits of a searched read, the entry takes the malloc'ed hit, and
+ * wakes its copies
+ ******************************************************************************/
+void cacheDone(struct cachedread_t *e, struct cachedhit_t *hit, unsigned int hits,
+			   uint32_t positions, int8_t best, int8_t bestmismatch) {
+
+	pthread_mutex_lock(&cache.mutex);
+	e->hit = hit;
+	e->hits = hits;
+	e->positions = positions;
+	e->best = best;
+	e->bestmismatch = bestmismatch;
+	e->done = 1;
+	cache.bytes = cache.bytes + hits * sizeof(struct cachedhit_t);
+	pthread_cond_broadcast(&cache.done_signal);
+	pthread_mutex_unlock(&cache.mutex);
+}
+
+/* until the first copy of the read is finished, perhaps on another board */
+void cacheWait(struct cachedread_t *e) {
+
+	pthread_mutex_lock(&cache.mutex);
+	while (e->done == 0) {
+		pthread_cond_wait(&cache.done_signal, &cache.mutex);
+	}
+	pthread_mutex_unlock(&cache.mutex);
+}
+
+void cacheRelease(struct cachedread_t *e) {
+
+	pthread_mutex_lock(&cache.mutex);
+	e->users--;
+	if (e->done && (e->users == 0)) {
+		cache.idle++;
+	}
+	pthread_mutex_unlock(&cache.mutex);
+}
+
+void cacheFree() {
+	unsigned int i;
+
+	for (i = 0; (cache.table != NULL) && (i <= cache.mask); i++) {
+		if (cache.table[i] != NULL) {
+			free(cache.table[i]->hit);
+			free(cache.table[i]);
+		}
+	}
+	free(cache.table);
+	cache.table = NULL;
+	cache.mask = 0;
+	cache.count = 0;
+	cache.idle = 0;
+	cache.bytes = 0;
+}
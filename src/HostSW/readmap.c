@@ -0,0 +1,84 @@
+/*
+    readmap.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Decodes the LUT tables of the readmap, which are loaded into the
+    CFGLUT5 primitives of the FPGA, into bit-parallel read bases for the
+    software search engines.
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <string.h>
+#include "header/readmap.h"
+
+/******************************************************************************
+ * Decodes the bit-transposed LUT table of one read. The LUT of a base pair
+ * returns the mismatches of a text pair (t1, t2) at the address t1*4+t2, the
+ * count is split into the lower (m0) and upper (m1) 16 bits of the INIT value.
+ * Base i of the read is stored in bit i of the planes.
+ ******************************************************************************/
+void decodeRead(const char *readmap, struct read_bits *read) {
+
+	uint32_t block[READ_BYTES / 4], lut;
+	unsigned int k, j, t, m, best, sum[2][4];
+
+	memcpy(block, readmap, sizeof(block));
+
+	read->hi = 0;
+	read->lo = 0;
+	read->care = 0;
+	read->length = 0;
+
+	for (k = 0; k < 32; k++) {
+		/* table_block[i] bit (31-k) holds bit (31-i) of the LUT of pair k */
+		lut = 0;
+		for (j = 0; j < 32; j++) {
+			lut |= ((block[31-j] >> (31-k)) & 1) << j;
+		}
+
+		memset(sum, 0, sizeof(sum));
+		for (t = 0; t < 16; t++) {
+			m = ((lut >> t) & 1) + 2 * ((lut >> (16+t)) & 1);
+			sum[0][t >> 2] += m;
+			sum[1][t & 3] += m;
+		}
+
+		/* the read base is the text base with the fewest mismatches */
+		for (j = 0; j < 2; j++) {
+			best = 0;
+			for (t = 1; t < 4; t++) {
+				if (sum[j][t] < sum[j][best]) best = t;
+			}
+			if (sum[j][best] == sum[j][(best+1) & 3]) {
+				continue;	/* wildcard */
+			}
+			read->care |= (uint64_t) 1 << (2*k+j);
+			read->hi   |= (uint64_t) (best >> 1) << (2*k+j);
+			read->lo   |= (uint64_t) (best & 1) << (2*k+j);
+			read->length = 2*k+j+1;
+		}
+	}
+}
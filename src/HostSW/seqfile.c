@@ -0,0 +1,311 @@
+/*
+    seqfile.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Reader for the records of FASTA and FASTQ read files. The file is read
+    in blocks of SEQFILE_BUFFER bytes and split into lines with memchr(),
+    so the parser touches every byte once and calls no library function
+    per character. A FASTA record is a '>' header followed by sequence
+    lines up to the next header, a FASTQ record an '@' header, sequence
+    lines, a '+' line and as many qualities as bases.
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "header/seqfile.h"
+#include "header/gzinput.h"
+
+/* growing copy of a part of a record */
+struct text_t {
+	char *data;
+	size_t length, size;
+};
+
+struct seqfile_t {
+	FILE *file;
+	const char *filename;
+	char *buffer;
+	size_t begin, end;			/* unread bytes of the buffer */
+	int eof;
+	int skip;					/* rest of a line longer than the buffer */
+	char *line;					/* line returned again by the next nextLine */
+	size_t linelength;
+	int pending;
+	unsigned long records;
+
+	struct text_t name, bases, quality;
+};
+
+/******************************************************************************
+ * Opens a plain or compressed read file
+ ******************************************************************************/
+struct seqfile_t *openSeqFile(const char *name) {
+	struct seqfile_t *f;
+
+	f = (struct seqfile_t*) calloc(1, sizeof(struct seqfile_t));
+	if (f == NULL) {
+		return NULL;
+	}
+	f->filename = name;
+	f->buffer = (char*) malloc(SEQFILE_BUFFER);
+	f->file = openInput(name);
+	if ((f->buffer == NULL) || (f->file == NULL)) {
+		closeSeqFile(f);
+		return NULL;
+	}
+	return f;
+}
+
+void closeSeqFile(struct seqfile_t *f) {
+	if (f->file != NULL) {
+		fclose(f->file);
+	}
+	free(f->buffer);
+	free(f->name.data);
+	free(f->bases.data);
+	free(f->quality.data);
+	free(f);
+}
+
+/******************************************************************************
+ * Moves the unread bytes to the front of the buffer and reads behind them.
+ * Returns the number of bytes read, 0 at the end of the file or with a full
+ * buffer and -1 on a read error.
+ ******************************************************************************/
+static int fillBuffer(struct seqfile_t *f) {
+	size_t n;
+
+	if (f->begin > 0) {
+		memmove(f->buffer, f->buffer + f->begin, f->end - f->begin);
+		f->end = f->end - f->begin;
+		f->begin = 0;
+	}
+	if (f->end == SEQFILE_BUFFER) {
+		return 0;
+	}
+
+	n = fread(f->buffer + f->end, 1, SEQFILE_BUFFER - f->end, f->file);
+	if (n == 0) {
+		if (ferror(f->file)) {
+			return -1;
+		}
+		f->eof = 1;
+	}
+	f->end = f->end + n;
+	return (int) n;
+}
+
+/******************************************************************************
+ * Returns the next line without '\n' and '\r' or NULL at the end of the file
+ * and on errors. The line stays valid until the next call. A line longer
+ * than the buffer is cut, the rest is skipped.
+ ******************************************************************************/
+static char *nextLine(struct seqfile_t *f, size_t *length, int *error) {
+	char *line, *newline;
+	size_t n;
+	int rc;
+
+	if (f->pending) {
+		f->pending = 0;
+		*length = f->linelength;
+		return f->line;
+	}
+
+	while (1) {
+		newline = (char*) memchr(f->buffer + f->begin, '\n', f->end - f->begin);
+		if (f->skip) {
+			f->begin = (newline == NULL) ? f->end : (size_t) (newline + 1 - f->buffer);
+			if ((newline != NULL) || f->eof) {
+				f->skip = 0;
+				continue;
+			}
+		} else if ((newline != NULL) || f->eof) {
+			break;
+		}
+		rc = fillBuffer(f);
+		if (rc < 0) {
+			*error = 1;
+			return NULL;
+		}
+		if ((rc == 0) && !f->eof) {
+			/* full buffer without a line end */
+			f->skip = 1;
+			break;
+		}
+	}
+
+	line = f->buffer + f->begin;
+	if (newline != NULL) {
+		n = newline - line;
+		f->begin = f->begin + n + 1;
+	} else {
+		n = f->end - f->begin;
+		f->begin = f->end;
+		if ((n == 0) && f->eof) {
+			return NULL;
+		}
+	}
+	if ((n > 0) && (line[n - 1] == '\r')) {
+		n--;
+	}
+
+	f->line = line;
+	f->linelength = n;
+	*length = n;
+	return line;
+}
+
+static int appendText(struct text_t *t, const char *data, size_t length) {
+	char *grown;
+
+	if (t->length + length + 1 > t->size) {
+		t->size = 2 * (t->length + length + 1);
+		grown = (char*) realloc(t->data, t->size);
+		if (grown == NULL) {
+			return -1;
+		}
+		t->data = grown;
+	}
+	memcpy(t->data + t->length, data, length);
+	t->length = t->length + length;
+	t->data[t->length] = 0;
+	return 0;
+}
+
+/******************************************************************************
+ * Appends the bases of a sequence line up to the first character that is no
+ * letter. A "/n" there sets the mismatches of the read.
+ ******************************************************************************/
+static int appendBases(struct seqfile_t *f, const char *line, size_t length, struct seqrecord_t *record) {
+	size_t bases = 0, n;
+	uint64_t word;
+	int mismatch;
+
+	/* eight letters at once, a byte below 'A' or above 0x7f borrows into its top bit */
+	while (bases + 8 <= length) {
+		memcpy(&word, line + bases, 8);
+		if (((word - 0x4141414141414141ULL) | word) & 0x8080808080808080ULL) {
+			break;
+		}
+		bases = bases + 8;
+	}
+	while ((bases < length) && (line[bases] >= 'A')) {
+		bases++;
+	}
+	if ((bases + 1 < length) && (line[bases] == '/') && (line[bases + 1] >= '0') && (line[bases + 1] <= '9')) {
+		mismatch = 0;
+		for (n = bases + 1; (n < length) && (line[n] >= '0') && (line[n] <= '9') && (mismatch < 1000); n++) {
+			mismatch = 10 * mismatch + (line[n] - '0');
+		}
+		record->mismatch = mismatch;
+	}
+	return appendText(&f->bases, line, bases);
+}
+
+/******************************************************************************
+ * Reads the next FASTA or FASTQ record. Returns 1 for a record, 0 at the end
+ * of the file and -1 on errors.
+ ******************************************************************************/
+int nextRecord(struct seqfile_t *f, struct seqrecord_t *record) {
+	char *line;
+	size_t length;
+	int error = 0, fastq;
+
+	/* lines before the first header are skipped */
+	do {
+		line = nextLine(f, &length, &error);
+		if (line == NULL) {
+			return error ? -1 : 0;
+		}
+	} while ((length == 0) || ((line[0] != '>') && (line[0] != '@')));
+
+	fastq = (line[0] == '@');
+	f->records++;
+	f->name.length = 0;
+	f->bases.length = 0;
+	f->quality.length = 0;
+	record->mismatch = -1;
+	if (appendText(&f->name, line + 1, length - 1) || appendText(&f->bases, "", 0) || appendText(&f->quality, "", 0)) {
+		fprintf(stderr, "\nError: allocating record %lu of %s\n", f->records, f->filename);
+		return -1;
+	}
+
+	/* sequence lines up to the next header or the '+' line */
+	while (1) {
+		line = nextLine(f, &length, &error);
+		if (line == NULL) {
+			if (error || fastq) {
+				if (!error) {
+					fprintf(stderr, "\nError: %s: record %s has no qualities\n", f->filename, f->name.data);
+				}
+				return -1;
+			}
+			break;
+		}
+		if (fastq && (length > 0) && (line[0] == '+')) {
+			break;
+		}
+		if (!fastq && (length > 0) && (line[0] == '>')) {
+			f->pending = 1;
+			break;
+		}
+		if (appendBases(f, line, length, record)) {
+			fprintf(stderr, "\nError: allocating record %lu of %s\n", f->records, f->filename);
+			return -1;
+		}
+	}
+
+	/* qualities may start with '@', the number of bases without a "/n" ends the record */
+	while (fastq && (f->quality.length < f->bases.length)) {
+		line = nextLine(f, &length, &error);
+		if (line == NULL) {
+			break;
+		}
+		if (appendText(&f->quality, line, length)) {
+			fprintf(stderr, "\nError: allocating record %lu of %s\n", f->records, f->filename);
+			return -1;
+		}
+	}
+	if (error) {
+		return -1;
+	}
+	if (fastq && (f->quality.length != f->bases.length)) {
+		fprintf(stderr, "\nError: %s: record %s has %lu qualities for %lu bases\n", f->filename, f->name.data,
+				(unsigned long) f->quality.length, (unsigned long) f->bases.length);
+		return -1;
+	}
+
+	record->name = f->name.data;
+	record->namelength = f->name.length;
+	record->bases = f->bases.data;
+	record->length = f->bases.length;
+	record->quality = fastq ? f->quality.data : NULL;
+	return 1;
+}
@@ -0,0 +1,227 @@
+/*
+    sockserver.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Stream sockets shared by the job socket of the daemon and the metrics
+    server. sockUnix() creates a UNIX domain socket and replaces only a
+    socket file that nothing listens on any more. sockServe() takes the
+    connections: it polls the listening socket and every connection whose
+    request is incomplete, drops a connection that sends no request within
+    SOCK_TIMEOUT seconds and hands each complete request to its server.
+    It returns when the listening socket is shut down.
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "header/sockserver.h"
+
+static double now() {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+}
+
+/* a peer that went away gets no SIGPIPE */
+void sockReply(int fd, const char *data, size_t length) {
+	ssize_t n;
+
+	while (length > 0) {
+		n = send(fd, data, length, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+		data = data + n;
+		length = length - n;
+	}
+}
+
+/******************************************************************************
+ * Listens on a UNIX domain socket at path. With owner the socket is
+ * accessible only to its owner; its mode is set before listen, so no other
+ * user can connect in between.
+ * A socket file that nothing listens on is replaced, any other file is not.
+ * Returns the socket or -1.
+ ******************************************************************************/
+int sockUnix(const char *path, int owner, int backlog) {
+	struct sockaddr_un address;
+	struct stat st;
+	int fd, probe, bound;
+
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "\nError: socket path %s is too long\n", path);
+		return -1;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			fprintf(stderr, "\nError: %s exists and is not a socket\n", path);
+			return -1;
+		}
+		probe = socket(AF_UNIX, SOCK_STREAM, 0);
+		if ((probe >= 0) && (connect(probe, (struct sockaddr*) &address, sizeof(address)) == 0)) {
+			close(probe);
+			fprintf(stderr, "\nError: another process is listening on %s\n", path);
+			return -1;
+		}
+		if (probe >= 0) {
+			close(probe);
+		}
+		unlink(path);
+	}
+
+	/* not with umask, which would also hold for the files of other threads */
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	bound = (fd >= 0) ? bind(fd, (struct sockaddr*) &address, sizeof(address)) : -1;
+	if ((bound == -1) || (owner && (chmod(path, 0600) == -1)) || (listen(fd, backlog) == -1)) {
+		fprintf(stderr, "\nError: can not listen on %s\n", path);
+		if (fd >= 0) {
+			close(fd);
+		}
+		if (bound == 0) {
+			unlink(path);
+		}
+		return -1;
+	}
+	return fd;
+}
+
+/* reads what arrived of the request without waiting: 1 with the whole
+ * request, 0 if more is to come, -1 on an error, the end of the connection
+ * or a request too long */
+static int readRequest(struct sockserver_t *s, struct sockpending_t *p) {
+	ssize_t n;
+
+	while (p->length + 1 < SOCK_REQUEST) {
+		n = recv(p->fd, p->data + p->length, SOCK_REQUEST - 1 - p->length, MSG_DONTWAIT);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return 0;
+		}
+		if (n <= 0) {
+			return -1;
+		}
+		p->length = p->length + n;
+		p->data[p->length] = 0;
+		if (s->complete(p->data, p->length)) {
+			return 1;
+		}
+	}
+	return -1;
+}
+
+static void drop(int fd, const char *text) {
+	if (text != NULL) {
+		sockReply(fd, text, strlen(text));
+	}
+	close(fd);
+}
+
+/******************************************************************************
+ * Takes the connections of s->listen until it is shut down
+ ******************************************************************************/
+void sockServe(struct sockserver_t *s) {
+	struct pollfd fds[SOCK_PENDING + 1];
+	struct sockpending_t *p;
+	unsigned int i;
+	int fd, rc;
+
+	while (1) {
+		fds[0].fd = s->listen;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		for (i = 0; i < s->pendings; i++) {
+			fds[i+1].fd = s->pending[i].fd;
+			fds[i+1].events = POLLIN;
+			fds[i+1].revents = 0;
+		}
+		if ((poll(fds, s->pendings + 1, 1000) == -1) && (errno != EINTR)) {
+			break;
+		}
+
+		/* the requests that arrived, and the peers that gave up or took too long */
+		for (i = s->pendings; i > 0; i--) {
+			p = &s->pending[i-1];
+			rc = 0;
+			if (fds[i].revents != 0) {
+				rc = readRequest(s, p);
+			}
+			if ((rc == 0) && (now() - p->since < SOCK_TIMEOUT)) {
+				continue;
+			}
+			if (rc == 1) {
+				s->take(s->context, p->fd, p->data);
+			} else {
+				drop(p->fd, s->late);
+			}
+			*p = s->pending[--s->pendings];
+		}
+
+		if (fds[0].revents == 0) {
+			continue;
+		}
+		/* accept() fails once the socket is shut down */
+		fd = accept(s->listen, NULL, NULL);
+		if (fd < 0) {
+			if ((errno == EINTR) || (errno == ECONNABORTED) || (errno == EAGAIN)) {
+				continue;
+			}
+			break;
+		}
+		if (s->pendings == SOCK_PENDING) {
+			drop(fd, s->full);
+			continue;
+		}
+		p = &s->pending[s->pendings++];
+		p->fd = fd;
+		p->length = 0;
+		p->since = now();
+	}
+
+	for (i = 0; i < s->pendings; i++) {
+		drop(s->pending[i].fd, s->stopped);
+	}
+	s->pendings = 0;
+}
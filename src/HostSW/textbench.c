@@ -0,0 +1,315 @@
+/*
+    textbench.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Micro-benchmark of the writing of the result lines. The same hits are
+    formatted as PAM and as SAM lines twice: with the fprintf() calls the
+    host program used before and with textReserve(), textCopy(),
+    textCopySlot(), textDecimal() and textCommit() of textout.c. The hits
+    are drawn from a seeded generator before the clock starts, so only the
+    formatting and the writing are timed. Both versions run several times in turns and the
+    fastest run of each counts, so a busy host does not decide the speedup.
+    The output goes to /dev/null unless a name is given, then both versions
+    are written to files that can be compared.
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "header/gettime.h"
+#include "header/textout.h"
+
+#define LABEL		200			/* bytes of a label, like the host program */
+#define MAXLENGTH	256
+#define READS		4096		/* distinct reads the hits belong to */
+#define SEQUENCES	8
+
+struct hit_t {
+	unsigned int read;
+	unsigned int sequence;
+	unsigned long offset;
+	int reverse;
+};
+
+static const char bases[4] = { 'A', 'C', 'G', 'T' };
+
+static struct option text_lopts[] = {
+	{ "output",		required_argument, NULL, 'o' },
+	{ "hits",		required_argument, NULL, 'n' },
+	{ "length",		required_argument, NULL, 'l' },
+	{ "quality",	no_argument		 , NULL, 'Q' },
+	{ "seed",		required_argument, NULL, 's' },
+	{ "repeat",		required_argument, NULL, 'r' },
+	{ "help",		no_argument		 , NULL, 'h' },
+	{ 0, 0, 0, 0 }
+};
+
+static char text_sopts[] = "o:n:l:Qs:r:h";
+
+static char labels[READS * LABEL];
+static unsigned int labellength[READS];
+static char names[SEQUENCES][16];
+static unsigned int namelength[SEQUENCES];
+static char heads[2 * SEQUENCES][32];
+static unsigned int headlength[2 * SEQUENCES];
+static char read_bases[MAXLENGTH + 1], read_quality[MAXLENGTH + 1];
+
+static uint64_t state;
+
+/* xorshift64*, the same sequence with every C library */
+static uint64_t next() {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 0x2545F4914F6CDD1DULL;
+}
+
+static uint64_t below(uint64_t n) {
+	return (n > 0) ? (next() >> 11) % n : 0;
+}
+
+static void print_help() {
+
+	printf("\nFPGA-Alignment text output benchmark\n");
+	printf("Usage:\n");
+	printf("\tfpga-textbench [options] \n\n");
+	printf("Options:\n");
+	printf("\t--output \t-o <name> \twrite name-fprintf.pam, name-text.pam, ... (default: /dev/null)\n");
+	printf("\t--hits \t\t-n [int] \tnumber of hits (default: 2000000)\n");
+	printf("\t--length \t-l [int] \tbases of a read (default: 50)\n");
+	printf("\t--quality \t-Q \t\tbases and quality in the SAM lines\n");
+	printf("\t--seed \t\t-s [int] \tseed of the generator (default: 1)\n");
+	printf("\t--repeat \t-r [int] \truns of each version, the fastest counts (default: 5)\n");
+	printf("\t--help \t\t-h \t\tprint this usage message\n");
+}
+
+/* the lines as the host program wrote them with stdio */
+static int writeFprintf(const char *name, const struct hit_t *hits, unsigned long count, int sam, int quality) {
+	const struct hit_t *h;
+	unsigned long i;
+	FILE *f;
+
+	f = fopen(name, "w");
+	if (f == NULL) {
+		fprintf(stderr, "\nError: can not create File %s\n", name);
+		return -1;
+	}
+	for (i = 0; i < count; i++) {
+		h = &hits[i];
+		fprintf(f, "%s", labels + (h->read * LABEL));
+		if (sam == 0) {
+			fprintf(f, "\t%lu \t%c\n", h->offset, h->reverse ? '-' : '+');
+		} else {
+			fprintf(f, "\t%u \t%s \t0 \t%lu \t* \t* \t* \t* \t* \t", h->reverse ? 16 : 0, names[h->sequence], h->offset);
+			if (quality == 0) {
+				fprintf(f, "* \t*\n");
+			} else {
+				fprintf(f, "%s \t%s\n", read_bases, read_quality);
+			}
+		}
+	}
+	if (fclose(f) != 0) {
+		fprintf(stderr, "\nError: writing %s\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+/* the same lines formatted in place, as writeHit() of main.cpp does */
+static int writeText(const char *name, const struct hit_t *hits, unsigned long count, int sam, int quality) {
+	struct textbuffer_t text;
+	const struct hit_t *h;
+	unsigned int len = (unsigned int) strlen(read_bases);
+	unsigned long i;
+	int rc;
+	char *p;
+	FILE *f;
+
+	f = fopen(name, "w");
+	if (f == NULL) {
+		fprintf(stderr, "\nError: can not create File %s\n", name);
+		return -1;
+	}
+	if (textBuffer(&text, fileno(f)) == -1) {
+		fprintf(stderr, "\nError: allocating the text buffer\n");
+		fclose(f);
+		return -1;
+	}
+	for (i = 0; i < count; i++) {
+		h = &hits[i];
+		p = textReserve(&text, labellength[h->read] + namelength[h->sequence] + 2 * len + 64);
+		if (p == NULL) {
+			break;
+		}
+		p = textCopySlot(p, labels + (h->read * LABEL), labellength[h->read]);
+		if (sam == 0) {
+			*p++ = '\t';
+			p = textDecimal(p, h->offset);
+			p = textCopy(p, h->reverse ? " \t-\n" : " \t+\n", 4);
+		} else {
+			p = textCopy(p, heads[2 * h->sequence + (h->reverse != 0)], headlength[2 * h->sequence + (h->reverse != 0)]);
+			p = textDecimal(p, h->offset);
+			if (quality == 0) {
+				p = textCopy(p, " \t* \t* \t* \t* \t* \t* \t*\n", 22);
+			} else {
+				p = textCopy(p, " \t* \t* \t* \t* \t* \t", 17);
+				p = textCopy(p, read_bases, len);
+				p = textCopy(p, " \t", 2);
+				p = textCopy(p, read_quality, len);
+				*p++ = '\n';
+			}
+		}
+		textCommit(&text, p);
+	}
+	rc = textFlush(&text);
+	free(text.data);
+	if ((fclose(f) != 0) || (rc == -1) || (i < count)) {
+		fprintf(stderr, "\nError: writing %s\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	unsigned long count = 2000000, i;
+	unsigned int length = 50;
+	uint64_t seed = 1;
+	const char *output = NULL;
+	const char *format[2] = { "pam", "sam" };
+	double time0, time1, seconds[2];
+	struct hit_t *hits;
+	char name[4096];
+	int quality = 0, repeat = 5, sam, opt, k;
+
+	while ((opt = getopt_long(argc, argv, text_sopts, text_lopts, NULL)) != -1) {
+		switch (opt) {
+			case 'o':
+				output = optarg;
+				break;
+
+			case 'n':
+				count = strtoul(optarg, NULL, 10);
+				break;
+
+			case 'l':
+				length = atoi(optarg);
+				break;
+
+			case 'Q':
+				quality = 1;
+				break;
+
+			case 's':
+				seed = strtoull(optarg, NULL, 10);
+				break;
+
+			case 'r':
+				repeat = atoi(optarg);
+				break;
+
+			default:
+				print_help();
+				return -1;
+		}
+	}
+
+	if ((count == 0) || (length == 0) || (length > MAXLENGTH) || (repeat < 1)) {
+		fprintf(stderr, "\nError: invalid number of hits, read length or runs\n");
+		return -1;
+	}
+
+	/* a seed of 0 would stay 0 */
+	state = seed * 0x9E3779B97F4A7C15ULL + 1;
+
+	/* labels and names like those of fpga-benchgen */
+	for (i = 0; i < READS; i++) {
+		labellength[i] = snprintf(labels + (i * LABEL), LABEL, "r%lu_contig%u_%llu_%c_%u", i + 1,
+								  (unsigned int) below(SEQUENCES) + 1, (unsigned long long) below(500000) + 1,
+								  below(2) ? '-' : '+', (unsigned int) below(4));
+	}
+	for (i = 0; i < SEQUENCES; i++) {
+		namelength[i] = snprintf(names[i], sizeof(names[i]), "contig%lu", i + 1);
+		headlength[2 * i] = snprintf(heads[2 * i], 32, "\t0 \t%s \t0 \t", names[i]);
+		headlength[2 * i + 1] = snprintf(heads[2 * i + 1], 32, "\t16 \t%s \t0 \t", names[i]);
+	}
+	for (i = 0; i < length; i++) {
+		read_bases[i] = bases[below(4)];
+	}
+	memset(read_quality, 'I', length);
+
+	hits = (struct hit_t*) malloc(count * sizeof(struct hit_t));
+	if (hits == NULL) {
+		fprintf(stderr, "\nError: allocating %lu hits\n", count);
+		return -1;
+	}
+	for (i = 0; i < count; i++) {
+		hits[i].read = (unsigned int) below(READS);
+		hits[i].sequence = (unsigned int) below(SEQUENCES);
+		hits[i].offset = (unsigned long) below(500000000);
+		hits[i].reverse = (int) below(2);
+	}
+
+	for (sam = 0; sam < 2; sam++) {
+		seconds[0] = seconds[1] = 0;
+		for (k = 0; k < repeat; k++) {
+			if (output != NULL) {
+				snprintf(name, sizeof(name), "%s-fprintf.%s", output, format[sam]);
+			}
+			time0 = gettime(0);
+			if (writeFprintf((output != NULL) ? name : "/dev/null", hits, count, sam, quality) == -1) {
+				free(hits);
+				return -1;
+			}
+			time1 = gettime(time0);
+			if ((k == 0) || (time1 < seconds[0])) {
+				seconds[0] = time1;
+			}
+
+			if (output != NULL) {
+				snprintf(name, sizeof(name), "%s-text.%s", output, format[sam]);
+			}
+			time0 = gettime(0);
+			if (writeText((output != NULL) ? name : "/dev/null", hits, count, sam, quality) == -1) {
+				free(hits);
+				return -1;
+			}
+			time1 = gettime(time0);
+			if ((k == 0) || (time1 < seconds[1])) {
+				seconds[1] = time1;
+			}
+		}
+
+		printf("fprintf %s: %.3f s %.0f hits/s\n", format[sam], seconds[0], count / seconds[0]);
+		printf("text %s: %.3f s %.0f hits/s\n", format[sam], seconds[1], count / seconds[1]);
+		printf("speedup %s: %.2f\n", format[sam], (seconds[1] > 0) ? seconds[0] / seconds[1] : 0);
+	}
+	free(hits);
+	return 0;
+}
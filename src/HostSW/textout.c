@@ -0,0 +1,110 @@
+/*
+    textout.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Buffered writing of the result lines. The fields of a hit are copied
+    into a large buffer with known lengths and numbers are converted two
+    digits at a time, so a hit costs no stdio lock and no parsing of a
+    format string. Full buffers go to the file with write().
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "header/textout.h"
+
+const char text_digit_pairs[200] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+const uint32_t text_powers[10] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+int textBuffer(struct textbuffer_t *buffer, int fd) {
+	buffer->length = 0;
+	buffer->size = TEXT_BUFFER;
+	buffer->fd = fd;
+	buffer->error = 0;
+	buffer->data = (char*) malloc(TEXT_BUFFER);
+	return (buffer->data == NULL) ? -1 : 0;
+}
+
+/******************************************************************************
+ * Writes the buffer to its file. Returns -1 if a write failed before, the
+ * data of a failed write is dropped.
+ ******************************************************************************/
+int textFlush(struct textbuffer_t *buffer) {
+	const char *data = buffer->data;
+	unsigned int length = buffer->length;
+	ssize_t n;
+
+	while ((length > 0) && (buffer->error == 0)) {
+		n = write(buffer->fd, data, length);
+		if (n < 0) {
+			if (errno != EINTR) {
+				buffer->error = 1;
+			}
+			continue;
+		}
+		data = data + n;
+		length = length - n;
+	}
+	buffer->length = 0;
+	return buffer->error ? -1 : 0;
+}
+
+/******************************************************************************
+ * Makes room for a line that does not fit behind the buffered ones: writes
+ * the buffer and grows it for a line longer than the whole buffer
+ ******************************************************************************/
+char *textRoom(struct textbuffer_t *buffer, unsigned int length) {
+	char *grown;
+
+	textFlush(buffer);
+	if (length > buffer->size) {
+		grown = (char*) realloc(buffer->data, length);
+		if (grown == NULL) {
+			buffer->error = 1;
+			return NULL;
+		}
+		buffer->data = grown;
+		buffer->size = length;
+	}
+	return buffer->data;
+}
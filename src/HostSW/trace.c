@@ -0,0 +1,447 @@
+/*
+    trace.c
+    Project:	FPGA-DNA-Sequence-Search
+
+	Description:
+    Recorder of the frames between the host and the boards for the analysis
+    of the flow-control. The send and receive functions of ethernet.c hand
+    every frame to traceFrame(), which claims a slot of a ring with one
+    atomic addition and stores the time, control code, packet id, length
+    and the credit of the board; without traceStart() it returns at once.
+    traceWrite() dumps the ring as pcapng, one interface per board, with the
+    Ethernet header and the first two bytes of every frame and comments on
+    the control frames, long gaps and the waits for credit, and prints a
+    summary of the gaps between the data frames and of the credit waits.
+
+
+ 	MIT License
+
+	Copyright (c) 2019 Oliver Knodel
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "header/protocol.h"
+#include "header/ethernet.h"
+#include "header/trace.h"
+
+#define TRACE_GAP		1e-3		/* seconds, gaps of the stream with a comment */
+#define SNAPLEN			16			/* Ethernet header, control code and one byte */
+#define LINKTYPE_ETHERNET	1
+
+/* one frame, sequence is written last and is the slot + 1 */
+struct tracerecord_t {
+	uint64_t time;				/* CLOCK_MONOTONIC in ns */
+	unsigned long sequence;
+	unsigned int id;			/* packet id, received: bytes 1 and 2 */
+	uint16_t length;			/* bytes on the wire with the Ethernet header */
+	uint16_t credit;
+	uint8_t board;
+	uint8_t direction;
+	uint8_t ctr;
+};
+
+static struct {
+	struct tracerecord_t *ring;
+	unsigned long size;			/* power of 2 */
+	unsigned long head;			/* next slot, grows with every frame */
+	int64_t offset;				/* CLOCK_REALTIME - CLOCK_MONOTONIC in ns */
+	unsigned int boards;
+	char mac[MAXBOARDS][2][6];	/* host and board */
+} trace;
+
+/* state of a board while the ring is read */
+struct tracestate_t {
+	uint64_t data;				/* last data frame sent */
+	int waiting;				/* data sent since the last credit */
+};
+
+struct tracesummary_t {
+	unsigned long frames, sent, received, lost;
+	double *gaps;
+	unsigned long gapcount;
+	unsigned long starved;
+	double starvation, maxstarvation;
+	double first, last;
+};
+
+static uint64_t now() {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t) t.tv_sec * 1000000000ULL + (uint64_t) t.tv_nsec;
+}
+
+/******************************************************************************
+ * Allocates a ring of records frames, rounded up to a power of 2, and starts
+ * recording
+ ******************************************************************************/
+int traceStart(unsigned long records) {
+	struct timespec real, mono;
+
+	for (trace.size = 1; trace.size < records; trace.size = trace.size * 2);
+
+	trace.ring = (struct tracerecord_t*) calloc(trace.size, sizeof(struct tracerecord_t));
+	if (trace.ring == NULL) {
+		fprintf(stderr, "\nError: allocating the trace of %lu frames\n", trace.size);
+		return -1;
+	}
+	trace.head = 0;
+
+	clock_gettime(CLOCK_REALTIME, &real);
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	trace.offset = ((int64_t) real.tv_sec - (int64_t) mono.tv_sec) * 1000000000LL +
+				   ((int64_t) real.tv_nsec - (int64_t) mono.tv_nsec);
+	return 0;
+}
+
+/* the board of dev becomes interface number of the trace */
+void traceDevice(struct device_t *dev, unsigned int number) {
+	dev->board = number;
+	dev->credit = 0;
+	if (number < MAXBOARDS) {
+		memcpy(trace.mac[number][0], dev->host_mac, 6);
+		memcpy(trace.mac[number][1], dev->client_mac, 6);
+		if (number + 1 > trace.boards) {
+			trace.boards = number + 1;
+		}
+	}
+}
+
+/******************************************************************************
+ * Records one frame. Several threads of a board send and receive, the slot
+ * is claimed atomically; a full ring overwrites the oldest frames.
+ ******************************************************************************/
+void traceFrame(struct device_t *dev, int direction, char ctr, unsigned int id, int length) {
+	struct tracerecord_t *r;
+	unsigned long slot;
+
+	if (trace.ring == NULL) {
+		return;
+	}
+
+	/* the credit of the board comes with these control frames */
+	if ((direction == TRACE_RX) && ((ctr == ctr_send_next) || (ctr == ctr_send_DB))) {
+		dev->credit = (uint16_t) id;
+	}
+
+	slot = __atomic_fetch_add(&trace.head, 1, __ATOMIC_RELAXED);
+	r = &trace.ring[slot & (trace.size - 1)];
+	r->time = now();
+	r->id = id;
+	r->length = (length > 0) ? (uint16_t) length : 0;
+	r->credit = dev->credit;
+	r->board = (uint8_t) dev->board;
+	r->direction = (uint8_t) direction;
+	r->ctr = (uint8_t) ctr;
+	__atomic_store_n(&r->sequence, slot + 1, __ATOMIC_RELEASE);
+}
+
+static const char *controlName(uint8_t ctr) {
+	switch (ctr) {
+		case ctr_first_data:		return "first data";
+		case ctr_data:				return "data";
+		case ctr_last_data:			return "last data";
+		case ctr_send_next:			return "send next";
+		case ctr_send_DB:			return "send DB";
+		case ctr_get_data:			return "get data";
+		case ctr_finished_search:	return "finished search";
+		case ctr_finished_sending:	return "finished sending";
+		case ctr_next_segment:		return "next segment";
+		case ctr_finished_iteration:	return "finished iteration / reset";
+		case ctr_getid:				return "get id";
+		case info_v5:				return "Virtex-5";
+		case info_v6:				return "Virtex-6";
+		case error:					return "packet lost";
+		case ctr_overflow:			return "overflow";
+		case ctr_overflow_ready:	return "overflow ready";
+		default:					return "unknown";
+	}
+}
+
+static int isData(const struct tracerecord_t *r) {
+	return (r->direction == TRACE_TX) &&
+		   ((r->ctr == ctr_first_data) || (r->ctr == ctr_data) || (r->ctr == ctr_last_data));
+}
+
+/******************************************************************************
+ * Follows the flow-control of the board of r and writes the comment of r,
+ * empty for an unremarkable data frame. A gap is the time between two data
+ * frames of a segment, a wait for credit the time from the last data frame
+ * to the next ctr_send_next.
+ ******************************************************************************/
+static void annotate(struct tracestate_t *state, const struct tracerecord_t *r,
+					 struct tracesummary_t *summary, char *comment, size_t size) {
+	struct tracestate_t *s = &state[r->board];
+	double gap;
+
+	comment[0] = 0;
+
+	if (isData(r)) {
+		if ((r->ctr != ctr_first_data) && (s->data != 0) && (r->time > s->data)) {
+			gap = (double) (r->time - s->data) * 1e-9;
+			if (summary != NULL) {
+				summary->gaps[summary->gapcount++] = gap;
+			}
+			if (gap >= TRACE_GAP) {
+				snprintf(comment, size, "gap of %.3f ms", gap * 1e3);
+			}
+		}
+		s->data = r->time;
+		s->waiting = (r->ctr != ctr_last_data);
+		return;
+	}
+
+	if ((r->direction == TRACE_RX) && (r->ctr == ctr_send_next) && s->waiting && (r->time > s->data)) {
+		gap = (double) (r->time - s->data) * 1e-9;
+		if (summary != NULL) {
+			summary->starved++;
+			summary->starvation = summary->starvation + gap;
+			if (gap > summary->maxstarvation) {
+				summary->maxstarvation = gap;
+			}
+		}
+		snprintf(comment, size, "%s, credit %u bytes after %.3f ms without credit",
+				 controlName(r->ctr), r->credit, gap * 1e3);
+		s->waiting = 0;
+		return;
+	}
+
+	/* the stream waits for the download, not for credit */
+	if ((r->direction == TRACE_RX) && (r->ctr == ctr_overflow)) {
+		s->waiting = 0;
+	}
+
+	if ((r->direction == TRACE_RX) && ((r->ctr == ctr_send_next) || (r->ctr == ctr_send_DB))) {
+		snprintf(comment, size, "%s, credit %u bytes", controlName(r->ctr), r->credit);
+	} else if ((r->direction == TRACE_RX) && (r->ctr == error)) {
+		snprintf(comment, size, "%s: message number %u", controlName(r->ctr), r->id & 255);
+	} else {
+		snprintf(comment, size, "%s %s", (r->direction == TRACE_TX) ? "host:" : "board:", controlName(r->ctr));
+	}
+}
+
+/* a pcapng block under construction */
+struct block_t {
+	unsigned char data[1024];
+	size_t length;
+};
+
+static void put(struct block_t *b, const void *data, size_t length) {
+	memcpy(b->data + b->length, data, length);
+	b->length = b->length + length;
+	while (b->length % 4) {
+		b->data[b->length++] = 0;
+	}
+}
+
+static void put32(struct block_t *b, uint32_t value) {
+	put(b, &value, 4);
+}
+
+static void option(struct block_t *b, uint16_t code, const void *data, size_t length) {
+	uint16_t header[2] = { code, (uint16_t) length };
+
+	if (b->length + 8 + length + 12 > sizeof(b->data)) {
+		return;
+	}
+	memcpy(b->data + b->length, header, 4);
+	b->length = b->length + 4;
+	put(b, data, length);
+}
+
+static void begin(struct block_t *b, uint32_t type) {
+	b->length = 0;
+	put32(b, type);
+	put32(b, 0);
+}
+
+static int end(struct block_t *b, FILE *f, int options) {
+	uint32_t total;
+
+	if (options) {
+		put32(b, 0);			/* opt_endofopt */
+	}
+	total = (uint32_t) b->length + 4;
+	memcpy(b->data + 4, &total, 4);
+	put32(b, total);
+	return (fwrite(b->data, b->length, 1, f) == 1) ? 0 : -1;
+}
+
+static int compareGaps(const void *a, const void *b) {
+	double x = *(const double*) a, y = *(const double*) b;
+
+	return (x > y) - (x < y);
+}
+
+/******************************************************************************
+ * Writes the recorded frames as pcapng to filename and prints the summary
+ ******************************************************************************/
+int traceWrite(const char *filename) {
+	struct tracestate_t state[MAXBOARDS];
+	struct tracesummary_t summary;
+	const struct tracerecord_t *r;
+	unsigned long slot, first, head;
+	struct block_t block;
+	char text[512], name[32];
+	uint8_t resolution = 9;
+	unsigned char frame[SNAPLEN];
+	uint64_t wall;
+	unsigned int i;
+	int rc = 0;
+	FILE *f;
+
+	if (trace.ring == NULL) {
+		return 0;
+	}
+
+	head = __atomic_load_n(&trace.head, __ATOMIC_ACQUIRE);
+	first = (head > trace.size) ? head - trace.size : 0;
+
+	memset(&summary, 0, sizeof(summary));
+	summary.lost = first;
+	summary.gaps = (double*) malloc((head - first + 1) * sizeof(double));
+	if (summary.gaps == NULL) {
+		fprintf(stderr, "\nError: allocating the summary of the trace\n");
+		return -1;
+	}
+
+	/* first pass: the summary for the section header and the output */
+	memset(state, 0, sizeof(state));
+	for (slot = first; slot < head; slot++) {
+		r = &trace.ring[slot & (trace.size - 1)];
+		if ((__atomic_load_n(&r->sequence, __ATOMIC_ACQUIRE) != slot + 1) || (r->board >= trace.boards)) {
+			continue;
+		}
+		if (summary.frames == 0) {
+			summary.first = (double) r->time * 1e-9;
+		}
+		summary.last = (double) r->time * 1e-9;
+		summary.frames++;
+		if (r->direction == TRACE_TX) {
+			summary.sent++;
+		} else {
+			summary.received++;
+		}
+		annotate(state, r, &summary, text, sizeof(text));
+	}
+	qsort(summary.gaps, summary.gapcount, sizeof(double), compareGaps);
+
+	printf("\n--- trace ---\n");
+	printf("frames: %lu sent, %lu received", summary.sent, summary.received);
+	if (summary.lost > 0) {
+		printf(", %lu older frames overwritten", summary.lost);
+	}
+	printf("\n");
+	if (summary.gapcount > 0) {
+		printf("gaps of the stream: median %.1f us, 99 %% %.1f us, max %.3f ms in %lu gaps\n",
+			   summary.gaps[summary.gapcount / 2] * 1e6,
+			   summary.gaps[(summary.gapcount * 99) / 100] * 1e6,
+			   summary.gaps[summary.gapcount - 1] * 1e3, summary.gapcount);
+	}
+	if (summary.starved > 0) {
+		printf("waits for credit: %lu, %.3f ms in total (%.1f %% of the trace), longest %.3f ms\n",
+			   summary.starved, summary.starvation * 1e3,
+			   (summary.last > summary.first) ? 100 * summary.starvation / (summary.last - summary.first) : 0,
+			   summary.maxstarvation * 1e3);
+	}
+	printf("written to %s\n", filename);
+
+	f = fopen(filename, "wb");
+	if (f == NULL) {
+		fprintf(stderr, "\nError: can not create the trace file %s\n", filename);
+		free(summary.gaps);
+		return -1;
+	}
+
+	/* section header with the summary */
+	begin(&block, 0x0A0D0D0A);
+	put32(&block, 0x1A2B3C4D);
+	put32(&block, 1);				/* version 1.0 */
+	put32(&block, 0xFFFFFFFF);		/* section length unknown */
+	put32(&block, 0xFFFFFFFF);
+	snprintf(text, sizeof(text), "fpga-align trace: %lu frames sent, %lu received, %lu overwritten; "
+			 "%lu gaps of the stream, max %.3f ms; %lu waits for credit, %.3f ms in total, max %.3f ms",
+			 summary.sent, summary.received, summary.lost, summary.gapcount,
+			 summary.gapcount ? summary.gaps[summary.gapcount - 1] * 1e3 : 0,
+			 summary.starved, summary.starvation * 1e3, summary.maxstarvation * 1e3);
+	option(&block, 1, text, strlen(text));
+	option(&block, 4, "fpga-align", 10);
+	rc = rc | end(&block, f, 1);
+
+	/* one interface per board, times in ns */
+	for (i = 0; i < trace.boards; i++) {
+		begin(&block, 1);
+		put32(&block, LINKTYPE_ETHERNET);
+		put32(&block, SNAPLEN);
+		snprintf(name, sizeof(name), "board %u", i);
+		option(&block, 2, name, strlen(name));
+		option(&block, 9, &resolution, 1);
+		rc = rc | end(&block, f, 1);
+	}
+
+	/* second pass: one enhanced packet block per frame */
+	memset(state, 0, sizeof(state));
+	for (slot = first; slot < head; slot++) {
+		r = &trace.ring[slot & (trace.size - 1)];
+		if ((__atomic_load_n(&r->sequence, __ATOMIC_ACQUIRE) != slot + 1) || (r->board >= trace.boards)) {
+			continue;
+		}
+		annotate(state, r, NULL, text, sizeof(text));
+
+		/* the Ethernet header, the control code and the id or first byte */
+		memcpy(frame, trace.mac[r->board][r->direction == TRACE_TX ? 1 : 0], 6);
+		memcpy(frame + 6, trace.mac[r->board][r->direction == TRACE_TX ? 0 : 1], 6);
+		frame[12] = ETH_P_FPGA >> 8;
+		frame[13] = ETH_P_FPGA & 255;
+		frame[14] = r->ctr;
+		frame[15] = (unsigned char) r->id;
+
+		wall = r->time + trace.offset;
+		begin(&block, 6);
+		put32(&block, r->board);
+		put32(&block, (uint32_t) (wall >> 32));
+		put32(&block, (uint32_t) wall);
+		put32(&block, (r->length < SNAPLEN) ? r->length : SNAPLEN);
+		put32(&block, r->length);
+		put(&block, frame, (r->length < SNAPLEN) ? r->length : SNAPLEN);
+		if (text[0] != 0) {
+			option(&block, 1, text, strlen(text));
+		}
+		rc = rc | end(&block, f, text[0] != 0);
+	}
+
+	if ((fclose(f) != 0) || (rc != 0)) {
+		fprintf(stderr, "\nError: writing the trace file %s\n", filename);
+		rc = -1;
+	}
+	free(summary.gaps);
+	return rc;
+}
+
+void traceStop() {
+	free(trace.ring);
+	trace.ring = NULL;
+}